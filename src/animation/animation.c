@@ -5,6 +5,15 @@
 // detection of multiple animations per pointer, and destroys the oldest one.
 // Animations also auto-destruct when complete
 //
+// Animations are stored in a fixed size table with their values held inline,
+// so starting an animation never allocates. Active animations are kept in
+// a doubly linked list (by table index) in the order they were started, and
+// an open addressed index maps each target pointer to its chain of animations.
+// If the table is full when a new animation is started, the oldest running
+// animation is finished immediately (its target is set to its end value) and
+// its slot is reused. Chained animations on the same pointer (i.e. a slide
+// followed by a delayed bounce) therefore still end at the correct value.
+//
 // @author Eric D. Phillips
 // @date September 1, 2015
 // @bugs No known bugs
@@ -14,24 +23,59 @@
 
 // Animation constants
 #define ANIMATION_TICK_INTERVAL 5      //< Number of milliseconds to pause between animation ticks
+#define ANIMATION_INDEX_SIZE (ANIMATION_MAX_COUNT * 2) //< Size of target index, power of 2
+#define ANIMATION_NONE -1              //< Invalid index into the animation or target tables
+
+// Type of value being animated
+typedef enum {
+  AnimationTypeGRect,
+  AnimationTypeGPoint,
+  AnimationTypeInt32
+} AnimationType;
 
-// Animation pointer type
-typedef struct AnimationNode {
-  void (*step_func)(struct AnimationNode*);   //< Function to call when stepping animation
+// Value being animated, stored inline
+typedef union {
+  GRect                   grect;              //< Value for GRect animations
+  GPoint                  gpoint;             //< Value for GPoint animations
+  int32_t                 int32;              //< Value for int32 animations
+} AnimationValue;
+
+// Animation node type
+typedef struct {
   void                    *target;            //< Pointer to value being animated
-  void                    *from;              //< Pointer to value to animate from
-  void                    *to;                //< Pointer to value to animate to
+  AnimationValue          from;               //< Value to animate from
+  AnimationValue          to;                 //< Value to animate to
   uint64_t                start_time;         //< Millisecond epoch of when animation was started
   uint32_t                duration;           //< Duration of animation in milliseconds
   uint32_t                delay;              //< Time to wait before animating
   InterpolationCurve      interpolation;      //< The interpolation mode to use with this animation
-  struct AnimationNode    *next;              //< Pointer to next node in linked list
+  AnimationType           type;               //< The type of value being animated
+  bool                    from_set;           //< Whether the "from" value has been captured yet
+  int8_t                  prev;               //< Index of previous node in active or free list
+  int8_t                  next;               //< Index of next node in active or free list
+  int8_t                  target_next;        //< Index of next newer node with the same target
 } AnimationNode;
 
+// Index entry mapping a target pointer to its animations
+typedef struct {
+  void                    *target;            //< Pointer to value being animated
+  int8_t                  head;               //< Index of oldest node for this target
+  int8_t                  tail;               //< Index of newest node for this target
+} AnimationIndexEntry;
+
 // Animation framework data
-static AnimationNode  *head_node = NULL;      //< Head node in linked list containing all animations
+static AnimationNode        ani_nodes[ANIMATION_MAX_COUNT];   //< Table of all animation nodes
+static AnimationIndexEntry  ani_index[ANIMATION_INDEX_SIZE];  //< Index of nodes by target pointer
+static int8_t         active_head = ANIMATION_NONE; //< Oldest running animation
+static int8_t         active_tail = ANIMATION_NONE; //< Newest running animation
+static int8_t         free_head = ANIMATION_NONE;   //< First unused node in the table
+static bool           ani_table_ready = false;      //< Whether the free list has been built
 static AppTimer       *ani_timer = NULL;      //< AppTimer for stepping all animations
 static void   (*ani_callback)(void) = NULL;   //< Animation update callback
+#ifdef BUILD_PERF_HUD
+static uint64_t       ani_last_tick = 0;      //< Millisecond epoch of the last animation tick
+static uint16_t       ani_frame_time = 0;     //< Time between the last two animation ticks
+#endif
 
 // Functions
 static void prv_animation_timer_start(void);
@@ -40,105 +84,250 @@ static void prv_animation_timer_start(void);
 // Private Functions
 //
 
-// Step a GRect animation
-static void prv_animation_step_grect(AnimationNode *node) {
-  // set from grect on first call, allowing another animation to change the target value
-  // while this animation is delayed
-  if (!node->from) {
-    node->from = MALLOC(sizeof(GRect));
-    (*(GRect*)node->from) = (*(GRect*)node->target);
+// Reset the node table, index, and lists to empty
+static void prv_table_reset(void) {
+  for (int8_t ii = 0; ii < ANIMATION_MAX_COUNT; ii++) {
+    ani_nodes[ii].next = (ii + 1 < ANIMATION_MAX_COUNT) ? ii + 1 : ANIMATION_NONE;
   }
-  // step value
-  GRect from = (*(GRect*)node->from);
-  GRect to = (*(GRect*)node->to);
-  uint32_t percent_max = node->duration;
-  uint32_t percent = epoch() - (node->start_time + node->delay);
-  (*(GRect*)node->target).origin.x = interpolation_integer(from.origin.x, to.origin.x, percent,
-    percent_max, node->interpolation);
-  (*(GRect*)node->target).origin.y = interpolation_integer(from.origin.y, to.origin.y, percent,
-    percent_max, node->interpolation);
-  (*(GRect*)node->target).size.w = interpolation_integer(from.size.w, to.size.w, percent,
-    percent_max, node->interpolation);
-  (*(GRect*)node->target).size.h = interpolation_integer(from.size.h, to.size.h, percent,
-    percent_max, node->interpolation);
-  // continue animation
-  if (percent >= percent_max) {
-    animation_stop(node->target);
+  for (int8_t ii = 0; ii < ANIMATION_INDEX_SIZE; ii++) {
+    ani_index[ii] = (AnimationIndexEntry) {
+      .target = NULL,
+      .head = ANIMATION_NONE,
+      .tail = ANIMATION_NONE
+    };
   }
+  free_head = 0;
+  active_head = active_tail = ANIMATION_NONE;
+  ani_table_ready = true;
 }
 
-// Step a GRect animation
-static void prv_animation_step_gpoint(AnimationNode *node) {
-  // set from gpoint on first call, allowing another animation to change the target value
-  // while this animation is delayed
-  if (!node->from) {
-    node->from = MALLOC(sizeof(GPoint));
-    (*(GPoint*)node->from) = (*(GPoint*)node->target);
+// Get the home slot of a target pointer in the index
+static uint8_t prv_index_hash(void *target) {
+  return ((uintptr_t)target >> 2) & (ANIMATION_INDEX_SIZE - 1);
+}
+
+// Find the index entry for a target pointer, returns NULL if it has no animations
+static AnimationIndexEntry *prv_index_find(void *target) {
+  uint8_t slot = prv_index_hash(target);
+  while (ani_index[slot].target) {
+    if (ani_index[slot].target == target) {
+      return &ani_index[slot];
+    }
+    slot = (slot + 1) & (ANIMATION_INDEX_SIZE - 1);
   }
-  // step value
-  GPoint from = (*(GPoint*)node->from);
-  GPoint to = (*(GPoint*)node->to);
-  uint32_t percent_max = node->duration;
-  uint32_t percent = epoch() - (node->start_time + node->delay);
-  (*(GPoint*)node->target).x = interpolation_integer(from.x, to.x, percent,
-                                                     percent_max, node->interpolation);
-  (*(GPoint*)node->target).y = interpolation_integer(from.y, to.y, percent,
-                                                     percent_max, node->interpolation);
-  // continue animation
-  if (percent >= percent_max) {
-    animation_stop(node->target);
+  return NULL;
+}
+
+// Find or create the index entry for a target pointer
+static AnimationIndexEntry *prv_index_find_or_add(void *target) {
+  uint8_t slot = prv_index_hash(target);
+  while (ani_index[slot].target && ani_index[slot].target != target) {
+    slot = (slot + 1) & (ANIMATION_INDEX_SIZE - 1);
+  }
+  ani_index[slot].target = target;
+  return &ani_index[slot];
+}
+
+// Remove an index entry, shifting back any following entries so probing stays unbroken
+static void prv_index_remove(AnimationIndexEntry *entry) {
+  uint8_t hole = entry - ani_index;
+  uint8_t slot = (hole + 1) & (ANIMATION_INDEX_SIZE - 1);
+  while (ani_index[slot].target) {
+    // move the entry into the hole if the hole lies between its home slot and its current slot
+    uint8_t home = prv_index_hash(ani_index[slot].target);
+    if (((slot - home) & (ANIMATION_INDEX_SIZE - 1)) >=
+        ((slot - hole) & (ANIMATION_INDEX_SIZE - 1))) {
+      ani_index[hole] = ani_index[slot];
+      hole = slot;
+    }
+    slot = (slot + 1) & (ANIMATION_INDEX_SIZE - 1);
+  }
+  ani_index[hole] = (AnimationIndexEntry) {
+    .target = NULL,
+    .head = ANIMATION_NONE,
+    .tail = ANIMATION_NONE
+  };
+}
+
+// Unlink a node from the active list and target index and return it to the free list
+static void prv_node_remove(int8_t index) {
+  AnimationNode *node = &ani_nodes[index];
+  // unlink from active list
+  if (node->prev != ANIMATION_NONE) {
+    ani_nodes[node->prev].next = node->next;
+  } else {
+    active_head = node->next;
+  }
+  if (node->next != ANIMATION_NONE) {
+    ani_nodes[node->next].prev = node->prev;
+  } else {
+    active_tail = node->prev;
+  }
+  // unlink from target chain, nodes complete in the order they are started so this is usually
+  // the head of the chain
+  AnimationIndexEntry *entry = prv_index_find(node->target);
+  if (entry) {
+    if (entry->head == index) {
+      entry->head = node->target_next;
+    } else {
+      int8_t cur = entry->head;
+      while (ani_nodes[cur].target_next != index) {
+        cur = ani_nodes[cur].target_next;
+      }
+      ani_nodes[cur].target_next = node->target_next;
+      if (entry->tail == index) {
+        entry->tail = cur;
+      }
+    }
+    if (entry->head == ANIMATION_NONE) {
+      prv_index_remove(entry);
+    }
+  }
+  // return to free list
+  node->target = NULL;
+  node->prev = ANIMATION_NONE;
+  node->next = free_head;
+  free_head = index;
+}
+
+// Write a value into the target pointer
+static void prv_set_target_value(AnimationNode *node, AnimationValue value) {
+  switch (node->type) {
+    case AnimationTypeGRect:
+      (*(GRect*)node->target) = value.grect;
+      break;
+    case AnimationTypeGPoint:
+      (*(GPoint*)node->target) = value.gpoint;
+      break;
+    case AnimationTypeInt32:
+      (*(int32_t*)node->target) = value.int32;
+      break;
   }
 }
 
-// Step a int32 animation
-static void prv_animation_step_int32(AnimationNode *node) {
+// Step an animation, returns true when it is complete
+static bool prv_animation_step(AnimationNode *node) {
   // set from value on first call, allowing another animation to change the target value
   // while this animation is delayed
-  if (!node->from) {
-    node->from = MALLOC(sizeof(int32_t));
-    (*(int32_t*)node->from) = (*(int32_t*)node->target);
+  if (!node->from_set) {
+    switch (node->type) {
+      case AnimationTypeGRect:
+        node->from.grect = (*(GRect*)node->target);
+        break;
+      case AnimationTypeGPoint:
+        node->from.gpoint = (*(GPoint*)node->target);
+        break;
+      case AnimationTypeInt32:
+        node->from.int32 = (*(int32_t*)node->target);
+        break;
+    }
+    node->from_set = true;
   }
-  // step value
-  int32_t from = (*(int32_t*)node->from);
-  int32_t to = (*(int32_t*)node->to);
+  // step value, calculating the eased progress once for all components
   uint32_t percent_max = node->duration;
   uint32_t percent = epoch() - (node->start_time + node->delay);
-  (*(int32_t*)node->target) = interpolation_integer(from, to, percent, percent_max,
-    node->interpolation);
-  // continue animation
-  if (percent >= percent_max) {
-    animation_stop(node->target);
+  int32_t progress = interpolation_progress(percent, percent_max, node->interpolation);
+  AnimationValue from = node->from, to = node->to;
+  switch (node->type) {
+    case AnimationTypeGRect:
+      (*(GRect*)node->target).origin.x = interpolation_apply(from.grect.origin.x,
+        to.grect.origin.x, progress);
+      (*(GRect*)node->target).origin.y = interpolation_apply(from.grect.origin.y,
+        to.grect.origin.y, progress);
+      (*(GRect*)node->target).size.w = interpolation_apply(from.grect.size.w,
+        to.grect.size.w, progress);
+      (*(GRect*)node->target).size.h = interpolation_apply(from.grect.size.h,
+        to.grect.size.h, progress);
+      break;
+    case AnimationTypeGPoint:
+      (*(GPoint*)node->target).x = interpolation_apply(from.gpoint.x, to.gpoint.x, progress);
+      (*(GPoint*)node->target).y = interpolation_apply(from.gpoint.y, to.gpoint.y, progress);
+      break;
+    case AnimationTypeInt32:
+      (*(int32_t*)node->target) = interpolation_apply(from.int32, to.int32, progress);
+      break;
   }
+  return percent >= percent_max;
 }
 
-// Add node to end of linked list
-static void prv_list_add_node(AnimationNode *node) {
-  if (!head_node) {
-    head_node = node;
-    return;
+// Claim a node from the table and add it to the end of the active list
+// If the table is full, the oldest animation is finished immediately and its node is reused
+static AnimationNode *prv_node_add(void *target, AnimationType type, AnimationValue to,
+                                   uint32_t duration, uint32_t delay,
+                                   InterpolationCurve interpolation) {
+  if (!ani_table_ready) {
+    prv_table_reset();
+  }
+  // apply overflow policy
+  if (free_head == ANIMATION_NONE) {
+    AnimationNode *oldest = &ani_nodes[active_head];
+    prv_set_target_value(oldest, oldest->to);
+    prv_node_remove(active_head);
+  }
+  // pop node from free list
+  int8_t index = free_head;
+  AnimationNode *node = &ani_nodes[index];
+  free_head = node->next;
+  (*node) = (AnimationNode) {
+    .target = target,
+    .to = to,
+    .start_time = epoch(),
+    .duration = duration,
+    .delay = delay,
+    .interpolation = interpolation,
+    .type = type,
+    .from_set = false, // assigned on first "step" callback in case of delayed animation
+    .prev = active_tail,
+    .next = ANIMATION_NONE,
+    .target_next = ANIMATION_NONE
+  };
+  // append to active list
+  if (active_tail != ANIMATION_NONE) {
+    ani_nodes[active_tail].next = index;
+  } else {
+    active_head = index;
   }
-  AnimationNode *cur_node = head_node;
-  while (cur_node->next) {
-    cur_node = cur_node->next;
+  active_tail = index;
+  // append to target chain
+  AnimationIndexEntry *entry = prv_index_find_or_add(target);
+  if (entry->tail != ANIMATION_NONE) {
+    ani_nodes[entry->tail].target_next = index;
+  } else {
+    entry->head = index;
   }
-  cur_node->next = node;
+  entry->tail = index;
+  // start animation timer if not running
+  prv_animation_timer_start();
+  return node;
 }
 
 // Animation timer callback
 static void prv_animation_timer_callback(void *data) {
   ani_timer = NULL;
   // loop over list and step each animation
-  AnimationNode *cur_node = head_node;
-  while (cur_node) {
-    if (epoch() > cur_node->start_time + (uint64_t)cur_node->delay) {
-      (*cur_node->step_func)(cur_node);
+  uint64_t cur_epoch = epoch();
+#ifdef BUILD_PERF_HUD
+  ani_frame_time = ani_last_tick ? cur_epoch - ani_last_tick : 0;
+  ani_last_tick = cur_epoch;
+#endif
+  int8_t index = active_head, next;
+  while (index != ANIMATION_NONE) {
+    AnimationNode *node = &ani_nodes[index];
+    next = node->next;
+    if (cur_epoch > node->start_time + (uint64_t)node->delay && prv_animation_step(node)) {
+      prv_node_remove(index);
     }
-    cur_node = cur_node->next;
+    index = next;
   }
   // continue animation
-  if (head_node) {
+  if (active_head != ANIMATION_NONE) {
     prv_animation_timer_start();
   }
+#ifdef BUILD_PERF_HUD
+  else {
+    ani_last_tick = 0;
+  }
+#endif
   // raise animation update callback
   if (ani_callback) {
     ani_callback();
@@ -160,100 +349,40 @@ static void prv_animation_timer_start(void) {
 // Animate a GRect by its pointer
 void animation_grect_start(GRect *ptr, GRect to, uint32_t duration, uint32_t delay,
                            InterpolationCurve interpolation) {
-  // create and add new node
-  AnimationNode *new_node = (AnimationNode*)MALLOC(sizeof(AnimationNode));
-  new_node->step_func = &prv_animation_step_grect;
-  new_node->target = ptr;
-  new_node->from = NULL; // assigned on first "step" callback in case of delayed animation
-  new_node->to = MALLOC(sizeof(GRect));
-  (*(GRect*)new_node->to) = to;
-  new_node->start_time = epoch();
-  new_node->duration = duration;
-  new_node->delay = delay;
-  new_node->interpolation = interpolation;
-  new_node->next = NULL;
-  prv_list_add_node(new_node);
-  // start animation timer if not running
-  prv_animation_timer_start();
+  prv_node_add(ptr, AnimationTypeGRect, (AnimationValue){ .grect = to }, duration, delay,
+    interpolation);
 }
 
 // Animate a GPoint by its pointer
 void animation_gpoint_start(GPoint *ptr, GPoint to, uint32_t duration, uint32_t delay,
                             InterpolationCurve interpolation) {
-  // create and add new node
-  AnimationNode *new_node = (AnimationNode*)MALLOC(sizeof(AnimationNode));
-  new_node->step_func = &prv_animation_step_gpoint;
-  new_node->target = ptr;
-  new_node->from = NULL; // assigned on first "step" callback in case of delayed animation
-  new_node->to = MALLOC(sizeof(GPoint));
-  (*(GPoint*)new_node->to) = to;
-  new_node->start_time = epoch();
-  new_node->duration = duration;
-  new_node->delay = delay;
-  new_node->interpolation = interpolation;
-  new_node->next = NULL;
-  prv_list_add_node(new_node);
-  // start animation timer if not running
-  prv_animation_timer_start();
+  prv_node_add(ptr, AnimationTypeGPoint, (AnimationValue){ .gpoint = to }, duration, delay,
+    interpolation);
 }
 
 // Animate an integer by its pointer
 void animation_int32_start(int32_t *ptr, int32_t to, uint32_t duration, uint32_t delay,
                            InterpolationCurve interpolation) {
-  // create and add new node
-  AnimationNode *new_node = (AnimationNode*)MALLOC(sizeof(AnimationNode));
-  new_node->step_func = &prv_animation_step_int32;
-  new_node->target = ptr;
-  new_node->from = NULL; // assigned on first "step" callback in case of delayed animation
-  new_node->to = MALLOC(sizeof(int32_t));
-  (*(int32_t*)new_node->to) = to;
-  new_node->start_time = epoch();
-  new_node->duration = duration;
-  new_node->delay = delay;
-  new_node->interpolation = interpolation;
-  new_node->next = NULL;
-  prv_list_add_node(new_node);
-  // start animation timer if not running
-  prv_animation_timer_start();
+  prv_node_add(ptr, AnimationTypeInt32, (AnimationValue){ .int32 = to }, duration, delay,
+    interpolation);
 }
 
 // Check if pointer has a scheduled animation
 bool animation_check_scheduled(void *ptr) {
-  AnimationNode *cur_node = head_node;
-  while (cur_node) {
-    if (cur_node->target == ptr) {
-      return true;
-    }
-    cur_node = cur_node->next;
-  }
-  return false;
+  return prv_index_find(ptr);
 }
 
 // Check if any animation is scheduled
 bool animation_any_scheduled(void) {
-  return head_node;
+  return active_head != ANIMATION_NONE;
 }
 
-// Cancel an animation by its pointer
+// Cancel every animation on a pointer
 void animation_stop(void *ptr) {
-  AnimationNode *cur_node = head_node;
-  AnimationNode *pre_node = NULL;
-  while (cur_node) {
-    if (cur_node->target == ptr) {
-      // link surrounding nodes
-      if (pre_node) {
-        pre_node->next = cur_node->next;
-      } else {
-        head_node = cur_node->next;
-      }
-      // destroy node
-      free(cur_node->from);
-      free(cur_node->to);
-      free(cur_node);
-      return;
-    }
-    pre_node = cur_node;
-    cur_node = cur_node->next;
+  // the index entry is removed along with the last node in its chain
+  AnimationIndexEntry *entry;
+  while ((entry = prv_index_find(ptr))) {
+    prv_node_remove(entry->head);
   }
 }
 
@@ -264,20 +393,16 @@ void animation_stop_all(void) {
     app_timer_cancel(ani_timer);
     ani_timer = NULL;
   }
-  // destroy all animations
-  AnimationNode *cur_node = head_node;
-  AnimationNode *tmp_node = NULL;
-  while (cur_node) {
-    // index node
-    tmp_node = cur_node;
-    cur_node = cur_node->next;
-    // destroy node
-    free(tmp_node->from);
-    free(tmp_node->to);
-    free(tmp_node);
-  }
-  head_node = NULL;
+  // return all nodes to the free list
+  prv_table_reset();
+}
+
+#ifdef BUILD_PERF_HUD
+// Get the time between the last two animation ticks
+uint16_t animation_get_frame_time(void) {
+  return ani_frame_time;
 }
+#endif
 
 // Register animation update callback
 void animation_register_update_callback(void *callback) {
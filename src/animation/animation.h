@@ -13,6 +13,10 @@
 #include <pebble.h>
 #include "interpolation.h"
 
+// Constants
+#define ANIMATION_MAX_COUNT 8   //< Maximum number of simultaneous animations (oldest is finished
+                                //< immediately when a new animation is started on a full table)
+
 //! Animate a GRect by its pointer
 //! @param prt A pointer to the GRect to animate
 //! @param to The GRect to animate the pointer to
@@ -49,13 +53,19 @@ bool animation_check_scheduled(void *ptr);
 //! @return True if an animation is running else false
 bool animation_any_scheduled(void);
 
-//! Cancel an animation by its pointer
-//! @param ptr A pointer for which to cancel an animation
+//! Cancel every animation on a pointer, including delayed ones which have not yet started
+//! @param ptr A pointer for which to cancel the animations
 void animation_stop(void *ptr);
 
 //! Cancel all running animations
 void animation_stop_all(void);
 
+#ifdef BUILD_PERF_HUD
+//! Get the time between the last two animation ticks
+//! @return The last frame time in milliseconds
+uint16_t animation_get_frame_time(void);
+#endif
+
 //! Register animation update callback
 //! @param callback A pointer to the function to call when updating
 void animation_register_update_callback(void *callback);
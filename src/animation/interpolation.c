@@ -5,6 +5,10 @@
 // of different easing modes. Several convenience functions also exist
 // for interpolating different Pebble data types
 //
+// Each easing curve is sampled into a fixed point lookup table, so evaluating
+// a curve is a table lookup and a linear blend between the two nearest samples.
+// The eased progress is then applied to each value with a single multiply-shift.
+//
 // @author Eric D. Phillips
 // @date October 31, 2015
 // @bug No known bugs
@@ -12,72 +16,51 @@
 #include <pebble.h>
 #include "interpolation.h"
 
+// Constants
+#define CURVE_TABLE_SHIFT 5           //< Log2 of the number of segments in each curve table
+#define CURVE_TABLE_SEGMENTS (1 << CURVE_TABLE_SHIFT)  //< Number of segments in each curve table
+#define PROGRESS_SHIFT 15             //< Log2 of INTERPOLATION_PROGRESS_MAX
+#define SEGMENT_SHIFT (PROGRESS_SHIFT - CURVE_TABLE_SHIFT)  //< Log2 of progress per table segment
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Private Functions
-//
-
-// Linear interpolation
-static int32_t prv_curve_linear(int32_t from, int32_t to, uint32_t percent, uint32_t percent_max) {
-  return from + (to - from) * (int32_t)percent / (int32_t)percent_max;
-}
-
-//// Quadratic interpolation in
-//static int32_t prv_curve_quad_ease_in(int32_t from, int32_t to, uint32_t percent,
-//                                      uint32_t percent_max) {
-//  int32_t t_percent = percent * 100 / percent_max;
-//  return (to - from) * t_percent * t_percent / 10000 + from;
-//}
-//
-//// Quadratic interpolation out
-//static int32_t prv_curve_quad_ease_out(int32_t from, int32_t to, uint32_t percent,
-//                                       uint32_t percent_max) {
-//  int32_t t_percent = percent * 100 / percent_max;
-//  return - (to - from) * t_percent * (t_percent - 200) / 10000 + from;
-//}
-//
-//// Quadratic interpolation in out
-//static int32_t prv_curve_quad_ease_in_out(int32_t from, int32_t to, uint32_t percent,
-//                                          uint32_t percent_max) {
-//  int32_t t_percent = percent * 100 / (percent_max / 2);
-//  if (t_percent < 100) {
-//    return (to - from) / 2 * t_percent * t_percent / 10000 + from;
-//  }
-//  t_percent -= 100;
-//  return -(to - from) / 2 * (t_percent * (t_percent - 200) - 10000) / 10000 + from;
-//}
-//
-//// Sinusoidal interpolation in
-//static int32_t prv_curve_sin_ease_in(int32_t from, int32_t to, uint32_t percent,
-//                                     uint32_t percent_max) {
-//  return (-((to - from) / 2) * cos_lookup(TRIG_MAX_ANGLE * percent / percent_max / 4)) /
-//  (TRIG_MAX_RATIO / 2) + (to - from) + from;
-//}
-
-// Sinusoidal interpolation out
-static int32_t prv_curve_sin_ease_out(int32_t from, int32_t to, uint32_t percent,
-                                      uint32_t percent_max) {
-  return (((to - from) / 2) * sin_lookup(TRIG_MAX_ANGLE * percent / percent_max / 4)) /
-    (TRIG_MAX_RATIO / 2) + from;
-}
-
-//// Sinusoidal interpolation in out
-//static int32_t prv_curve_sin_ease_in_out(int32_t from, int32_t to, uint32_t percent,
-//                                         uint32_t percent_max) {
-//  return (-((to - from) / 2) * (cos_lookup(TRIG_MAX_ANGLE * percent / percent_max / 2) -
-//    (TRIG_MAX_RATIO / 2)) / 2) / TRIG_MAX_RATIO + from;
-//}
-
-// Array of interpolation function pointers
-typedef int32_t (*InterpolationFunction)(int32_t, int32_t, uint32_t, uint32_t);
-InterpolationFunction interpolation_functions[] = {
-  prv_curve_linear,
-//  prv_curve_quad_ease_in,
-//  prv_curve_quad_ease_out,
-//  prv_curve_quad_ease_in_out,
-//  prv_curve_sin_ease_in,
-  prv_curve_sin_ease_out,
-//  prv_curve_sin_ease_in_out
+// Easing curves sampled at CURVE_TABLE_SEGMENTS + 1 evenly spaced points with
+// INTERPOLATION_PROGRESS_MAX as 1.0. Linear needs no table.
+//   quad in:      t^2
+//   quad out:     1 - (1 - t)^2
+//   quad in out:  2t^2 for t < 1/2, else 1 - 2(1 - t)^2
+//   sin in:       1 - cos(t * pi / 2)
+//   sin out:      sin(t * pi / 2)
+//   sin in out:   (1 - cos(t * pi)) / 2
+static const uint16_t prv_curve_tables[][CURVE_TABLE_SEGMENTS + 1] = {
+  [CurveQuadEaseIn] = {
+    0, 32, 128, 288, 512, 800, 1152, 1568, 2048, 2592, 3200, 3872, 4608, 5408, 6272, 7200, 8192,
+    9248, 10368, 11552, 12800, 14112, 15488, 16928, 18432, 20000, 21632, 23328, 25088, 26912,
+    28800, 30752, 32768
+  },
+  [CurveQuadEaseOut] = {
+    0, 2016, 3968, 5856, 7680, 9440, 11136, 12768, 14336, 15840, 17280, 18656, 19968, 21216,
+    22400, 23520, 24576, 25568, 26496, 27360, 28160, 28896, 29568, 30176, 30720, 31200, 31616,
+    31968, 32256, 32480, 32640, 32736, 32768
+  },
+  [CurveQuadEaseInOut] = {
+    0, 64, 256, 576, 1024, 1600, 2304, 3136, 4096, 5184, 6400, 7744, 9216, 10816, 12544, 14400,
+    16384, 18368, 20224, 21952, 23552, 25024, 26368, 27584, 28672, 29632, 30464, 31168, 31744,
+    32192, 32512, 32704, 32768
+  },
+  [CurveSinEaseIn] = {
+    0, 39, 158, 355, 630, 982, 1411, 1915, 2494, 3146, 3869, 4662, 5522, 6448, 7438, 8489, 9598,
+    10762, 11980, 13248, 14563, 15922, 17321, 18758, 20228, 21729, 23256, 24806, 26375, 27960,
+    29556, 31160, 32768
+  },
+  [CurveSinEaseOut] = {
+    0, 1608, 3212, 4808, 6393, 7962, 9512, 11039, 12540, 14010, 15447, 16846, 18205, 19520,
+    20788, 22006, 23170, 24279, 25330, 26320, 27246, 28106, 28899, 29622, 30274, 30853, 31357,
+    31786, 32138, 32413, 32610, 32729, 32768
+  },
+  [CurveSinEaseInOut] = {
+    0, 79, 315, 705, 1247, 1935, 2761, 3719, 4799, 5990, 7282, 8661, 10114, 11628, 13188, 14778,
+    16384, 17990, 19580, 21140, 22654, 24107, 25486, 26778, 27969, 29049, 30007, 30833, 31521,
+    32063, 32453, 32689, 32768
+  }
 };
 
 
@@ -85,13 +68,34 @@ InterpolationFunction interpolation_functions[] = {
 // API Functions
 //
 
+// Get the eased progress through an animation
+int32_t interpolation_progress(uint32_t percent, uint32_t percent_max, InterpolationCurve curve) {
+  if (percent >= percent_max) {
+    return INTERPOLATION_PROGRESS_MAX;
+  }
+  int32_t progress = ((uint64_t)percent << PROGRESS_SHIFT) / percent_max;
+  if (curve == CurveLinear) {
+    return progress;
+  }
+  // blend between the two nearest samples
+  const uint16_t *table = prv_curve_tables[curve];
+  int32_t index = progress >> SEGMENT_SHIFT;
+  int32_t fraction = progress & ((1 << SEGMENT_SHIFT) - 1);
+  return table[index] + (((table[index + 1] - table[index]) * fraction) >> SEGMENT_SHIFT);
+}
+
+// Interpolate an integer by an eased progress
+int32_t interpolation_apply(int32_t from, int32_t to, int32_t progress) {
+  return from + (int32_t)(((int64_t)(to - from) * progress) >> PROGRESS_SHIFT);
+}
+
 // Interpolate an integer
 int32_t interpolation_integer(int32_t from, int32_t to, uint32_t percent, uint32_t percent_max,
                               InterpolationCurve curve) {
   if (percent >= percent_max) {
     return to;
   }
-  return interpolation_functions[curve](from, to, percent, percent_max);
+  return interpolation_apply(from, to, interpolation_progress(percent, percent_max, curve));
 }
 
 //// Interpolate a GPoint
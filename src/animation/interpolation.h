@@ -11,17 +11,34 @@
 #pragma once
 #include <pebble.h>
 
+// Constants
+#define INTERPOLATION_PROGRESS_MAX 32768  //< Fixed point value of a fully eased progress (1.0)
+
 //! List of different interpolation curves
 typedef enum InterpolationCurve {
   CurveLinear,
-//  CurveQuadEaseIn,
-//  CurveQuadEaseOut,
-//  CurveQuadEaseInOut,
-//  CurveSinEaseIn,
+  CurveQuadEaseIn,
+  CurveQuadEaseOut,
+  CurveQuadEaseInOut,
+  CurveSinEaseIn,
   CurveSinEaseOut,
-//  CurveSinEaseInOut
+  CurveSinEaseInOut
 } InterpolationCurve;
 
+//! Get the eased progress through an animation, calculate once and apply to each value
+//! @param percent The percent of the way into the animation
+//! @param percent_max The maximum percent to end the animation at
+//! @param curve The interpolation curve to use while calculating the progress
+//! @return The eased progress from 0 to INTERPOLATION_PROGRESS_MAX
+int32_t interpolation_progress(uint32_t percent, uint32_t percent_max, InterpolationCurve curve);
+
+//! Interpolate an integer by an eased progress
+//! @param from The beginning value
+//! @param to The ending value
+//! @param progress The eased progress as returned by interpolation_progress
+//! @return The interpolated value
+int32_t interpolation_apply(int32_t from, int32_t to, int32_t progress);
+
 //! Interpolation for integer value
 //! @param from The beginning value
 //! @param to The ending value
@@ -31,6 +31,9 @@ static uint8_t prv_alert_colors[][4] = {
   { GColorWhiteARGB8, GColorLightGrayARGB8, GColorWhiteARGB8, GColorLightGrayARGB8 }
 };
 #endif
+#ifdef BUILD_PERF_HUD
+static uint16_t prv_load_latency = 0;
+#endif
 static char *prv_alert_text[][4] = {
   { "Low Alert" },
   { "Low Alert", "Med Alert" },
@@ -45,6 +48,9 @@ static char *prv_alert_text[][4] = {
 
 // Sit and wait until data is loaded from the background
 static void prv_load_data_from_background(DataAPI *data_api, uint16_t data_pt_start_index) {
+#ifdef BUILD_PERF_HUD
+  uint64_t start_epoch = epoch();
+#endif
   // delete any old data that may be loaded
   persist_delete(TEMP_LOCK_KEY);
   persist_delete(TEMP_COMMUNICATION_KEY);
@@ -70,6 +76,9 @@ static void prv_load_data_from_background(DataAPI *data_api, uint16_t data_pt_st
     // wait
     psleep(1);
   }
+#ifdef BUILD_PERF_HUD
+  prv_load_latency = epoch() - start_epoch;
+#endif
 }
 
 
@@ -79,7 +88,12 @@ static void prv_load_data_from_background(DataAPI *data_api, uint16_t data_pt_st
 
 // Get the color of an alert from a table of colors based on index
 GColor data_api_get_alert_color(DataAPI *data_api, uint8_t index) {
-  return (GColor){ .argb = prv_alert_colors[data_api_get_alert_count(data_api) - 1][index] };
+  return data_api_get_alert_color_for_count(data_api_get_alert_count(data_api), index);
+}
+
+// Get the color of an alert without a DataAPI
+GColor data_api_get_alert_color_for_count(uint8_t alert_count, uint8_t index) {
+  return (GColor){ .argb = prv_alert_colors[alert_count - 1][index] };
 }
 
 // Get the text of an alert from a table of text based on index
@@ -173,6 +187,27 @@ uint8_t data_api_get_battery_percent(DataAPI *data_api) {
   return percent;
 };
 
+// Get the time the estimated battery percentage will next change
+time_t data_api_get_battery_percent_change_time(DataAPI *data_api) {
+  // the estimate drops one percent every -charge_rate seconds after the last data point
+  int32_t seconds_per_percent = -data_api->charge_rate;
+  if (seconds_per_percent <= 0) {
+    return 0;
+  }
+  int32_t elapsed = time(NULL) - data_api->data_pt_epochs[0];
+  if (elapsed < 0) {
+    elapsed = 0;
+  }
+  int32_t percent = data_api->data_pt_percents[0] - elapsed / seconds_per_percent;
+  // no change once the estimate is held at its lower limit
+  BatteryChargeState battery_state = battery_state_service_peek();
+  battery_state.charge_percent += BATTERY_PERCENTAGE_OFFSET;
+  if (percent <= battery_state.charge_percent - 10 || percent <= 1) {
+    return 0;
+  }
+  return data_api->data_pt_epochs[0] + (elapsed / seconds_per_percent + 1) * seconds_per_percent;
+}
+
 // Get a data point by its index with 0 being the most recent
 bool data_api_get_data_point(DataAPI *data_api, uint16_t index, int32_t *epoch,
                              uint8_t *percent) {
@@ -193,16 +228,26 @@ bool data_api_get_data_point(DataAPI *data_api, uint16_t index, int32_t *epoch,
   return true;
 };
 
+// Get the times for the timeline pins, the charge by time followed by each alert's fire time
+uint8_t data_api_get_pin_times(DataAPI *data_api, int32_t *pin_times) {
+  pin_times[0] = data_api_get_charge_by_time(data_api);
+  for (uint8_t ii = 0; ii < data_api_get_alert_count(data_api); ii++) {
+    pin_times[ii + 1] = pin_times[0] - data_api_get_alert_threshold(data_api, ii);
+  }
+  return data_api_get_alert_count(data_api) + 1;
+}
+
 // Get the number of charge cycles currently loaded into memory
 uint16_t data_api_get_charge_cycle_count(DataAPI *data_api) {
   return data_api->cycle_count + 1;
 }
 
-// Print the data to the console in CSV format
-void data_api_print_csv(DataAPI *data_api) {
-  AppWorkerMessage message;
-  app_worker_send_message(WorkerMessageExportData, &message);
-};
+#ifdef BUILD_PERF_HUD
+// Get the time the last data load from the background worker took
+uint16_t data_api_get_load_latency(void) {
+  return prv_load_latency;
+}
+#endif
 
 // Destroy data and reload from persistent storage
 void data_api_reload(DataAPI *data_api) {
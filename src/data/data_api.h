@@ -26,12 +26,17 @@ typedef void(*BatteryAPIAlertCallback)(uint8_t);
 //
 
 //! Get the color of an alert from a table of colors based on index
-//! Note: This function reads from persistent storage if a DataAPI is NULL
-//! @param data_api Optional pointer to DataAPI to prevent persistent storage read
+//! @param data_api A pointer to an existing DataAPI
 //! @param index The index of the alert
 //! @return A GColor which represents that level of alert
 GColor data_api_get_alert_color(DataAPI *data_api, uint8_t index);
 
+//! Get the color of an alert without a DataAPI, such as from an AlertFireRecord
+//! @param alert_count The total number of alerts scheduled
+//! @param index The index of the alert
+//! @return A GColor which represents that level of alert
+GColor data_api_get_alert_color_for_count(uint8_t alert_count, uint8_t index);
+
 //! Get the text of an alert from a table of text based on index
 //! Note: This function reads from persistent storage if a DataAPI is NULL
 //! @param data_api Optional pointer to DataAPI to prevent persistent storage read
@@ -93,6 +98,11 @@ int32_t data_api_get_max_life(DataAPI *data_api, uint16_t index);
 //! @return An estimate of the current exact battery percent
 uint8_t data_api_get_battery_percent(DataAPI *data_api);
 
+//! Get the time the estimated battery percentage will next change
+//! @param data_api A pointer to an existing DataAPI
+//! @return The UTC epoch of the next change, or 0 if it will not change until new data arrives
+time_t data_api_get_battery_percent_change_time(DataAPI *data_api);
+
 //! Get a data point by its index with 0 being the most recent
 //! @param data_api A pointer to an existing DataAPI
 //! @param index The index of the point to get
@@ -102,14 +112,22 @@ uint8_t data_api_get_battery_percent(DataAPI *data_api);
 bool data_api_get_data_point(DataAPI *data_api, uint16_t index, int32_t *epoch,
                              uint8_t *percent);
 
+//! Get the times for the timeline pins, the charge by time followed by each alert's fire time
+//! @param data_api A pointer to an existing DataAPI
+//! @param pin_times Array of at least DATA_PIN_MAX_COUNT to which to write the times
+//! @return The number of times written
+uint8_t data_api_get_pin_times(DataAPI *data_api, int32_t *pin_times);
+
 //! Get the number of charge cycles currently loaded into memory
 //! @param data_api A pointer to an existing DataAPI
 //! @return The number of cycles loaded into memory
 uint16_t data_api_get_charge_cycle_count(DataAPI *data_api);
 
-//! Print the data to the console in CSV format
-//! @param data_api A pointer to an existing DataAPI
-void data_api_print_csv(DataAPI *data_api);
+#ifdef BUILD_PERF_HUD
+//! Get the time the last data load from the background worker took
+//! @return The latency of the last load in milliseconds
+uint16_t data_api_get_load_latency(void);
+#endif
 
 //! Destroy data and reload from persistent storage
 //! @param data_api A pointer to an existing DataAPI
@@ -0,0 +1,66 @@
+//! @file data_format.h
+//! @brief Binary formats of the battery history
+//!
+//! Layouts of the data points as they are written to persistent storage and sent with data
+//! logging. This file only depends on the C standard library so the same definitions are used
+//! by the worker and by host tools reading dumps of the data, keeping the formats in step.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//! Constants
+#define DATA_VERSION 1                  //< The current persistent storage format version
+#define DATA_VERSION_UNCHECKED 0        //< Format version of blocks written without a check value
+#define DATA_BLOCK_SAVE_STATE_COUNT 50  //< Number of SaveStates that fit in one persistent write
+#define DATA_EPOCH_OFFSET 1420070400    //< Jan 1, 2015 at 0:00:00, reduces size when saving data
+#define BATTERY_PERCENTAGE_OFFSET 10    //< Percentage to add to the battery to increase accuracy
+#define DATA_LOG_VERSION 1              //< The format version of records sent with data logging
+
+//! Structure containing compressed data in the form it will be saved in
+typedef struct {
+  unsigned  epoch       : 30;   //< The epoch timestamp for when the percentage changed in seconds
+  unsigned  percent     : 7;    //< The battery charge percent
+  bool      charging    : 1;    //< The charging state of the battery
+  bool      plugged     : 1;    //< The plugged in state of the watch
+  bool      contiguous  : 1;    //< Whether the worker stayed active since the last data point
+} __attribute__((__packed__)) SaveState;
+
+//! Data structure used when saving to and reading from persistent storage
+//! Includes a header with extra stats. The check value is the CRC of the block's index followed
+//! by the block with the check value zeroed, so a block only verifies at the index it was
+//! written for. Blocks of DATA_VERSION_UNCHECKED, including those restored from the phone, have
+//! a check value of 0.
+typedef struct {
+  unsigned    data_version          : 8;            //< The data version format for this block
+  signed      initial_charge_rate   : 24;           //< The charge rate after first point in block
+  unsigned    check                 : 10;           //< CRC-10 of the block index and the block
+  unsigned    save_state_count      : 6;            //< The number of data points written
+  SaveState save_states[DATA_BLOCK_SAVE_STATE_COUNT];  //< The actual data state points being stored
+} __attribute__((__packed__)) SaveStateBlock;
+
+//! Record sent to the phone with data logging
+typedef struct {
+  uint8_t     version;              //< The format version of the record
+  SaveState   save_state;           //< The data point
+} __attribute__((__packed__)) DataLogRecord;
+
+//! Summary of the history evicted from persistent storage by the retention policy
+typedef struct {
+  uint32_t    first_epoch;          //< Time of the oldest evicted point, less DATA_EPOCH_OFFSET
+  uint32_t    last_epoch;           //< Time of the newest evicted point, less DATA_EPOCH_OFFSET
+  uint32_t    point_count;          //< Number of evicted data points
+  uint32_t    discharge_seconds;    //< Time spent discharging between contiguous evicted points
+  uint32_t    discharge_percent;    //< Percent dropped over that time
+  uint32_t    charge_count;         //< Number of times charging started
+} RetentionRollup;
+
+_Static_assert(sizeof(SaveState) == 5, "SaveState must stay 5 bytes");
+_Static_assert(sizeof(SaveStateBlock) == 256, "SaveStateBlock must fill one persistent write");
+_Static_assert(sizeof(DataLogRecord) == 6, "DataLogRecord must stay 6 bytes");
+_Static_assert(sizeof(RetentionRollup) == 24, "RetentionRollup must stay 24 bytes");
@@ -15,24 +15,40 @@
 #else
 #include <pebble.h>
 #endif
+#include "data_format.h"
 
 
 //! Constants
 #define DATA_ALERT_MAX_COUNT 4          //< The maximum number of alerts to allow
+#define DATA_PIN_MAX_COUNT (DATA_ALERT_MAX_COUNT + 1) //< Charge by pin plus one pin per alert
 #define CHARGE_CYCLE_MAX_COUNT 9        //< The maximum number of charge cycles to load
 #define DATA_POINT_MAX_COUNT 50         //< The maximum number of data points to load
-#define BATTERY_PERCENTAGE_OFFSET 10    //< Percentage to add to the battery to increase accuracy
+#define DATA_BLOCK_KEY_COUNT 16         //< Number of keys in the circular range of data blocks
 
 //! Persistent Keys
 #define PERSIST_DATA_KEY 1000           //< The persistent storage key where the data write starts
 #define PERSIST_RECORD_LIFE_KEY 999     //< Persistent storage key where the record life is stored
 #define PERSIST_ALERTS_KEY 998          //< Persistent storage key for number of alerts scheduled
-#define WAKE_UP_ALERT_INDEX_KEY 997     //< Persistent storage key for alerts
+#define ALERT_FIRE_KEY 997              //< Persistent storage key of the last alert to go off
 #define TEMP_COMMUNICATION_KEY 996      //< Key used when writing data for the foreground
 #define TEMP_LOCK_KEY 995               //< Key used when writing data for the foreground
 #define PERSIST_TIMELINE_KEY 994        //< Persistent storage key where timeline enabled is stored
+#define PIN_TIMES_KEY 993               //< Persistent storage key where the pin times are published
+#define PERSIST_ROLLUP_KEY 992          //< Persistent storage key of the evicted history's summary
+#define PERSIST_MIGRATION_KEY 991       //< Exists while blocks move into the circular range of keys
 #define DATA_LOGGING_TAG 5155346        //< Tag used to identify data once on phone
 
+//! Persistent storage key of the data block with an index, in the range after PERSIST_DATA_KEY
+#define DATA_BLOCK_KEY(index) (PERSIST_DATA_KEY + 1 + (index) % DATA_BLOCK_KEY_COUNT)
+
+//! Indices of the data blocks, written to PERSIST_DATA_KEY
+//! Indices count up without bound and are stored at DATA_BLOCK_KEY(index), so there are never
+//! more than DATA_BLOCK_KEY_COUNT blocks and the keys of indices outside the range are empty.
+typedef struct {
+  uint32_t    oldest_index;       //< Index of the oldest block
+  uint32_t    newest_index;       //< Index of the block being written, which may not exist yet
+} DataBlockRing;
+
 //! Data structure for foreground
 typedef struct DataAPI {
   int32_t     alert_threshold[DATA_ALERT_MAX_COUNT];    //< The threshold for an alert to go off at
@@ -50,12 +66,19 @@ typedef struct DataAPI {
   uint8_t     data_pt_count;      //< The total number of raw data points loaded
 } DataAPI;
 
+//! Alert which went off, written by the worker so the popup can show it in a single read
+typedef struct {
+  int32_t     threshold;          //< The threshold of the alert in seconds
+  int32_t     charge_by_time;     //< The time the watch will hit 0% in seconds since epoch
+  uint8_t     alert_index;        //< The index of the alert
+  uint8_t     alert_count;        //< The total number of alerts scheduled
+} AlertFireRecord;
+
 //! App worker message commands
 typedef enum {
   WorkerMessageSendData,
   WorkerMessageReloadData,
   WorkerMessageScheduleAlert,
   WorkerMessageUnscheduleAlert,
-  WorkerMessageAlertEvent,
-  WorkerMessageExportData
+  WorkerMessageAlertEvent
 } WorkerMessage;
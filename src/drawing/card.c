@@ -13,6 +13,7 @@
 
 #include <pebble.h>
 #include "card.h"
+#include "../memory_manager.h"
 #include "../utility.h"
 
 // Main data structure
@@ -23,7 +24,12 @@ typedef struct {
   uint16_t            click_count;            //< Number of select click events on this card
   bool                pending_refresh;        //< If the card needs to be re-rendered into the cache
   CardRenderHandler   render_handler;         //< Function pointer to render specific card
+  CardNextChangeHandler next_change_handler;  //< Function pointer to get next change time
   DataAPI             *data_api;              //< Pointer to the main data library
+#ifdef BUILD_PERF_HUD
+  uint16_t            render_time;            //< Duration of the last render and cache in ms
+  bool                cache_hit;              //< Whether the last draw came from the cache
+#endif
 } CardLayer;
 
 
@@ -36,6 +42,8 @@ static void prv_create_screen_bitmap(CardLayer *card_layer, GContext *ctx) {
   // capture frame buffer and get properties
   GBitmap *old_bmp = graphics_capture_frame_buffer(ctx);
   GRect bmp_bounds = gbitmap_get_bounds(old_bmp);
+  // make room by freeing the caches of cards which are out of view
+  memory_reserve(gbitmap_get_bytes_per_row(old_bmp) * bmp_bounds.size.h, MemoryPriorityLow);
   // copy to new bitmap and save
 #ifdef PBL_BW
   GBitmapFormat bmp_format = gbitmap_get_format(old_bmp);
@@ -165,15 +173,25 @@ static void prv_layer_update_handler(Layer *layer, GContext *ctx) {
     graphics_fill_rect(ctx, bounds, 0, GCornerNone);
     // if centered in screen, render and cache GContext as bitmap
     if (layer_is_screen_aligned) {
+#ifdef BUILD_PERF_HUD
+      uint64_t start_epoch = epoch();
+#endif
       // render card
       card_layer->render_handler(layer, ctx, card_layer->click_count, card_layer->data_api);
       // cache as bitmap
       if (card_layer->bmp_buff) {
         gbitmap_destroy(card_layer->bmp_buff);
+        card_layer->bmp_buff = NULL;
       }
       prv_create_screen_bitmap(card_layer, ctx);
       card_layer->pending_refresh = false;
+#ifdef BUILD_PERF_HUD
+      card_layer->render_time = epoch() - start_epoch;
+#endif
     }
+#ifdef BUILD_PERF_HUD
+    card_layer->cache_hit = false;
+#endif
 #ifndef PBL_BW
     if (!card_layer->bmp_buff) {
       // draw loading text
@@ -190,6 +208,9 @@ static void prv_layer_update_handler(Layer *layer, GContext *ctx) {
     GRect bounds = layer_get_bounds(layer);
     bounds.origin = GPointZero;
     graphics_draw_bitmap_in_rect(ctx, card_layer->bmp_buff, bounds);
+#ifdef BUILD_PERF_HUD
+    card_layer->cache_hit = true;
+#endif
   }
 }
 
@@ -224,9 +245,25 @@ void card_select_click(Layer *layer) {
   card_render(layer);
 }
 
+#ifdef BUILD_PERF_HUD
+// Get the render statistics of the card
+void card_get_perf_stats(Layer *layer, uint16_t *render_time, bool *cache_hit) {
+  CardLayer *card_layer = layer_get_data(layer);
+  (*render_time) = card_layer->render_time;
+  (*cache_hit) = card_layer->cache_hit;
+}
+#endif
+
+// Get the time the rendered values of the card will next change
+time_t card_get_next_change(Layer *layer) {
+  CardLayer *card_layer = layer_get_data(layer);
+  return card_layer->next_change_handler(layer, card_layer->click_count, card_layer->data_api);
+}
+
 // Initialize card
 Layer *card_initialize(GRect bounds, GBitmapFormat bmp_format, GColor background_color,
-                       CardRenderHandler render_handler, DataAPI *data_api) {
+                       CardRenderHandler render_handler,
+                       CardNextChangeHandler next_change_handler, DataAPI *data_api) {
   // create base layer with extra data
   Layer *layer = layer_create_with_data(bounds, sizeof(CardLayer));
   ASSERT(layer);
@@ -238,7 +275,12 @@ Layer *card_initialize(GRect bounds, GBitmapFormat bmp_format, GColor background
   card_layer->click_count = 0;
   card_layer->pending_refresh = false;
   card_layer->render_handler = render_handler;
+  card_layer->next_change_handler = next_change_handler;
   card_layer->data_api = data_api;
+#ifdef BUILD_PERF_HUD
+  card_layer->render_time = 0;
+  card_layer->cache_hit = false;
+#endif
   // return layer pointer
   return layer;
 }
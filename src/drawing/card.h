@@ -18,6 +18,9 @@
 //! Card callback type
 typedef void (*CardRenderHandler)(Layer*, GContext*, uint16_t, DataAPI*);
 
+//! Card next change callback type, returns the epoch the card will next look different
+typedef time_t (*CardNextChangeHandler)(Layer*, uint16_t, DataAPI*);
+
 
 //! Free the rendered cache of the card if it is not visible
 //! @param layer Pointer to base layer for card
@@ -31,15 +34,30 @@ void card_render(Layer *layer);
 //! Send click event to current card and re-render
 void card_select_click(Layer *layer);
 
+//! Get the time the rendered values of the card will next change
+//! @param layer Pointer to base layer for card
+//! @return The UTC epoch of the next change, or 0 if it will not change until new data arrives
+time_t card_get_next_change(Layer *layer);
+
+#ifdef BUILD_PERF_HUD
+//! Get the render statistics of the card
+//! @param layer Pointer to base layer for card
+//! @param render_time Pointer to set to the last render and cache time in milliseconds
+//! @param cache_hit Pointer to set to whether the card was last drawn from its cache
+void card_get_perf_stats(Layer *layer, uint16_t *render_time, bool *cache_hit);
+#endif
+
 //! Initialize card
 //! @param bounds The dimensions of the window
 //! @param bmp_format The GBitmapFormat to cache the rendered screen in
 //! @param background_color The background fill color of the card
 //! @param render_handler The function which will be called to render this card
+//! @param next_change_handler The function which will be called to get the next change time
 //! @param data_api A pointer to the main data library from which to get information
 //! @return A pointer to the base layer of this card
 Layer *card_initialize(GRect bounds, GBitmapFormat bmp_format, GColor background_color,
-                       CardRenderHandler render_handler, DataAPI *data_api);
+                       CardRenderHandler render_handler,
+                       CardNextChangeHandler next_change_handler, DataAPI *data_api);
 
 //! Terminate card
 //! @param layer Pointer to base layer for card
@@ -28,6 +28,23 @@
 // Private Functions
 //
 
+// Get the sums of the run times and max lives and the largest value to scale the graph by
+static void prv_get_cycle_stats(DataAPI *data_api, int32_t *run_time_sum, int32_t *max_life_sum,
+                                int32_t *graph_y_max) {
+  (*run_time_sum) = (*max_life_sum) = (*graph_y_max) = 0;
+  uint16_t cycle_point_count = data_api_get_charge_cycle_count(data_api);
+  for (uint16_t ii = 0; ii < cycle_point_count; ii++) {
+    (*run_time_sum) += data_api_get_run_time(data_api, ii);
+    (*max_life_sum) += data_api_get_max_life(data_api, ii);
+    if (data_api_get_run_time(data_api, ii) > (*graph_y_max)) {
+      (*graph_y_max) = data_api_get_run_time(data_api, ii);
+    }
+    if (data_api_get_max_life(data_api, ii) > (*graph_y_max)) {
+      (*graph_y_max) = data_api_get_max_life(data_api, ii);
+    }
+  }
+}
+
 // Render text
 static void prv_render_text(GContext *ctx, GRect bounds, uint16_t click_count) {
   // get text
@@ -53,20 +70,10 @@ static void prv_render_bars(GContext *ctx, GRect bounds, uint16_t click_count,
   GRect graph_bounds = GRect(GRAPH_HORIZONTAL_INSET, GRAPH_TOP_INSET, bounds.size.w -
     GRAPH_HORIZONTAL_INSET * 2, bounds.size.h - GRAPH_TOP_INSET - GRAPH_BOTTOM_INSET);
   // get properties
-  int32_t avg_run_time = 0, avg_max_life = 0;
+  int32_t avg_run_time, avg_max_life, graph_y_max;
   int16_t bar_width = graph_bounds.size.w / GRAPH_NUMBER_OF_BARS;
-  int32_t graph_y_max = 0;
   uint16_t cycle_point_count = data_api_get_charge_cycle_count(data_api);
-  for (uint16_t ii = 0; ii < cycle_point_count; ii++) {
-    avg_run_time += data_api_get_run_time(data_api, ii);
-    avg_max_life += data_api_get_max_life(data_api, ii);
-    if (data_api_get_run_time(data_api, ii) > graph_y_max) {
-      graph_y_max = data_api_get_run_time(data_api, ii);
-    }
-    if (data_api_get_max_life(data_api, ii) > graph_y_max) {
-      graph_y_max = data_api_get_max_life(data_api, ii);
-    }
-  }
+  prv_get_cycle_stats(data_api, &avg_run_time, &avg_max_life, &graph_y_max);
   avg_max_life /= cycle_point_count;
   avg_run_time /= cycle_point_count;
   GRect bar_bounds;
@@ -172,3 +179,19 @@ void card_render_bar_graph(Layer *layer, GContext *ctx, uint16_t click_count,
   // render text
   prv_render_text(ctx, bounds, click_count);
 }
+
+// Next change function for bar graph card
+time_t card_next_change_bar_graph(Layer *layer, uint16_t click_count, DataAPI *data_api) {
+  int32_t run_time_sum, max_life_sum, graph_y_max;
+  prv_get_cycle_stats(data_api, &run_time_sum, &max_life_sum, &graph_y_max);
+  // the current run time bar grows one pixel every graph_y_max / height seconds
+  int32_t graph_height = layer_get_bounds(layer).size.h - GRAPH_TOP_INSET - GRAPH_BOTTOM_INSET;
+  time_t next_change = card_render_next_step_time(data_api_get_run_time(data_api, 0),
+    graph_y_max / graph_height, true);
+  // the average run time text changes hours once the sum has grown by an hour per cycle
+  if (click_count % CLICK_MODE_MAX == 1) {
+    next_change = card_render_earliest_time(next_change, card_render_next_step_time(run_time_sum,
+      SEC_IN_HR * data_api_get_charge_cycle_count(data_api), true));
+  }
+  return next_change;
+}
@@ -44,3 +44,22 @@ void card_render_rich_text(GContext *ctx, GRect bounds, uint8_t array_length,
       GTextAlignmentLeft, NULL);
   }
 }
+
+// Get the time a value which changes one-to-one with time will next cross a multiple of a step
+time_t card_render_next_step_time(int32_t value, int32_t step, bool increasing) {
+  if (value < 0 || step <= 0) {
+    return 0;
+  }
+  if (increasing) {
+    return time(NULL) + step - value % step;
+  }
+  return time(NULL) + value % step + 1;
+}
+
+// Get the earlier of two change times, where 0 represents no change
+time_t card_render_earliest_time(time_t time_a, time_t time_b) {
+  if (!time_a || (time_b && time_b < time_a)) {
+    return time_b;
+  }
+  return time_a;
+}
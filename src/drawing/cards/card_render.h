@@ -38,6 +38,19 @@ typedef struct {
 void card_render_rich_text(GContext *ctx, GRect bounds, uint8_t array_length,
                            RichTextElement *rich_text);
 
+//! Get the time a value which changes one-to-one with time will next cross a multiple of a step
+//! @param value The current value in seconds
+//! @param step The size of the step in seconds, at which the displayed value changes
+//! @param increasing True if the value increases with time, false if it decreases
+//! @return The UTC epoch of the next step change, or 0 if the value is negative or step invalid
+time_t card_render_next_step_time(int32_t value, int32_t step, bool increasing);
+
+//! Get the earlier of two change times, where 0 represents no change
+//! @param time_a The first change time
+//! @param time_b The second change time
+//! @return The earliest non-zero time, or 0 if neither will change
+time_t card_render_earliest_time(time_t time_a, time_t time_b);
+
 
 //! Rendering function for dashboard card
 //! @param layer The base layer for this card
@@ -47,6 +60,13 @@ void card_render_rich_text(GContext *ctx, GRect bounds, uint8_t array_length,
 void card_render_dashboard(Layer *layer, GContext *ctx, uint16_t click_count,
                            DataAPI *data_api);
 
+//! Next change function for dashboard card, returns when the rendered values will next change
+//! @param layer The base layer for this card
+//! @param click_count Number of select click events on this card
+//! @param data_api A pointer to the main data library
+//! @return The UTC epoch of the next change, or 0 if it will not change until new data arrives
+time_t card_next_change_dashboard(Layer *layer, uint16_t click_count, DataAPI *data_api);
+
 //! Rendering function for line graph card
 //! @param layer The base layer for this card
 //! @param ctx The graphics context which will be rendered on
@@ -55,6 +75,13 @@ void card_render_dashboard(Layer *layer, GContext *ctx, uint16_t click_count,
 void card_render_line_graph(Layer *layer, GContext *ctx, uint16_t click_count,
                             DataAPI *data_api);
 
+//! Next change function for line graph card, returns when the rendered values will next change
+//! @param layer The base layer for this card
+//! @param click_count Number of select click events on this card
+//! @param data_api A pointer to the main data library
+//! @return The UTC epoch of the next change, or 0 if it will not change until new data arrives
+time_t card_next_change_line_graph(Layer *layer, uint16_t click_count, DataAPI *data_api);
+
 //! Rendering function for bar graph card
 //! @param layer The base layer for this card
 //! @param ctx The graphics context which will be rendered on
@@ -63,6 +90,13 @@ void card_render_line_graph(Layer *layer, GContext *ctx, uint16_t click_count,
 void card_render_bar_graph(Layer *layer, GContext *ctx, uint16_t click_count,
                            DataAPI *data_api);
 
+//! Next change function for bar graph card, returns when the rendered values will next change
+//! @param layer The base layer for this card
+//! @param click_count Number of select click events on this card
+//! @param data_api A pointer to the main data library
+//! @return The UTC epoch of the next change, or 0 if it will not change until new data arrives
+time_t card_next_change_bar_graph(Layer *layer, uint16_t click_count, DataAPI *data_api);
+
 //! Rendering function for record life card
 //! @param layer The base layer for this card
 //! @param ctx The graphics context which will be rendered on
@@ -70,3 +104,10 @@ void card_render_bar_graph(Layer *layer, GContext *ctx, uint16_t click_count,
 //! @param data_api A pointer to the main data library
 void card_render_record_life(Layer *layer, GContext *ctx, uint16_t click_count,
                            DataAPI *data_api);
+
+//! Next change function for record life card, returns when the rendered values will next change
+//! @param layer The base layer for this card
+//! @param click_count Number of select click events on this card
+//! @param data_api A pointer to the main data library
+//! @return The UTC epoch of the next change, or 0 if it will not change until new data arrives
+time_t card_next_change_record_life(Layer *layer, uint16_t click_count, DataAPI *data_api);
@@ -18,12 +18,25 @@
 #define RING_WIDTH PBL_IF_ROUND_ELSE(18, 16)
 #define SELECTED_TEXT_INSET PBL_IF_ROUND_ELSE(GEdgeInsets3(-2, 23, 22), GEdgeInsets3(4, 6, 6))
 #define SELECTED_TEXT_CORNER_RAD PBL_IF_ROUND_ELSE(7, 4)
+#define RING_ANGLE_STEPS 360      //< Number of steps around the ring which are visibly different
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Private Functions
 //
 
+// Get the number of selection modes, the first two plus one for each alert not yet passed
+static uint16_t prv_get_selection_mode_count(DataAPI *data_api) {
+  int32_t life_remaining = data_api_get_life_remaining(data_api);
+  uint16_t mode_count = 2;
+  for (uint8_t index = 0; index < data_api_get_alert_count(data_api); index++) {
+    if (life_remaining > data_api_get_alert_threshold(data_api, index)) {
+      mode_count++;
+    }
+  }
+  return mode_count;
+}
+
 // Render battery percent text
 static void prv_render_battery_percent(GContext *ctx, GRect bounds, DataAPI *data_api) {
   // get text
@@ -49,12 +62,7 @@ static void prv_render_selected_text(GContext *ctx, GRect bounds, uint16_t click
   char *hint_text;
   GColor selection_color;
   int32_t selection_value = data_api_get_life_remaining(data_api);
-  uint16_t tmp_max_modes = 2;
-  for (uint8_t index = 0; index < data_api_get_alert_count(data_api); index++) {
-    if (selection_value > data_api_get_alert_threshold(data_api, index)) {
-      tmp_max_modes++;
-    }
-  }
+  uint16_t tmp_max_modes = prv_get_selection_mode_count(data_api);
   uint16_t cur_mode = click_count % tmp_max_modes;
   if (cur_mode == 0) {
     hint_text = "Remaining";
@@ -196,3 +204,31 @@ void card_render_dashboard(Layer *layer, GContext *ctx, uint16_t click_count,
   // render selected text
   prv_render_selected_text(ctx, bounds, click_count, data_api);
 }
+
+// Next change function for dashboard card
+time_t card_next_change_dashboard(Layer *layer, uint16_t click_count, DataAPI *data_api) {
+  int32_t life_remaining = data_api_get_life_remaining(data_api);
+  // battery percent text
+  time_t next_change = data_api_get_battery_percent_change_time(data_api);
+  // ring angle
+  next_change = card_render_earliest_time(next_change, card_render_next_step_time(life_remaining,
+    data_api_get_max_life(data_api, 0) / RING_ANGLE_STEPS, false));
+  // selection modes change as alert thresholds are passed
+  for (uint8_t index = 0; index < data_api_get_alert_count(data_api); index++) {
+    int32_t threshold = data_api_get_alert_threshold(data_api, index);
+    if (life_remaining > threshold) {
+      next_change = card_render_earliest_time(next_change,
+        time(NULL) + life_remaining - threshold);
+    }
+  }
+  // selected text shows days and hours of remaining or run time
+  uint16_t cur_mode = click_count % prv_get_selection_mode_count(data_api);
+  if (cur_mode == 0) {
+    next_change = card_render_earliest_time(next_change,
+      card_render_next_step_time(life_remaining, SEC_IN_HR, false));
+  } else if (cur_mode == 1) {
+    next_change = card_render_earliest_time(next_change,
+      card_render_next_step_time(data_api_get_run_time(data_api, 0), SEC_IN_HR, true));
+  }
+  return next_change;
+}
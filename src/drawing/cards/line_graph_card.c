@@ -26,6 +26,30 @@
 // Private Functions
 //
 
+// Get the time span of the graph for the current click mode
+static int32_t prv_get_graph_x_range(uint16_t click_count) {
+  switch (click_count % CLICK_MODE_MAX) {
+    case 1:
+#ifdef PBL_PLATFORM_CHALK
+      return SEC_IN_DAY;
+#else
+      return SEC_IN_DAY * 3;
+#endif
+    case 2:
+#ifdef PBL_PLATFORM_CHALK
+      return SEC_IN_DAY * 7;
+#else
+      return SEC_IN_DAY * 14;
+#endif
+    default:
+#ifdef PBL_PLATFORM_CHALK
+      return SEC_IN_DAY * 3;
+#else
+      return SEC_IN_WEEK;
+#endif
+  }
+}
+
 // Render text
 static void prv_render_text(GContext *ctx, GRect bounds) {
   bounds.origin.y += TEXT_BORDER_TOP;
@@ -150,29 +174,7 @@ void card_render_line_graph(Layer *layer, GContext *ctx, uint16_t click_count,
   GRect bounds = layer_get_bounds(layer);
   bounds.origin = GPointZero;
   // get graph x range
-  int32_t graph_x_range;
-  switch (click_count % CLICK_MODE_MAX) {
-    case 1:
-#ifdef PBL_PLATFORM_CHALK
-      graph_x_range = SEC_IN_DAY;
-#else
-      graph_x_range = SEC_IN_DAY * 3;
-#endif
-      break;
-    case 2:
-#ifdef PBL_PLATFORM_CHALK
-      graph_x_range = SEC_IN_DAY * 7;
-#else
-      graph_x_range = SEC_IN_DAY * 14;
-#endif
-      break;
-    default:
-#ifdef PBL_PLATFORM_CHALK
-      graph_x_range = SEC_IN_DAY * 3;
-#else
-      graph_x_range = SEC_IN_WEEK;
-#endif
-  }
+  int32_t graph_x_range = prv_get_graph_x_range(click_count);
   // render graph line and fill
   prv_render_line(ctx, bounds, graph_x_range, data_api);
   // render graph axis with days of the week
@@ -180,3 +182,14 @@ void card_render_line_graph(Layer *layer, GContext *ctx, uint16_t click_count,
   // render text
   prv_render_text(ctx, bounds);
 }
+
+// Next change function for line graph card
+time_t card_next_change_line_graph(Layer *layer, uint16_t click_count, DataAPI *data_api) {
+  // the graph and axis scroll one pixel every graph_x_range / width seconds
+  int32_t graph_width = layer_get_bounds(layer).size.w - GRAPH_HORIZONTAL_INSET * 2;
+  int32_t pixel_period = prv_get_graph_x_range(click_count) / graph_width;
+  time_t next_change = card_render_next_step_time(time(NULL), pixel_period, true);
+  // the right edge of the graph is the current battery percent
+  return card_render_earliest_time(next_change,
+    data_api_get_battery_percent_change_time(data_api));
+}
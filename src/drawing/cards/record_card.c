@@ -17,6 +17,7 @@
 #define IMAGE_TOP_OFFSET 15
 #define PROGRESS_BAR_WIDTH PBL_IF_RECT_ELSE(50, 25)
 #define LINE_STROKE_WIDTH 2
+#define RECORD_ANGLE_STEPS 360    //< Number of steps around the progress ring which are visible
 
 
 
@@ -148,3 +149,23 @@ void card_render_record_life(Layer *layer, GContext *ctx, uint16_t click_count,
   // render text
   prv_render_text(ctx, bounds, data_api);
 }
+
+// Next change function for record life card
+time_t card_next_change_record_life(Layer *layer, uint16_t click_count, DataAPI *data_api) {
+  int32_t run_time = data_api_get_run_time(data_api, 0);
+  int32_t record_run_time = data_api_get_record_run_time(data_api);
+  // the progress bar grows one step every record / length seconds
+#ifdef PBL_RECT
+  int32_t progress_steps = layer_get_bounds(layer).size.h;
+#else
+  int32_t progress_steps = RECORD_ANGLE_STEPS;
+#endif
+  time_t next_change = card_render_next_step_time(run_time, record_run_time / progress_steps,
+    true);
+  // the record text counts up with the run time once the record is being beaten
+  if (run_time >= record_run_time) {
+    next_change = card_render_earliest_time(next_change,
+      card_render_next_step_time(run_time, SEC_IN_HR, true));
+  }
+  return next_change;
+}
@@ -13,6 +13,7 @@
 #include "../animation/animation.h"
 #include "card.h"
 #include "cards/card_render.h"
+#include "../memory_manager.h"
 #include "../utility.h"
 
 // Constants
@@ -22,6 +23,8 @@
 #define ACTION_DOT_RADIUS 15
 #define ACTION_DOT_OPEN_INSET PBL_IF_RECT_ELSE(5, 9)
 #define ACTION_DOT_CLOSE_DURATION 150
+#define PERF_HUD_INSET PBL_IF_ROUND_ELSE(GEdgeInsets2(18, 30), GEdgeInsets1(2))
+#define PERF_HUD_HEIGHT 32
 
 // Main data struct
 static struct {
@@ -32,6 +35,15 @@ static struct {
   int32_t   scroll_offset;                    //< The final offset of the 0'th card after animation
   int32_t   action_dot_inset_ani;             //< The inset from the left of the screen for the
   // dot
+  int32_t   last_scroll_offset;               //< Value of scroll_offset_ani on the last tick
+  int32_t   last_action_dot_inset;            //< Value of action_dot_inset_ani on the last tick
+  bool      scrolling;                        //< If the cards are moving towards scroll_offset
+  bool      queued_press;                     //< If the last press arrived while scrolling
+  bool      pending_render;                   //< If the destination card is rendered once settled
+#ifdef BUILD_PERF_HUD
+  uint64_t  press_epoch;                      //< Time of the first press of the current scroll
+  uint16_t  scroll_latency;                   //< Time from the last press to the cards settling
+#endif
 } drawing_data;
 
 
@@ -39,6 +51,13 @@ static struct {
 // Private Functions
 //
 
+// Get the index of the card at the scroll offset
+static uint8_t prv_get_card_index(int32_t scroll_offset) {
+  return (DRAWING_CARD_COUNT -
+    ((scroll_offset / drawing_data.window_bounds.size.h) % DRAWING_CARD_COUNT - 1)) %
+    DRAWING_CARD_COUNT;
+}
+
 // Position cards
 static void prv_position_cards(void) {
   GRect bounds = drawing_data.window_bounds;
@@ -50,6 +69,31 @@ static void prv_position_cards(void) {
   }
 }
 
+#ifdef BUILD_PERF_HUD
+// Render the performance overlay with card render times, frame time, heap, and load latency
+static void prv_render_perf_hud(GContext *ctx, GRect bounds) {
+  // build text
+  char buff[64];
+  uint16_t render_time;
+  bool cache_hit;
+  int pos = snprintf(buff, sizeof(buff), "R");
+  for (uint8_t ii = 0; ii < DRAWING_CARD_COUNT; ii++) {
+    card_get_perf_stats(drawing_data.card_layer[ii], &render_time, &cache_hit);
+    pos += snprintf(buff + pos, sizeof(buff) - pos, " %d%c", render_time, cache_hit ? '+' : '-');
+  }
+  snprintf(buff + pos, sizeof(buff) - pos, "\nF %d  H %d  L %d  S %d", animation_get_frame_time(),
+    (int)heap_bytes_free(), data_api_get_load_latency(), drawing_data.scroll_latency);
+  // draw background and text
+  GRect hud_bounds = grect_inset(bounds, PERF_HUD_INSET);
+  hud_bounds.size.h = PERF_HUD_HEIGHT;
+  graphics_context_set_fill_color(ctx, GColorBlack);
+  graphics_fill_rect(ctx, hud_bounds, 0, GCornerNone);
+  graphics_context_set_text_color(ctx, GColorWhite);
+  graphics_draw_text(ctx, buff, fonts_get_system_font(FONT_KEY_GOTHIC_14), hud_bounds,
+    GTextOverflowModeFill, GTextAlignmentCenter, NULL);
+}
+#endif
+
 // Topmost layer update proc handler
 static void prv_top_layer_update_proc_handler(Layer *layer, GContext *ctx) {
   // get bounds
@@ -61,17 +105,60 @@ static void prv_top_layer_update_proc_handler(Layer *layer, GContext *ctx) {
   graphics_context_set_antialiased(ctx, true);
   graphics_context_set_fill_color(ctx, GColorBlack);
   graphics_fill_circle(ctx, center, ACTION_DOT_RADIUS);
+#ifdef BUILD_PERF_HUD
+  // draw performance overlay
+  prv_render_perf_hud(ctx, bounds);
+#endif
 }
 
-// Animation callback handler
-static void prv_animation_handler(void) {
-  // update card positions
-  prv_position_cards();
-  // check if out of view
+// Called once the cards stop moving at the end of a scroll
+static void prv_scroll_settled(void) {
+  drawing_data.scrolling = false;
+  // free the caches of cards which ended up out of view
   for (int8_t ii = 0; ii < DRAWING_CARD_COUNT; ii++) {
     card_free_cache_if_hidden(drawing_data.card_layer[ii], false);
   }
-  // redraw topmost layer
+  // render the destination card if presses arrived faster than it could be rendered
+  if (drawing_data.pending_render) {
+    drawing_data.pending_render = false;
+    card_render(drawing_data.card_layer[prv_get_card_index(drawing_data.scroll_offset)]);
+  }
+#ifdef BUILD_PERF_HUD
+  drawing_data.scroll_latency = epoch() - drawing_data.press_epoch;
+  APP_LOG(APP_LOG_LEVEL_INFO, "Scroll settled in %d ms", drawing_data.scroll_latency);
+#endif
+}
+
+// Memory eviction handler for the caches of cards which are out of view
+static void prv_evict_hidden_caches(void *context) {
+  for (uint8_t ii = 0; ii < DRAWING_CARD_COUNT; ii++) {
+    card_free_cache_if_hidden(drawing_data.card_layer[ii], false);
+  }
+}
+
+// Memory eviction handler for the caches of all cards
+static void prv_evict_all_caches(void *context) {
+  drawing_free_caches();
+}
+
+// Animation callback handler
+static void prv_animation_handler(void) {
+  // update card positions only if the scroll offset moved
+  if (drawing_data.scroll_offset_ani != drawing_data.last_scroll_offset) {
+    drawing_data.last_scroll_offset = drawing_data.scroll_offset_ani;
+    prv_position_cards();
+  }
+  // check if the scroll has settled
+  if (drawing_data.scrolling && !animation_check_scheduled(&drawing_data.scroll_offset_ani)) {
+    prv_scroll_settled();
+  }
+  // redraw topmost layer only if the action dot moved
+#ifndef BUILD_PERF_HUD
+  if (drawing_data.action_dot_inset_ani == drawing_data.last_action_dot_inset) {
+    return;
+  }
+#endif
+  drawing_data.last_action_dot_inset = drawing_data.action_dot_inset_ani;
   layer_mark_dirty(drawing_data.top_layer);
 }
 
@@ -82,12 +169,16 @@ static void prv_animation_handler(void) {
 
 // Refresh current card
 void drawing_refresh(void) {
-  uint8_t card_index = (DRAWING_CARD_COUNT -
-    ((drawing_data.scroll_offset / drawing_data.window_bounds.size.h) % DRAWING_CARD_COUNT - 1)) %
-    DRAWING_CARD_COUNT;
+  uint8_t card_index = prv_get_card_index(drawing_data.scroll_offset);
   card_render(drawing_data.card_layer[card_index]);
 }
 
+// Get the time the current card will next change
+time_t drawing_get_next_change(void) {
+  uint8_t card_index = prv_get_card_index(drawing_data.scroll_offset);
+  return card_get_next_change(drawing_data.card_layer[card_index]);
+}
+
 // Free all card caches
 void drawing_free_caches(void) {
   // loop over cards and force them to free their cache
@@ -110,9 +201,7 @@ void drawing_set_action_menu_dot(bool visible) {
 // Select click handler for current card
 void drawing_select_click(void) {
   // get current card
-  uint8_t card_index = (DRAWING_CARD_COUNT -
-    ((drawing_data.scroll_offset / drawing_data.window_bounds.size.h) % DRAWING_CARD_COUNT - 1)) %
-    DRAWING_CARD_COUNT;
+  uint8_t card_index = prv_get_card_index(drawing_data.scroll_offset);
   // send click event
   card_select_click(drawing_data.card_layer[card_index]);
 }
@@ -120,10 +209,19 @@ void drawing_select_click(void) {
 
 // Render the next or previous card
 void drawing_render_next_card(bool up) {
+#ifdef BUILD_PERF_HUD
+  if (!drawing_data.scrolling) {
+    drawing_data.press_epoch = epoch();
+  }
+#endif
+  // queue the press if the cards are moving, as a card can't be rendered while it is being
+  // repositioned, the destination card is rendered once the scroll settles instead
+  drawing_data.queued_press = drawing_data.scrolling;
+  if (drawing_data.queued_press) {
+    return;
+  }
   // render the next card
-  uint8_t cur_card_index = (DRAWING_CARD_COUNT -
-    ((drawing_data.scroll_offset / drawing_data.window_bounds.size.h) % DRAWING_CARD_COUNT - 1)) %
-    DRAWING_CARD_COUNT;
+  uint8_t cur_card_index = prv_get_card_index(drawing_data.scroll_offset);
   uint8_t next_card_index = (cur_card_index + (up ? -1 : 1) + DRAWING_CARD_COUNT) %
     DRAWING_CARD_COUNT;
   // free the previous cache on Aplite
@@ -139,8 +237,13 @@ void drawing_render_next_card(bool up) {
 
 // Select next or previous card
 void drawing_select_next_card(bool up) {
-  // move target card position
+  // move target card position, queued presses accumulate into the final offset
   drawing_data.scroll_offset += (up ? 1 : -1) * drawing_data.window_bounds.size.h;
+  drawing_data.scrolling = true;
+  drawing_data.pending_render |= drawing_data.queued_press;
+  // drop the slide and bounce still in flight, so the only animations left on the offset are
+  // the new slide and bounce from where the cards are now to the final offset
+  animation_stop(&drawing_data.scroll_offset_ani);
   // animate slide
   animation_int32_start(&drawing_data.scroll_offset_ani,
     drawing_data.scroll_offset + (up ? 1 : -1) * CARD_BOUNCE_HEIGHT,
@@ -159,14 +262,15 @@ void drawing_initialize(Layer *window_layer, DataAPI *data_api) {
   // all the cards must initially be stacked on the screen so they can render themselves.
   // When scrolling begins, they will reposition.
   drawing_data.scroll_offset = drawing_data.scroll_offset_ani = -drawing_data.window_bounds.size.h;
+  drawing_data.last_scroll_offset = drawing_data.scroll_offset_ani;
   drawing_data.card_layer[0] = card_initialize(drawing_data.window_bounds, CARD_PALETTE_RECORD_LIFE,
-    CARD_BACK_COLOR_RECORD_LIFE, card_render_record_life, data_api);
+    CARD_BACK_COLOR_RECORD_LIFE, card_render_record_life, card_next_change_record_life, data_api);
   drawing_data.card_layer[1] = card_initialize(drawing_data.window_bounds, CARD_PALETTE_LINE_GRAPH,
-    CARD_BACK_COLOR_LINE_GRAPH, card_render_line_graph, data_api);
+    CARD_BACK_COLOR_LINE_GRAPH, card_render_line_graph, card_next_change_line_graph, data_api);
   drawing_data.card_layer[2] = card_initialize(drawing_data.window_bounds, CARD_PALETTE_DASHBOARD,
-    CARD_BACK_COLOR_DASHBOARD, card_render_dashboard, data_api);
+    CARD_BACK_COLOR_DASHBOARD, card_render_dashboard, card_next_change_dashboard, data_api);
   drawing_data.card_layer[3] = card_initialize(drawing_data.window_bounds, CARD_PALETTE_BAR_GRAPH,
-    CARD_BACK_COLOR_BAR_GRAPH, card_render_bar_graph, data_api);
+    CARD_BACK_COLOR_BAR_GRAPH, card_render_bar_graph, card_next_change_bar_graph, data_api);
   prv_position_cards();
   // add to window
   for (uint8_t ii = 0; ii < DRAWING_CARD_COUNT; ii++) {
@@ -179,10 +283,16 @@ void drawing_initialize(Layer *window_layer, DataAPI *data_api) {
   layer_add_child(window_layer, drawing_data.top_layer);
   // register animation handler
   animation_register_update_callback(prv_animation_handler);
+  // let the card caches be freed when memory runs low
+  memory_register_cache(prv_evict_hidden_caches, NULL, MemoryPriorityLow);
+  memory_register_cache(prv_evict_all_caches, NULL, MemoryPriorityHigh);
 }
 
 // Terminate all cards and free memory
 void drawing_terminate(void) {
+  // remove caches from memory manager
+  memory_unregister_cache(prv_evict_hidden_caches, NULL);
+  memory_unregister_cache(prv_evict_all_caches, NULL);
   // destroy topmost layer
   layer_destroy(drawing_data.top_layer);
   // destroy cards
@@ -20,6 +20,10 @@
 //! Refresh current card
 void drawing_refresh(void);
 
+//! Get the time the current card will next change
+//! @return The UTC epoch of the next change, or 0 if it will not change until new data arrives
+time_t drawing_get_next_change(void);
+
 //! Free all card caches
 void drawing_free_caches(void);
 
@@ -30,7 +34,7 @@ void drawing_set_action_menu_dot(bool visible);
 //! Select click handler for current card
 void drawing_select_click(void);
 
-//! Render the next or previous card
+//! Render the next or previous card, presses while scrolling are queued until it settles
 //! @param up True if the selection should move up, else false
 void drawing_render_next_card(bool up);
 
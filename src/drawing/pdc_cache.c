@@ -0,0 +1,129 @@
+// @file pdc_cache.c
+// @brief Shared cache of loaded PDC images and sequences
+//
+// Windows acquire PDC resources through the cache instead of loading them directly, so the
+// same asset shown several times is only parsed once. Resources which are no longer used stay
+// loaded until the memory manager needs the room back.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "pdc_cache.h"
+#include "../memory_manager.h"
+
+// Cached resource
+typedef struct {
+  void        *file;              //< Pointer to the loaded resource, NULL if the slot is empty
+  uint32_t    resource_id;        //< The ID of the resource
+  PDCType     type;               //< Type of the loaded resource
+  uint8_t     ref_count;          //< Number of users of the resource
+} PDCCacheEntry;
+
+// Main data struct
+static struct {
+  PDCCacheEntry entries[PDC_CACHE_MAX_COUNT]; //< Cached resources
+  bool          registered;                   //< If registered with the memory manager
+} pdc_cache_data;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Destroy the resource of an entry and empty its slot
+static void prv_entry_destroy(PDCCacheEntry *entry) {
+  if (entry->type == PDCTypeImage) {
+    gdraw_command_image_destroy(entry->file);
+  } else {
+    gdraw_command_sequence_destroy(entry->file);
+  }
+  entry->file = NULL;
+}
+
+// Memory eviction handler which destroys all unused resources
+static void prv_evict_unused(void *context) {
+  for (uint8_t ii = 0; ii < PDC_CACHE_MAX_COUNT; ii++) {
+    if (pdc_cache_data.entries[ii].file && !pdc_cache_data.entries[ii].ref_count) {
+      prv_entry_destroy(&pdc_cache_data.entries[ii]);
+    }
+  }
+}
+
+// Find a slot for a new entry, destroying an unused resource if none are empty
+static PDCCacheEntry *prv_entry_find_free(void) {
+  PDCCacheEntry *unused = NULL;
+  for (uint8_t ii = 0; ii < PDC_CACHE_MAX_COUNT; ii++) {
+    if (!pdc_cache_data.entries[ii].file) {
+      return &pdc_cache_data.entries[ii];
+    } else if (!pdc_cache_data.entries[ii].ref_count) {
+      unused = &pdc_cache_data.entries[ii];
+    }
+  }
+  if (unused) {
+    prv_entry_destroy(unused);
+  }
+  return unused;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+// Get a loaded PDC image or sequence, loading it if it is not cached
+void *pdc_cache_acquire(uint32_t resource_id, PDCType *type) {
+  // check for a cached copy
+  for (uint8_t ii = 0; ii < PDC_CACHE_MAX_COUNT; ii++) {
+    PDCCacheEntry *entry = &pdc_cache_data.entries[ii];
+    if (entry->file && entry->resource_id == resource_id) {
+      entry->ref_count++;
+      (*type) = entry->type;
+      return entry->file;
+    }
+  }
+  // get a slot for the resource
+  (*type) = PDCTypeUnknown;
+  PDCCacheEntry *entry = prv_entry_find_free();
+  if (!entry) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "PDC cache full");
+    return NULL;
+  }
+  if (!pdc_cache_data.registered) {
+    memory_register_cache(prv_evict_unused, NULL, MemoryPriorityMedium);
+    pdc_cache_data.registered = true;
+  }
+  // try to read the file and determine its type
+  entry->file = gdraw_command_image_create_with_resource(resource_id);
+  entry->type = PDCTypeImage;
+  if (!entry->file) {
+    entry->file = gdraw_command_sequence_create_with_resource(resource_id);
+    entry->type = PDCTypeSequence;
+  }
+  if (!entry->file) {
+    return NULL;
+  }
+  entry->resource_id = resource_id;
+  entry->ref_count = 1;
+  (*type) = entry->type;
+  return entry->file;
+}
+
+// Release a resource acquired from the cache
+void pdc_cache_release(void *file) {
+  for (uint8_t ii = 0; ii < PDC_CACHE_MAX_COUNT; ii++) {
+    if (file && pdc_cache_data.entries[ii].file == file) {
+      pdc_cache_data.entries[ii].ref_count--;
+      return;
+    }
+  }
+}
+
+// Destroy all unused resources and stop caching
+void pdc_cache_terminate(void) {
+  prv_evict_unused(NULL);
+  if (pdc_cache_data.registered) {
+    memory_unregister_cache(prv_evict_unused, NULL);
+    pdc_cache_data.registered = false;
+  }
+}
@@ -0,0 +1,36 @@
+//! @file pdc_cache.h
+//! @brief Shared cache of loaded PDC images and sequences
+//!
+//! Windows acquire PDC resources through the cache instead of loading them directly, so the
+//! same asset shown several times is only parsed once. Resources which are no longer used stay
+//! loaded until the memory manager needs the room back.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <pebble.h>
+
+// Constants
+#define PDC_CACHE_MAX_COUNT 4     //< Maximum number of resources loaded at once
+
+//! Type of a loaded PDC resource
+typedef enum {
+  PDCTypeImage,                   //< GDrawCommandImage
+  PDCTypeSequence,                //< GDrawCommandSequence
+  PDCTypeUnknown                  //< Resource could not be loaded
+} PDCType;
+
+//! Get a loaded PDC image or sequence, loading it if it is not cached
+//! @param resource_id The ID of the resource to load
+//! @param type Set to the type of the loaded resource
+//! @return Pointer to the GDrawCommandImage or GDrawCommandSequence, or NULL if not loaded
+void *pdc_cache_acquire(uint32_t resource_id, PDCType *type);
+
+//! Release a resource acquired from the cache
+//! @param file Pointer to the resource returned by pdc_cache_acquire
+void pdc_cache_release(void *file);
+
+//! Destroy all unused resources and stop caching
+void pdc_cache_terminate(void);
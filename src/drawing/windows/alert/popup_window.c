@@ -9,19 +9,13 @@
 // @bug No known bugs
 
 #include "popup_window.h"
+#include "../../pdc_cache.h"
 #include "../../../utility.h"
 
 // Constants
-#define SEQUENCE_NEXT_FRAME_DELAY 33
+#define SEQUENCE_DEFAULT_FRAME_DURATION 33  //< Used for frames which don't set their own duration
 #define BACKGROUND_DEFAULT_COLOR PBL_IF_COLOR_ELSE(GColorMagenta, GColorWhite)
 
-// File type options
-typedef enum {
-  FileTypePDCImage,
-  FileTypePDCSequence,
-  FileTypeUnknown
-} FileType;
-
 // Main data struct
 typedef struct {
   Layer         *canvas_layer;      //< Pointer to canvas Layer
@@ -29,8 +23,8 @@ typedef struct {
   TextLayer     *footer_layer;      //< Pointer to footer TextLayer
   AppTimer      *ani_timer;         //< Animation timer for PDC sequence
   AppTimer      *timeout_timer;     //< Timer for when to close the window if in timeout mode
-  void          *file;              //< Pointer to loaded file
-  FileType      file_type;          //< Type of file loaded
+  void          *file;              //< Pointer to loaded file, owned by the PDC cache
+  PDCType       file_type;          //< Type of file loaded
   uint16_t      frame_index;        //< Current frame index if animation file type
   bool          close_on_animation_end; //< Whether to automatically on the animation end time
   bool          destroy_on_close;   //< Whether to auto-destroy when returning
@@ -60,26 +54,39 @@ static void prv_window_timeout_handler(void *context) {
   window_stack_remove(context, true);
 }
 
+// Function declarations
+static void prv_next_frame_handler(void *context);
+
+// Schedule the next frame after the duration of the current frame
+static void prv_schedule_next_frame(Window *window) {
+  PopupWindowData *window_data = window_get_user_data(window);
+  GDrawCommandFrame *pdc_frame = gdraw_command_sequence_get_frame_by_index(window_data->file,
+    window_data->frame_index);
+  uint32_t duration = pdc_frame ? gdraw_command_frame_get_duration(pdc_frame) : 0;
+  if (!duration) {
+    duration = SEQUENCE_DEFAULT_FRAME_DURATION;
+  }
+  window_data->ani_timer = app_timer_register(duration, prv_next_frame_handler, window);
+}
+
 // Index to next frame
 static void prv_next_frame_handler(void *context) {
   Window *window = context;
   PopupWindowData *window_data = window_get_user_data(window);
   window_data->ani_timer = NULL;
-  // check if animation is complete/wrapping
-  int num_frames = gdraw_command_sequence_get_num_frames(window_data->file);
-  if (window_data->frame_index >= num_frames) {
+  // check if the last frame has been shown for its duration
+  uint32_t num_frames = gdraw_command_sequence_get_num_frames(window_data->file);
+  if (window_data->frame_index + 1 >= num_frames) {
     if (window_data->close_on_animation_end) {
       window_stack_remove(window, true);
-      return;
-    } else {
-      window_data->frame_index = 0;
     }
+    // otherwise hold the static last frame without redrawing
+    return;
   }
   // refresh
+  window_data->frame_index++;
   layer_mark_dirty(window_data->canvas_layer);
-  // schedule next timer
-  window_data->ani_timer = app_timer_register(SEQUENCE_NEXT_FRAME_DELAY, prv_next_frame_handler,
-    window);
+  prv_schedule_next_frame(window);
 }
 
 // Layer update callback
@@ -89,7 +96,7 @@ static void prv_layer_update_proc(Layer *layer, GContext *ctx) {
   PopupWindowData *window_data = (*layer_data);
   GRect layer_bounds = layer_get_bounds(layer);
   // check file type
-  if (window_data->file_type == FileTypePDCImage) {
+  if (window_data->file_type == PDCTypeImage) {
     // draw PDC image
     GSize image_size = gdraw_command_image_get_bounds_size(window_data->file);
     GPoint image_origin = GPoint(
@@ -97,7 +104,7 @@ static void prv_layer_update_proc(Layer *layer, GContext *ctx) {
       (layer_bounds.size.h - image_size.h) / 2
     );
     gdraw_command_image_draw(ctx, window_data->file, image_origin);
-  } else if (window_data->file_type == FileTypePDCSequence) {
+  } else if (window_data->file_type == PDCTypeSequence) {
     // draw PDC sequence
     GSize sequence_bounds = gdraw_command_sequence_get_bounds_size(window_data->file);
     // get next frame
@@ -110,8 +117,6 @@ static void prv_layer_update_proc(Layer *layer, GContext *ctx) {
         (layer_bounds.size.h - sequence_bounds.h) / 2
       ));
     }
-    // advance to the next frame
-    window_data->frame_index++;
   }
 }
 
@@ -119,8 +124,8 @@ static void prv_layer_update_proc(Layer *layer, GContext *ctx) {
 static void prv_window_appear_handler(Window *window) {
   // resume/start animation playback if animation file type
   PopupWindowData *window_data = window_get_user_data(window);
-  if (window_data->file_type == FileTypePDCSequence) {
-    app_timer_register(SEQUENCE_NEXT_FRAME_DELAY, prv_next_frame_handler, window);
+  if (window_data->file_type == PDCTypeSequence && !window_data->ani_timer) {
+    prv_schedule_next_frame(window);
   }
 }
 
@@ -128,8 +133,9 @@ static void prv_window_appear_handler(Window *window) {
 static void prv_window_disappear_handler(Window *window) {
   // pause animation
   PopupWindowData *window_data = window_get_user_data(window);
-  if (window_data->file_type == FileTypePDCSequence && window_data->ani_timer) {
+  if (window_data->file_type == PDCTypeSequence && window_data->ani_timer) {
     app_timer_cancel(window_data->ani_timer);
+    window_data->ani_timer = NULL;
   }
 }
 
@@ -152,31 +158,17 @@ void popup_window_set_timeout(Window *window, int32_t duration) {
 // Set the file (PDC image/sequence) to display in the center of the screen
 void popup_window_set_visual(Window *window, uint32_t resource_id, bool auto_align_elements) {
   PopupWindowData *window_data = window_get_user_data(window);
-  // try to read the file and determine its type
-  void *file = gdraw_command_image_create_with_resource(resource_id);
-  if (file) {
-    window_data->file = file;
-    window_data->file_type = FileTypePDCImage;
-    // resize elements
-    if (auto_align_elements) {
-      GSize image_size = gdraw_command_image_get_bounds_size(window_data->file);
-      prv_recalculate_layer_bounds(window, image_size);
-    }
-    return;
-  }
-  file = gdraw_command_sequence_create_with_resource(resource_id);
-  if (file) {
-    window_data->file = file;
-    window_data->file_type = FileTypePDCSequence;
-    // resize elements
-    if (auto_align_elements) {
-      GSize image_size = gdraw_command_sequence_get_bounds_size(window_data->file);
-      prv_recalculate_layer_bounds(window, image_size);
-    }
-    return;
+  // release any previous file and get the new one from the cache
+  pdc_cache_release(window_data->file);
+  window_data->file = pdc_cache_acquire(resource_id, &window_data->file_type);
+  window_data->frame_index = 0;
+  // resize elements
+  if (auto_align_elements && window_data->file_type == PDCTypeImage) {
+    prv_recalculate_layer_bounds(window, gdraw_command_image_get_bounds_size(window_data->file));
+  } else if (auto_align_elements && window_data->file_type == PDCTypeSequence) {
+    prv_recalculate_layer_bounds(window,
+      gdraw_command_sequence_get_bounds_size(window_data->file));
   }
-  window_data->file = NULL;
-  window_data->file_type = FileTypeUnknown;
 }
 
 // Set the title and footer text displayed on the window
@@ -206,7 +198,7 @@ Window *popup_window_create(bool destroy_on_close) {
   window_set_window_handlers(window, window_handlers);
   PopupWindowData *window_data = MALLOC(sizeof(PopupWindowData));
   (*window_data) = (PopupWindowData) {
-    .file_type = FileTypeUnknown,
+    .file_type = PDCTypeUnknown,
     .close_on_animation_end = true,
     .destroy_on_close = destroy_on_close
   };
@@ -243,12 +235,8 @@ void popup_window_destroy(Window *window) {
   // cancel timers
   app_timer_cancel(window_data->ani_timer);
   app_timer_cancel(window_data->timeout_timer);
-  // destroy the loaded file based on its type
-  if (window_data->file_type == FileTypePDCImage) {
-    gdraw_command_image_destroy(window_data->file);
-  } else if (window_data->file_type == FileTypePDCSequence) {
-    gdraw_command_sequence_destroy(window_data->file);
-  }
+  // release the loaded file
+  pdc_cache_release(window_data->file);
   // destroy other stuff
   layer_destroy(window_data->canvas_layer);
   text_layer_destroy(window_data->footer_layer);
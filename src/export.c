@@ -0,0 +1,197 @@
+// @file export.c
+// @brief Streams the battery history to the phone
+//
+// Sends the raw SaveStateBlocks from persistent storage and the charge cycle table to the
+// phone as a sequence of AppMessages, one block per message. Blocks are numbered by their index
+// in the circular range of keys, which only counts up, and the phone replies with the index to
+// resume from, so an interrupted export continues where it stopped. Every message goes through
+// the phone's outgoing queue, which resends it with backoff if it is not delivered.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "export.h"
+#include "drawing/windows/alert/popup_window.h"
+#include "phone.h"
+#include "utility.h"
+
+// Constants
+#define KEY_EXPORT_START 837503         //< First block index, sent with the cycle table
+#define KEY_EXPORT_END 837504           //< Last block index
+#define KEY_EXPORT_CYCLES 837505        //< Cycle table as pairs of int32 run time and max life
+#define KEY_EXPORT_BLOCK 837506         //< Index of the block in the message
+#define KEY_EXPORT_DATA 837507          //< Raw bytes of the block
+#define KEY_EXPORT_DONE 837508          //< Number of blocks sent, marks the end of the export
+#define KEY_EXPORT_RESUME 837509        //< Block index the phone wants next
+
+// Export stages
+typedef enum {
+  ExportStageStart,                     //< Sending the block range and waiting for a resume index
+  ExportStageBlocks,                    //< Sending blocks
+  ExportStageDone                       //< Sending the end marker
+} ExportStage;
+
+// Main data struct
+static struct {
+  Window      *popup_window;            //< Window shown while exporting
+  DataAPI     *data_api;                //< Pointer to the main data library
+  ExportStage stage;                    //< Current stage of the export
+  uint32_t    first_index;              //< Index of the oldest block in persistent storage
+  uint32_t    last_index;               //< Index of the newest block in persistent storage
+  uint32_t    next_index;               //< Index of the next block to send
+  uint32_t    resume_index;             //< Index the phone asked for while a message was in flight
+  bool        resume_pending;           //< Whether resume_index is waiting to be applied
+} export_data;
+
+// Function declarations
+static void prv_sent_callback(PhoneResult result, DictionaryIterator *reply, void *context);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Stop exporting and close the window
+static void prv_finish(void) {
+  phone_set_receive_callback(NULL, NULL);
+  if (window_stack_contains_window(export_data.popup_window)) {
+    window_stack_remove(export_data.popup_window, true);
+  }
+  export_data.popup_window = NULL;
+}
+
+// Write the block range and charge cycle table
+static void prv_write_start(DictionaryIterator *iter, void *context) {
+  int32_t cycles[CHARGE_CYCLE_MAX_COUNT * 2];
+  uint16_t cycle_count = data_api_get_charge_cycle_count(export_data.data_api) - 1;
+  for (uint16_t ii = 0; ii < cycle_count; ii++) {
+    cycles[ii * 2] = data_api_get_run_time(export_data.data_api, ii + 1);
+    cycles[ii * 2 + 1] = data_api_get_max_life(export_data.data_api, ii + 1);
+  }
+  dict_write_uint32(iter, KEY_EXPORT_START, export_data.first_index);
+  dict_write_uint32(iter, KEY_EXPORT_END, export_data.last_index);
+  dict_write_data(iter, KEY_EXPORT_CYCLES, (uint8_t*)cycles, cycle_count * sizeof(int32_t) * 2);
+}
+
+// Write the next block
+static void prv_write_block(DictionaryIterator *iter, void *context) {
+  uint8_t buff[PERSIST_DATA_MAX_LENGTH];
+  int size = persist_read_data(DATA_BLOCK_KEY(export_data.next_index), buff, sizeof(buff));
+  dict_write_uint32(iter, KEY_EXPORT_BLOCK, export_data.next_index);
+  dict_write_data(iter, KEY_EXPORT_DATA, buff, size > 0 ? size : 0);
+}
+
+// Write the end marker
+static void prv_write_done(DictionaryIterator *iter, void *context) {
+  dict_write_uint32(iter, KEY_EXPORT_DONE, export_data.last_index - export_data.first_index + 1);
+}
+
+// Queue the message for the current stage, each completes once delivered
+static void prv_send(void) {
+  bool queued;
+  if (export_data.stage == ExportStageBlocks) {
+    queued = phone_queue_dictionary(KEY_EXPORT_BLOCK, 0, prv_write_block, prv_sent_callback,
+      NULL);
+  } else {
+    queued = phone_queue_dictionary(KEY_EXPORT_DONE, 0, prv_write_done, prv_sent_callback, NULL);
+  }
+  if (!queued) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Export could not be queued");
+    prv_finish();
+  }
+}
+
+// Continue the export from the block the phone asked for
+static void prv_resume(uint32_t index) {
+  export_data.resume_pending = false;
+  export_data.next_index = index < export_data.first_index ? export_data.first_index : index;
+  export_data.stage = export_data.next_index > export_data.last_index ? ExportStageDone :
+    ExportStageBlocks;
+  prv_send();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Callbacks
+//
+
+// Start message callback, the phone replies with the index to resume from
+static void prv_start_callback(PhoneResult result, DictionaryIterator *reply, void *context) {
+  Tuple *tuple = reply ? dict_find(reply, KEY_EXPORT_RESUME) : NULL;
+  if (result != PhoneResultSuccess || !tuple) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Export start failed: %d", (int)result);
+    prv_finish();
+    return;
+  }
+  prv_resume(tuple->value->uint32);
+}
+
+// Block and end marker callback, sends the next message once the last one is delivered
+static void prv_sent_callback(PhoneResult result, DictionaryIterator *reply, void *context) {
+  if (result != PhoneResultSuccess) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Export failed at block %d", (int)export_data.next_index);
+    prv_finish();
+    return;
+  }
+  // the phone asked for a different block while this message was in flight
+  if (export_data.resume_pending) {
+    prv_resume(export_data.resume_index);
+    return;
+  }
+  if (export_data.stage == ExportStageDone) {
+    prv_finish();
+    return;
+  }
+  if (++export_data.next_index > export_data.last_index) {
+    export_data.stage = ExportStageDone;
+  }
+  prv_send();
+}
+
+// Phone message callback, the phone asks for a block again if one arrived out of order
+static void prv_receive_callback(DictionaryIterator *iter, void *context) {
+  Tuple *tuple = dict_find(iter, KEY_EXPORT_RESUME);
+  if (!tuple) {
+    return;
+  }
+  // a message is always in flight after the start, so the resume is applied once it is
+  // delivered, instead of moving on past the block after the one in flight
+  export_data.resume_index = tuple->value->uint32;
+  export_data.resume_pending = true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+// Start streaming the battery history to the phone
+void export_start(DataAPI *data_api) {
+  if (export_data.popup_window) {
+    return;
+  }
+  // get the range of blocks, oldest to newest, nothing to send if the worker has not yet moved
+  // the blocks into the circular range of keys
+  export_data.data_api = data_api;
+  DataBlockRing block_ring = { 0 };
+  if (persist_get_size(PERSIST_DATA_KEY) == sizeof(DataBlockRing)) {
+    persist_read_data(PERSIST_DATA_KEY, &block_ring, sizeof(DataBlockRing));
+  }
+  export_data.first_index = block_ring.oldest_index;
+  export_data.last_index = block_ring.newest_index;
+  export_data.next_index = export_data.first_index;
+  export_data.resume_pending = false;
+  export_data.stage = ExportStageStart;
+  // create popup window
+  export_data.popup_window = popup_window_create(true);
+  popup_window_set_text(export_data.popup_window, "Battery+", "Exporting Data");
+  popup_window_set_visual(export_data.popup_window, RESOURCE_ID_TIMELINE_SYNC_IMAGE, true);
+  window_stack_push(export_data.popup_window, true);
+  // send the block range and wait for the phone to reply with the index to resume from
+  phone_set_receive_callback(prv_receive_callback, NULL);
+  if (!phone_queue_dictionary(KEY_EXPORT_START, KEY_EXPORT_RESUME, prv_write_start,
+                              prv_start_callback, NULL)) {
+    prv_finish();
+  }
+}
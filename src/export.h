@@ -0,0 +1,23 @@
+//! @file export.h
+//! @brief Streams the battery history to the phone
+//!
+//! Sends the raw SaveStateBlocks from persistent storage and the charge cycle table to the
+//! phone as a sequence of AppMessages, one block per message. The phone replies with the
+//! block key to resume from, so an interrupted export continues where it stopped.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <pebble.h>
+#include "data/data_api.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+//! Start streaming the battery history to the phone
+//! @param data_api Pointer to the main data library from which to get the charge cycles
+void export_start(DataAPI *data_api);
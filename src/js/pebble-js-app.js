@@ -31,6 +31,38 @@ var chargeByPin = {
   ]
 };
 
+// alert pins, one for each alert set on the watch
+var ALERT_PIN_MAX_COUNT = 4;          // must match DATA_ALERT_MAX_COUNT on the watch
+var ALERT_PIN_ID_PREFIX = 'battery-plus-alert-';
+var ALERT_NAMES = [                   // must match the alert text table on the watch
+  ["Low Alert"],
+  ["Low Alert", "Med Alert"],
+  ["Low Alert", "Med Alert", "1st Alert"],
+  ["Low Alert", "Med Alert", "2nd Alert", "1st Alert"]
+];
+
+// create the pin for an alert firing at a time
+function createAlertPin(index, count, date) {
+  return {
+    "id": ALERT_PIN_ID_PREFIX + index,
+    "time": date.toISOString(),
+    "layout": {
+      "type": "genericPin",
+      "title": ALERT_NAMES[count - 1][index],
+      "subtitle": "Battery+",
+      "tinyIcon": "system://images/NOTIFICATION_REMINDER",
+      "body": "Your Pebble will need charging soon."
+    },
+    "actions": [
+      {
+        "title": "Launch App",
+        "type": "openWatchApp",
+        "launchCode": 0
+      }
+    ]
+  };
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Utilities
@@ -52,41 +84,73 @@ function formatAMPM(date) {
 // Timeline Library
 //
 
-// The Timeline public URL root
-var API_URL_ROOT = 'https://timeline-api.getpebble.com/';
+// The Timeline public URL root, can be pointed at a local mock server for testing
+var API_URL_ROOT = localStorage.getItem('timeline-url') || 'https://timeline-api.getpebble.com/';
+
+// Transport for timeline HTTP requests, replaced with setTimelineTransport when testing
+var timelineTransport = {
+  /**
+   * Send an HTTP request.
+   * @param method The HTTP method.
+   * @param url The URL to send the request to.
+   * @param headers Object of header names to values.
+   * @param body The request body.
+   * @param callback Called with an error (null on success) and the response text.
+   */
+  send: function (method, url, headers, body, callback) {
+    var xhr = new XMLHttpRequest();
+    xhr.onload = function () {
+      callback(this.status >= 200 && this.status < 300 ? null : this.status, this.responseText);
+    };
+    xhr.onerror = function () {
+      callback('network error', '');
+    };
+    xhr.open(method, url);
+    for (var header in headers) {
+      xhr.setRequestHeader(header, headers[header]);
+    }
+    xhr.send(body);
+  }
+};
+
+/**
+ * Replace the transport used for timeline requests.
+ * @param transport An object with a send(method, url, headers, body, callback) function.
+ */
+function setTimelineTransport(transport) {
+  timelineTransport = transport;
+}
+
 /**
  * Send a request to the Pebble public web timeline API.
  * @param pin The JSON pin to insert. Must contain 'id' field.
  * @param type The type of request, either PUT or DELETE.
- * @param callback The callback to receive the responseText after the request has completed.
+ * @param callback Called with an error (null on success) and the response text.
  */
 function timelineRequest(pin, type, callback) {
   // User or shared?
   var url = API_URL_ROOT + 'v1/user/pins/' + pin.id;
 
-  // Create XHR
-  var xhr = new XMLHttpRequest();
-  xhr.onload = function () {
-      console.log('timeline: response received: ' + this.responseText);
-      callback(this.responseText);
-  };
-  xhr.open(type, url);
-
   // Get token
   Pebble.getTimelineToken(function (token) {
-    // Add headers
-    xhr.setRequestHeader('Content-Type', 'application/json');
-    xhr.setRequestHeader('X-User-Token', '' + token);
-
-    // Send
-    xhr.send(JSON.stringify(pin));
+    var headers = {
+      'Content-Type': 'application/json',
+      'X-User-Token': '' + token
+    };
+    timelineTransport.send(type, url, headers, JSON.stringify(pin), function (error, text) {
+      console.log('timeline: response received: ' + (error || text));
+      callback(error, text);
+    });
     console.log('timeline: request sent.');
-  }, function (error) { console.log('timeline: error getting timeline token: ' + error); });
+  }, function (error) {
+    console.log('timeline: error getting timeline token: ' + error);
+    callback(error, '');
+  });
 }
 /**
  * Insert a pin into the timeline for this user.
  * @param pin The JSON pin to insert.
- * @param callback The callback to receive the responseText after the request has completed.
+ * @param callback Called with an error (null on success) and the response text.
  */
 function insertUserPin(pin, callback) {
   timelineRequest(pin, 'PUT', callback);
@@ -94,33 +158,455 @@ function insertUserPin(pin, callback) {
 /**
  * Delete a pin from the timeline for this user.
  * @param pin The JSON pin to delete.
- * @param callback The callback to receive the responseText after the request has completed.
+ * @param callback Called with an error (null on success) and the response text.
  */
 function deleteUserPin(pin, callback) {
   timelineRequest(pin, 'DELETE', callback);
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pin Sync
+//
+
+var PIN_SHIFT_TOLERANCE = 5 * 60;     // seconds a pin may move before it is pushed again
+var PIN_DEBOUNCE_DELAY = 1000;        // ms to wait for a burst of updates to settle
+var PIN_RETRY_DELAY = 5000;           // ms before the first retry, doubled for each failure
+var PIN_RETRY_MAX_DELAY = 5 * 60000;  // longest ms between retries
+
+// pin times last pushed and pins waiting to be pushed, by pin id
+var pushedPins = JSON.parse(localStorage.getItem('pushed-pins')) || {};
+var pendingPins = JSON.parse(localStorage.getItem('pending-pins')) || {};
+var pinTimer = null;
+var pinCallbacks = [];
+
+// save the pin sync state
+function savePinState() {
+  localStorage.setItem('pushed-pins', JSON.stringify(pushedPins));
+  localStorage.setItem('pending-pins', JSON.stringify(pendingPins));
+}
+
+// get the shift in seconds below which a pin is not pushed again
+function getPinTolerance() {
+  var tolerance = parseInt(localStorage.getItem('pin-tolerance'), 10);
+  return isNaN(tolerance) ? PIN_SHIFT_TOLERANCE : tolerance;
+}
+
+// schedule the pending pins to be pushed
+function schedulePinFlush(delay) {
+  clearTimeout(pinTimer);
+  pinTimer = setTimeout(flushPins, delay);
+}
+
+/**
+ * Queue a pin to be pushed, superseding any queued version of the same pin. The pin is
+ * skipped if it moved less than the tolerance since it was last pushed.
+ * @param pin The JSON pin to insert.
+ * @param epoch The time of the pin in seconds, compared against the last pushed time.
+ * @param callback Called once the pin is pushed, skipped, or its first push failed.
+ */
+function queuePin(pin, epoch, callback) {
+  var pushed = pushedPins[pin.id];
+  if (pushed !== undefined && Math.abs(pushed - epoch) < getPinTolerance()) {
+    delete pendingPins[pin.id];
+    savePinState();
+    callback();
+    return;
+  }
+  pendingPins[pin.id] = { pin: pin, epoch: epoch, attempts: 0 };
+  savePinState();
+  pinCallbacks.push(callback);
+  schedulePinFlush(PIN_DEBOUNCE_DELAY);
+}
+
+/**
+ * Queue a pin to be deleted if it was pushed or is waiting to be pushed.
+ * @param id The id of the pin to delete.
+ * @param callback Called once the pin is deleted, or its first delete failed.
+ */
+function queuePinRemoval(id, callback) {
+  if (pushedPins[id] === undefined) {
+    delete pendingPins[id];
+    savePinState();
+    callback();
+    return;
+  }
+  pendingPins[id] = { pin: { id: id }, remove: true, attempts: 0 };
+  savePinState();
+  pinCallbacks.push(callback);
+  schedulePinFlush(PIN_DEBOUNCE_DELAY);
+}
+
+// push all pending pins, retrying failures with backoff
+function flushPins() {
+  pinTimer = null;
+  var ids = Object.keys(pendingPins);
+  var remaining = ids.length;
+  var maxAttempts = 0;
+  // call the completion callbacks once every pin has been tried
+  var complete = function () {
+    savePinState();
+    var callbacks = pinCallbacks;
+    pinCallbacks = [];
+    callbacks.forEach(function (callback) { callback(); });
+    if (maxAttempts) {
+      schedulePinFlush(Math.min(PIN_RETRY_DELAY * Math.pow(2, maxAttempts - 1),
+        PIN_RETRY_MAX_DELAY));
+    }
+  };
+  if (!remaining) {
+    complete();
+    return;
+  }
+  ids.forEach(function (id) {
+    var entry = pendingPins[id];
+    var request = entry.remove ? deleteUserPin : insertUserPin;
+    request(entry.pin, function (error) {
+      if (error) {
+        entry.attempts++;
+        maxAttempts = Math.max(maxAttempts, entry.attempts);
+      } else {
+        if (entry.remove) {
+          delete pushedPins[id];
+        } else {
+          pushedPins[id] = entry.epoch;
+        }
+        // a newer version may have been queued while this one was in flight
+        if (pendingPins[id] === entry) {
+          delete pendingPins[id];
+        }
+      }
+      if (--remaining === 0) {
+        complete();
+      }
+    });
+  });
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Data Export
+//
+
+// format constants, must match the worker
+var DATA_EPOCH_OFFSET = 1420070400;   // Jan 1, 2015 at 0:00:00, added back to each epoch
+var BATTERY_PERCENTAGE_OFFSET = 10;   // added to the battery percent by the worker
+var SAVE_STATE_SIZE = 5;              // packed SaveState size in bytes
+var SAVE_STATE_BLOCK_HEADER_SIZE = 6; // SaveStateBlock header size in bytes
+var SAVE_STATE_BLOCK_COUNT = 50;      // number of SaveStates in a full SaveStateBlock
+var SAVE_STATE_BLOCK_SIZE = 256;      // SaveStateBlock size in bytes
+var DEFAULT_CHARGE_RATE = -6048;      // seconds per percent, used when none is archived
+var ARCHIVE_MAX_POINTS = 10000;       // oldest archived points are dropped past this
+var RESTORE_MAX_BLOCKS = 10;          // blocks restored, leaves room in persistent storage
+
+// export in progress, kept in localStorage so an interrupted export can resume
+var exportState = JSON.parse(localStorage.getItem('export-state'));
+
+// read a little endian 32 bit integer from a byte array
+function readInt32LE(bytes, offset) {
+  return bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) |
+    (bytes[offset + 3] << 24);
+}
+
+// decode a packed SaveState bitfield (epoch:30, percent:7, charging, plugged, contiguous)
+function decodeSaveState(bytes, offset) {
+  var low = readInt32LE(bytes, offset) >>> 0;
+  var high = bytes[offset + 4];
+  return {
+    epoch: (low & 0x3FFFFFFF) + DATA_EPOCH_OFFSET,
+    percent: ((low >>> 30) | ((high & 0x1F) << 2)) - BATTERY_PERCENTAGE_OFFSET,
+    charging: !!(high & 0x20),
+    plugged: !!(high & 0x40),
+    contiguous: !!(high & 0x80)
+  };
+}
+
+// decode a SaveStateBlock (version:8, initial_charge_rate:24, check:10, count:6, states)
+function decodeSaveStateBlock(bytes) {
+  var points = [];
+  var count = bytes[5] >> 2;
+  for (var ii = 0; ii < count; ii++) {
+    points.push(decodeSaveState(bytes, SAVE_STATE_BLOCK_HEADER_SIZE + ii * SAVE_STATE_SIZE));
+  }
+  return {
+    version: bytes[0],
+    initialChargeRate: readInt32LE(bytes, 0) >> 8,
+    points: points
+  };
+}
+
+// encode a data point as a packed SaveState bitfield
+function encodeSaveState(point, bytes, offset) {
+  var epoch = point.epoch - DATA_EPOCH_OFFSET;
+  var percent = point.percent + BATTERY_PERCENTAGE_OFFSET;
+  bytes[offset] = epoch & 0xFF;
+  bytes[offset + 1] = (epoch >> 8) & 0xFF;
+  bytes[offset + 2] = (epoch >> 16) & 0xFF;
+  bytes[offset + 3] = ((epoch >> 24) & 0x3F) | ((percent & 0x03) << 6);
+  bytes[offset + 4] = ((percent >> 2) & 0x1F) | (point.charging ? 0x20 : 0) |
+    (point.plugged ? 0x40 : 0) | (point.contiguous ? 0x80 : 0);
+}
+
+// encode data points as a SaveStateBlock padded to its full size, as version 0 without a check
+// value since the watch decides the index it is stored at
+function encodeSaveStateBlock(points, initialChargeRate) {
+  var bytes = [];
+  for (var ii = 0; ii < SAVE_STATE_BLOCK_SIZE; ii++) {
+    bytes.push(0);
+  }
+  bytes[1] = initialChargeRate & 0xFF;
+  bytes[2] = (initialChargeRate >> 8) & 0xFF;
+  bytes[3] = (initialChargeRate >> 16) & 0xFF;
+  bytes[5] = points.length << 2;
+  points.forEach(function (point, index) {
+    encodeSaveState(point, bytes, SAVE_STATE_BLOCK_HEADER_SIZE + index * SAVE_STATE_SIZE);
+  });
+  return bytes;
+}
+
+// decode the charge cycle table of int32 run time and max life pairs
+function decodeCycles(bytes) {
+  var cycles = [];
+  for (var offset = 0; offset + 8 <= bytes.length; offset += 8) {
+    cycles.push({ runTime: readInt32LE(bytes, offset), maxLife: readInt32LE(bytes, offset + 4) });
+  }
+  return cycles;
+}
+
+// load the archive of data points, stored compactly as [epoch, percent, flags, charge rate]
+function loadArchive() {
+  var archive = JSON.parse(localStorage.getItem('history-archive')) || [];
+  return archive.map(function (entry) {
+    return {
+      epoch: entry[0],
+      percent: entry[1],
+      charging: !!(entry[2] & 1),
+      plugged: !!(entry[2] & 2),
+      contiguous: !!(entry[2] & 4),
+      chargeRate: entry[3]
+    };
+  });
+}
+
+// merge data points into the archive, keeping one point per epoch, oldest first
+function mergeIntoArchive(points) {
+  var byEpoch = {};
+  loadArchive().concat(points).forEach(function (point) {
+    var existing = byEpoch[point.epoch];
+    if (existing && point.chargeRate === undefined) {
+      point.chargeRate = existing.chargeRate;
+    }
+    byEpoch[point.epoch] = point;
+  });
+  var archive = Object.keys(byEpoch).map(function (epoch) {
+    var point = byEpoch[epoch];
+    var entry = [point.epoch, point.percent, (point.charging ? 1 : 0) | (point.plugged ? 2 : 0) |
+      (point.contiguous ? 4 : 0)];
+    if (point.chargeRate !== undefined) {
+      entry.push(point.chargeRate);
+    }
+    return entry;
+  });
+  archive.sort(function (a, b) { return a[0] - b[0]; });
+  archive = archive.slice(-ARCHIVE_MAX_POINTS);
+  localStorage.setItem('history-archive', JSON.stringify(archive));
+  console.log('Archived ' + archive.length + ' data points');
+}
+
+// build SaveStateBlocks from the newest archived points, with only the oldest block partial
+function buildRestoreBlocks() {
+  var archive = loadArchive();
+  var start = Math.max(0, archive.length - RESTORE_MAX_BLOCKS * SAVE_STATE_BLOCK_COUNT);
+  var blocks = [];
+  var chargeRate = DEFAULT_CHARGE_RATE, blockChargeRate;
+  var blockStart = start;
+  var blockEnd = start + ((archive.length - start) % SAVE_STATE_BLOCK_COUNT ||
+    SAVE_STATE_BLOCK_COUNT);
+  for (var ii = 0; ii < archive.length; ii++) {
+    if (archive[ii].chargeRate !== undefined) {
+      chargeRate = archive[ii].chargeRate;
+    }
+    if (ii === blockStart) {
+      blockChargeRate = chargeRate;
+    }
+    if (ii === blockEnd - 1 && ii >= start) {
+      blocks.push(encodeSaveStateBlock(archive.slice(blockStart, blockEnd), blockChargeRate));
+      blockStart = blockEnd;
+      blockEnd += SAVE_STATE_BLOCK_COUNT;
+    }
+  }
+  return blocks;
+}
+
+// blocks being restored to the watch
+var restoreBlocks = [];
+
+// reply to a request for a restore block
+function handleRestoreRequest(payload) {
+  var index = payload.KEY_RESTORE_REQUEST;
+  if (index === 0) {
+    restoreBlocks = buildRestoreBlocks();
+  }
+  var message = { KEY_RESTORE_COUNT: restoreBlocks.length };
+  if (index < restoreBlocks.length) {
+    message.KEY_RESTORE_BLOCK = index;
+    message.KEY_RESTORE_DATA = restoreBlocks[index];
+  }
+  Pebble.sendAppMessage(message);
+}
+
+// save the export progress
+function saveExportState() {
+  localStorage.setItem('export-state', JSON.stringify(exportState));
+}
+
+// start or resume an export and return the block index to continue from, starting over if the
+// watch's indices went back, as they do when its blocks are moved to a new layout or restored
+function handleExportStart(payload) {
+  var resumeKey = payload.KEY_EXPORT_START;
+  if (exportState && exportState.nextKey > payload.KEY_EXPORT_START &&
+      exportState.startKey <= payload.KEY_EXPORT_START) {
+    // drop blocks deleted on the watch since and re-request the newest, which may have grown
+    for (var key in exportState.blocks) {
+      if (key < payload.KEY_EXPORT_START) {
+        delete exportState.blocks[key];
+      }
+    }
+    resumeKey = Math.min(exportState.nextKey, exportState.endKey);
+  } else {
+    exportState = { blocks: {} };
+  }
+  exportState.startKey = payload.KEY_EXPORT_START;
+  exportState.endKey = payload.KEY_EXPORT_END;
+  exportState.nextKey = resumeKey;
+  exportState.cycles = decodeCycles(payload.KEY_EXPORT_CYCLES || []);
+  saveExportState();
+  return resumeKey;
+}
+
+// store a block and return the key to resume from if it arrived out of order
+function handleExportBlock(payload) {
+  if (!exportState) {
+    return 0;
+  } else if (payload.KEY_EXPORT_BLOCK < exportState.nextKey) {
+    // duplicate of a block already stored
+    return null;
+  } else if (payload.KEY_EXPORT_BLOCK > exportState.nextKey) {
+    return exportState.nextKey;
+  }
+  exportState.blocks[payload.KEY_EXPORT_BLOCK] = payload.KEY_EXPORT_DATA;
+  exportState.nextKey++;
+  saveExportState();
+  return null;
+}
+
+// reassemble the blocks into CSV and JSON, oldest data point first
+function handleExportDone() {
+  if (!exportState) {
+    return;
+  }
+  var points = [];
+  for (var key = exportState.startKey; key <= exportState.endKey; key++) {
+    if (exportState.blocks[key]) {
+      var block = decodeSaveStateBlock(exportState.blocks[key]);
+      if (block.points.length) {
+        block.points[0].chargeRate = block.initialChargeRate;
+      }
+      points = points.concat(block.points);
+    }
+  }
+  mergeIntoArchive(points);
+  var csv = ['epoch,percent,charging,plugged,contiguous'];
+  points.forEach(function (point) {
+    delete point.chargeRate;
+    csv.push([point.epoch, point.percent, point.charging ? 1 : 0, point.plugged ? 1 : 0,
+      point.contiguous ? 1 : 0].join(','));
+  });
+  localStorage.setItem('export-csv', csv.join('\n'));
+  localStorage.setItem('export-json', JSON.stringify({ cycles: exportState.cycles,
+    points: points }));
+  console.log(csv.join('\n'));
+  console.log('Exported ' + points.length + ' data points');
+  exportState = null;
+  localStorage.removeItem('export-state');
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pin Times
+//
+
+/**
+ * Update every pin from the times sent by the watch, the charge by time followed by each
+ * alert's fire time, and delete alert pins for alerts which no longer exist. The watch is
+ * acknowledged once all the pins are handled.
+ * @param bytes The little endian int32 times from the watch.
+ */
+function handlePinTimes(bytes) {
+  var times = [];
+  for (var offset = 0; offset + 4 <= bytes.length; offset += 4) {
+    times.push(readInt32LE(bytes, offset));
+  }
+  if (!times.length) {
+    return;
+  }
+  var alertCount = Math.min(times.length - 1, ALERT_PIN_MAX_COUNT);
+  // let the watch close once every pin is handled
+  var remaining = 1 + ALERT_PIN_MAX_COUNT;
+  var done = function () {
+    if (--remaining === 0) {
+      Pebble.sendAppMessage({ KEY_PIN_TIMES: 0 });
+    }
+  };
+  // "Charge By" pin
+  var pinDate = new Date(times[0] * 1000);
+  chargeByPin.time = pinDate.toISOString();
+  chargeByPin.layout.subtitle = formatAMPM(pinDate);
+  queuePin(JSON.parse(JSON.stringify(chargeByPin)), times[0], done);
+  // alert pins
+  for (var ii = 0; ii < ALERT_PIN_MAX_COUNT; ii++) {
+    if (ii < alertCount) {
+      queuePin(createAlertPin(ii, alertCount, new Date(times[ii + 1] * 1000)), times[ii + 1],
+        done);
+    } else {
+      queuePinRemoval(ALERT_PIN_ID_PREFIX + ii, done);
+    }
+  }
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // App Message
 //
 
+// retry any pins left pending from the last run
+Pebble.addEventListener('ready', function(e) {
+  if (Object.keys(pendingPins).length) {
+    schedulePinFlush(0);
+  }
+});
+
 // message received
 Pebble.addEventListener('appmessage', function(e) {
   // check for key
-  if (e.payload.hasOwnProperty('KEY_CHARGE_BY')){
+  if (e.payload.hasOwnProperty('KEY_PIN_TIMES')){
     // check that it is valid to send pins i.e. its SDK 3.0 or greater
     if (typeof Pebble.getTimelineToken == 'function') {
-      // add time
-      pinDate = new Date(0);
-      pinDate.setUTCSeconds(e.payload.KEY_CHARGE_BY);
-      chargeByPin.time = pinDate;
-      chargeByPin.layout.subtitle = formatAMPM(new Date(e.payload.KEY_CHARGE_BY * 1000));
-      // insert pin
-      insertUserPin(chargeByPin, function (responseText) {
-        Pebble.sendAppMessage({ KEY_CHARGE_BY: 0 });
-        console.log('Pin Sent Result: ' + responseText);
-      });
+      handlePinTimes(e.payload.KEY_PIN_TIMES);
     }
   }
+  // data export
+  var resumeKey = null;
+  if (e.payload.hasOwnProperty('KEY_EXPORT_START')) {
+    resumeKey = handleExportStart(e.payload);
+  } else if (e.payload.hasOwnProperty('KEY_EXPORT_BLOCK')) {
+    resumeKey = handleExportBlock(e.payload);
+  } else if (e.payload.hasOwnProperty('KEY_EXPORT_DONE')) {
+    handleExportDone();
+  } else if (e.payload.hasOwnProperty('KEY_RESTORE_REQUEST')) {
+    handleRestoreRequest(e.payload);
+  }
+  if (resumeKey !== null) {
+    Pebble.sendAppMessage({ KEY_EXPORT_RESUME: resumeKey });
+  }
 });
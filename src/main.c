@@ -12,21 +12,25 @@
 #include "drawing/drawing.h"
 #include "menu.h"
 #include "drawing/windows/alert/popup_window.h"
+#include "drawing/pdc_cache.h"
 #include "phone.h"
 #include "utility.h"
 
 // Main constants
-#define REFRESH_PERIOD_MIN 5
+#define REFRESH_MAX_DELAY_MS (SEC_IN_HR * 1000) //< Longest wait before refreshing the current card
+#define REFRESH_MARGIN_MS 100           //< Delay after the change time to be sure it has passed
 #define CLICK_LONG_PRESS_DURATION 500
 
 // Main data structure
 static struct {
   Window        *window;          //< The base window for the application
   DataAPI       *data_api;        //< The main data pointer for all data functions
+  AppTimer      *refresh_timer;   //< Timer to refresh the current card when it next changes
 } main_data;
 
 // Function declarations
 static void prv_initialize_popup(void);
+static void prv_refresh_timer_schedule(void);
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,12 +45,14 @@ static void up_button_click_down_handler(ClickRecognizerRef recognizer, void *co
 // Up click event for "UP" button
 static void up_button_click_up_handler(ClickRecognizerRef recognizer, void *context) {
   drawing_select_next_card(true);
+  prv_refresh_timer_schedule();
 }
 
 // Select down click handler
 static void select_click_down_handler(ClickRecognizerRef recognizer, void *context) {
   drawing_select_click();
   drawing_set_action_menu_dot(true);
+  prv_refresh_timer_schedule();
 }
 
 // Select up click handler
@@ -56,10 +62,6 @@ static void select_click_up_handler(ClickRecognizerRef recognizer, void *context
 
 // Select long click handler
 static void select_long_click_handler(ClickRecognizerRef recognizer, void *context) {
-  // free memory from drawing caches
-#ifdef PBL_BW
-  drawing_free_caches();
-#endif
   // show the action menu
   menu_show(main_data.data_api);
   drawing_set_action_menu_dot(false);
@@ -73,6 +75,7 @@ static void down_button_click_down_handler(ClickRecognizerRef recognizer, void *
 // Up click event for "DOWN" button
 static void down_button_click_up_handler(ClickRecognizerRef recognizer, void *context) {
   drawing_select_next_card(false);
+  prv_refresh_timer_schedule();
 }
 
 // Click configuration callback
@@ -87,12 +90,36 @@ static void prv_click_config_handler(void *context) {
     down_button_click_up_handler, NULL);
 }
 
-// Tick Timer service for updating every minute
-static void prv_tick_timer_service_handler(tm *tick_time, TimeUnits units_changed) {
-  // check if at the current refresh period
-  if ((time(NULL) / SEC_IN_MIN) % REFRESH_PERIOD_MIN) {
-    drawing_refresh();
+// Refresh timer callback for when the current card's values change
+static void prv_refresh_timer_handler(void *context) {
+  main_data.refresh_timer = NULL;
+  drawing_refresh();
+  prv_refresh_timer_schedule();
+}
+
+// Schedule a refresh for when the current card's rendered values next change
+static void prv_refresh_timer_schedule(void) {
+  // cancel any existing refresh
+  if (main_data.refresh_timer) {
+    app_timer_cancel(main_data.refresh_timer);
+    main_data.refresh_timer = NULL;
   }
+  // nothing to do if the card only changes when new data arrives
+  time_t next_change = drawing_get_next_change();
+  if (!next_change) {
+    return;
+  }
+  // calculate the delay from now until the change
+  uint16_t cur_ms;
+  time_t cur_time;
+  time_ms(&cur_time, &cur_ms);
+  int64_t delay_ms = (int64_t)(next_change - cur_time) * 1000 - cur_ms + REFRESH_MARGIN_MS;
+  if (delay_ms < REFRESH_MARGIN_MS) {
+    delay_ms = REFRESH_MARGIN_MS;
+  } else if (delay_ms > REFRESH_MAX_DELAY_MS) {
+    delay_ms = REFRESH_MAX_DELAY_MS;
+  }
+  main_data.refresh_timer = app_timer_register(delay_ms, prv_refresh_timer_handler, NULL);
 }
 
 // Worker message callback
@@ -102,6 +129,7 @@ static void prv_worker_message_handler(uint16_t type, AppWorkerMessage *data) {
     case WorkerMessageReloadData:
       data_api_reload(main_data.data_api);
       drawing_refresh();
+      prv_refresh_timer_schedule();
       break;
     case WorkerMessageAlertEvent:
       prv_initialize_popup();
@@ -116,37 +144,49 @@ static void prv_worker_message_handler(uint16_t type, AppWorkerMessage *data) {
 // Loading and Unloading
 //
 
-// Initialize the pin pushing window
-static void prv_initialize_pin_pushing_window(void) {
-  // load data
-  if (!main_data.data_api) {
+// Initialize the timeline sync, sending the pin times and exiting once the phone replies
+static void prv_initialize_sync(void) {
+  // read the pin times the worker published, only loading the data if there are none yet
+  int32_t pin_times[DATA_PIN_MAX_COUNT];
+  uint8_t pin_count = 0;
+  if (persist_exists(PIN_TIMES_KEY)) {
+    pin_count = persist_read_data(PIN_TIMES_KEY, pin_times, sizeof(pin_times)) /
+      sizeof(int32_t);
+  }
+  if (!pin_count) {
     main_data.data_api = data_api_initialize();
+    pin_count = data_api_get_pin_times(main_data.data_api, pin_times);
   }
-  // create popup alert window
-  Window *popup_window = popup_window_create(true);
-  window_set_background_color(popup_window, PBL_IF_BW_ELSE(GColorWhite, GColorVividCerulean));
-  popup_window_set_text(popup_window, "Battery+", "Pushing Pins");
-  popup_window_set_visual(popup_window, RESOURCE_ID_TIMELINE_SYNC_IMAGE, true);
-  window_stack_push(popup_window, true);
-  // start the pin sending process
-  phone_connect();
-  phone_send_timestamp_to_phone(data_api_get_charge_by_time(main_data.data_api));
-  phone_set_window_close_on_complete(popup_window);
+  // the app exits when this window is removed
+#ifdef BUILD_SYNC_POPUP
+  Window *sync_window = popup_window_create(true);
+  window_set_background_color(sync_window, PBL_IF_BW_ELSE(GColorWhite, GColorVividCerulean));
+  popup_window_set_text(sync_window, "Battery+", "Pushing Pins");
+  popup_window_set_visual(sync_window, RESOURCE_ID_TIMELINE_SYNC_IMAGE, true);
+  window_stack_push(sync_window, true);
+#else
+  main_data.window = window_create();
+  ASSERT(main_data.window);
+  Window *sync_window = main_data.window;
+  window_stack_push(sync_window, false);
+#endif
+  // removing the window once the pins are pushed exits the app
+  phone_send_pin_times_to_phone(pin_times, pin_count, phone_remove_window_on_complete,
+    sync_window);
 }
 
 // Initialize the popup window
 static void prv_initialize_popup(void) {
-  // load data
-  if (!main_data.data_api) {
-    main_data.data_api = data_api_initialize();
-  }
-  // read alert index
-  uint8_t alert_index = persist_read_int(WAKE_UP_ALERT_INDEX_KEY);
-  persist_delete(WAKE_UP_ALERT_INDEX_KEY);
+  // read the alert the worker wrote out, without waiting on the worker for the full data
+  AlertFireRecord record = { .alert_count = 1 };
+  persist_read_data(ALERT_FIRE_KEY, &record, sizeof(record));
+  persist_delete(ALERT_FIRE_KEY);
+  // vibrate
+  vibes_short_pulse();
   // get text
   static char buff[16];
-  int day = data_api_get_alert_threshold(main_data.data_api, alert_index) / SEC_IN_DAY;
-  int hr = data_api_get_alert_threshold(main_data.data_api, alert_index) % SEC_IN_DAY / SEC_IN_HR;
+  int day = record.threshold / SEC_IN_DAY;
+  int hr = record.threshold % SEC_IN_DAY / SEC_IN_HR;
   if (day && hr) {
     snprintf(buff, sizeof(buff), "%dd %dh Left", day, hr);
   } else if (day) {
@@ -166,12 +206,10 @@ static void prv_initialize_popup(void) {
   Window *popup_window = popup_window_create(true);
   popup_window_set_close_on_animation_end(popup_window, true);
   window_set_background_color(popup_window, PBL_IF_BW_ELSE(GColorWhite,
-    data_api_get_alert_color(main_data.data_api, alert_index)));
+    data_api_get_alert_color_for_count(record.alert_count, record.alert_index)));
   popup_window_set_text(popup_window, "Battery+", buff);
   popup_window_set_visual(popup_window, RESOURCE_ID_LOW_BATTERY_IMAGE, true);
   window_stack_push(popup_window, true);
-  // vibrate
-  vibes_short_pulse();
 }
 
 // Initialize the program
@@ -194,23 +232,31 @@ static void prv_initialize_main(void) {
   drawing_initialize(window_root, main_data.data_api);
   // subscribe to services
   app_worker_message_subscribe(prv_worker_message_handler);
-  tick_timer_service_subscribe(MINUTE_UNIT, prv_tick_timer_service_handler);
+  // schedule refreshing of the current card
+  prv_refresh_timer_schedule();
 }
 
 // Terminate the program
 static void prv_terminate_main(void) {
   // unsubscribe from services
   app_worker_message_unsubscribe();
-  tick_timer_service_unsubscribe();
+  if (main_data.refresh_timer) {
+    app_timer_cancel(main_data.refresh_timer);
+  }
   // destroy
   drawing_terminate();
   window_destroy(main_data.window);
+  pdc_cache_terminate();
   // unload data
   data_api_terminate(main_data.data_api);
 }
 
-// Terminate the popup window
+// Terminate the popup or sync window
 static void prv_terminate_popup(void) {
+  if (main_data.window) {
+    window_destroy(main_data.window);
+  }
+  pdc_cache_terminate();
   // unload data
   data_api_terminate(main_data.data_api);
 }
@@ -222,10 +268,10 @@ int main(void) {
   // check launch reason
   if (launch_reason() == APP_LAUNCH_WORKER) {
     // either launch the popup or the sync screen
-    if (persist_exists(WAKE_UP_ALERT_INDEX_KEY)) {
+    if (persist_exists(ALERT_FIRE_KEY)) {
       prv_initialize_popup();
     } else {
-      prv_initialize_pin_pushing_window();
+      prv_initialize_sync();
     }
   } else {
     prv_initialize_main();
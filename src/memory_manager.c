@@ -0,0 +1,86 @@
+// @file memory_manager.c
+// @brief Frees cached memory when the heap runs low
+//
+// Caches which can be rebuilt on demand register an evict callback and a priority.
+// Before a large allocation, the caller reserves the memory it needs and caches are
+// evicted, lowest priority first, until the heap has that much room plus a per-platform
+// watermark.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "memory_manager.h"
+
+// Constants
+#ifdef PBL_PLATFORM_APLITE
+#define MEMORY_LOW_WATERMARK 1024       //< Bytes to always leave free for the system
+#else
+#define MEMORY_LOW_WATERMARK 4096       //< Bytes to always leave free for the system
+#endif
+
+// Registered cache
+typedef struct {
+  MemoryEvictHandler  handler;        //< Function to free the memory of the cache
+  void                *context;       //< Pointer passed to the handler
+  MemoryPriority      priority;       //< Priority of the cache, lower is evicted first
+} MemoryCache;
+
+// Main data struct
+static struct {
+  MemoryCache   caches[MEMORY_CACHE_MAX_COUNT]; //< Registered caches
+  uint8_t       cache_count;                    //< Number of registered caches
+} memory_data;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Check if the heap has room for an allocation above the low watermark
+static bool prv_has_room(uint32_t size) {
+  return heap_bytes_free() >= size + MEMORY_LOW_WATERMARK;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+// Register a cache which can be evicted when memory runs low
+void memory_register_cache(MemoryEvictHandler handler, void *context, MemoryPriority priority) {
+  if (memory_data.cache_count >= MEMORY_CACHE_MAX_COUNT) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Memory cache registry full");
+    return;
+  }
+  memory_data.caches[memory_data.cache_count++] = (MemoryCache) {
+    .handler = handler,
+    .context = context,
+    .priority = priority
+  };
+}
+
+// Remove a cache from the registry
+void memory_unregister_cache(MemoryEvictHandler handler, void *context) {
+  for (uint8_t ii = 0; ii < memory_data.cache_count; ii++) {
+    if (memory_data.caches[ii].handler == handler && memory_data.caches[ii].context == context) {
+      memory_data.caches[ii] = memory_data.caches[--memory_data.cache_count];
+      return;
+    }
+  }
+}
+
+// Evict caches until the heap has room for an allocation
+bool memory_reserve(uint32_t size, MemoryPriority max_priority) {
+  for (MemoryPriority priority = MemoryPriorityLow; priority <= max_priority; priority++) {
+    for (uint8_t ii = 0; ii < memory_data.cache_count; ii++) {
+      if (prv_has_room(size)) {
+        return true;
+      }
+      if (memory_data.caches[ii].priority == priority) {
+        memory_data.caches[ii].handler(memory_data.caches[ii].context);
+      }
+    }
+  }
+  return prv_has_room(size);
+}
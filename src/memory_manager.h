@@ -0,0 +1,45 @@
+//! @file memory_manager.h
+//! @brief Frees cached memory when the heap runs low
+//!
+//! Caches which can be rebuilt on demand register an evict callback and a priority.
+//! Before a large allocation, the caller reserves the memory it needs and caches are
+//! evicted, lowest priority first, until the heap has that much room plus a per-platform
+//! watermark.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <pebble.h>
+
+// Constants
+#define MEMORY_CACHE_MAX_COUNT 8  //< Maximum number of registered caches
+
+//! Eviction priorities, lower priority caches are evicted first
+typedef enum {
+  MemoryPriorityLow,              //< Cheap to rebuild and not currently visible
+  MemoryPriorityMedium,           //< Reloaded from resources when next needed
+  MemoryPriorityHigh              //< Visible content which must be re-rendered
+} MemoryPriority;
+
+//! Callback to free the memory held by a cache
+//! @param context The context the cache was registered with
+typedef void (*MemoryEvictHandler)(void *context);
+
+//! Register a cache which can be evicted when memory runs low
+//! @param handler The function which frees the memory of the cache
+//! @param context Pointer passed to the handler
+//! @param priority The priority of the cache, lower priorities are evicted first
+void memory_register_cache(MemoryEvictHandler handler, void *context, MemoryPriority priority);
+
+//! Remove a cache from the registry
+//! @param handler The handler the cache was registered with
+//! @param context The context the cache was registered with
+void memory_unregister_cache(MemoryEvictHandler handler, void *context);
+
+//! Evict caches until the heap has room for an allocation
+//! @param size The number of bytes about to be allocated
+//! @param max_priority The highest priority of cache which may be evicted
+//! @return True if the heap has room for the allocation above the low watermark
+bool memory_reserve(uint32_t size, MemoryPriority max_priority);
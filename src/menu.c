@@ -13,13 +13,20 @@
 #include "data/data_shared.h"
 #include "drawing/windows/edit/pin_window.h"
 #include "drawing/windows/alert/popup_window.h"
+#include "export.h"
+#include "memory_manager.h"
+#include "restore.h"
 #include "phone.h"
 #include "utility.h"
 
+// Constants
+#define MENU_HEAP_RESERVE 6000    //< Approximate heap used by the ActionMenu and its window
+
 // Action types
 typedef enum {
   ActionTypeResetRecord,
   ActionTypeDataExport,
+  ActionTypeDataRestore,
   ActionTypeAddAlert,
   ActionTypeEnableTimeline,
   ActionTypeDisableTimeline,
@@ -109,9 +116,19 @@ static void prv_alert_delete_handler(ActionMenu *action_menu, const ActionMenuIt
 }
 
 
+// Memory evict callback, frees the levels of the closing action menu
+static void prv_menu_evict_handler(void *context) {
+  if (s_action_menu) {
+    action_menu_hierarchy_destroy(s_root_level, NULL, NULL);
+    s_action_menu = NULL;
+  }
+}
+
 // Data level callback
 static void prv_action_performed_handler(ActionMenu *action_menu, const ActionMenuItem *item,
                                          void *context) {
+  // the menu is closing, so its levels may be freed early if the action needs the memory
+  memory_register_cache(prv_menu_evict_handler, NULL, MemoryPriorityLow);
   // get action type
   ActionType action_type = (ActionType)action_menu_item_get_action_data(item);
   // perform action
@@ -121,8 +138,10 @@ static void prv_action_performed_handler(ActionMenu *action_menu, const ActionMe
       data_api_reload(context);
       break;
     case ActionTypeDataExport:
-      // TODO: Add busy screen when printing
-      data_api_print_csv(context);
+      export_start(context);
+      break;
+    case ActionTypeDataRestore:
+      restore_start();
       break;
     case ActionTypeAddAlert:;
       // create pin window context
@@ -143,11 +162,10 @@ static void prv_action_performed_handler(ActionMenu *action_menu, const ActionMe
       break;
     case ActionTypeDisableTimeline:
       persist_write_bool(PERSIST_TIMELINE_KEY, false);
+      // the worker stops publishing pin times, so drop the last ones before they go stale
+      persist_delete(PIN_TIMES_KEY);
       break;
     case ActionTypeSyncTimeline:
-      // destroy action menu before syncing, else too little ram to connect to phone
-      action_menu_hierarchy_destroy(s_root_level, NULL, NULL);
-      s_action_menu = NULL;
       // create popup alert window
       Window *popup_window = popup_window_create(true);
       window_set_background_color(popup_window, PBL_IF_BW_ELSE(GColorWhite, GColorVividCerulean));
@@ -155,9 +173,10 @@ static void prv_action_performed_handler(ActionMenu *action_menu, const ActionMe
       popup_window_set_visual(popup_window, RESOURCE_ID_TIMELINE_SYNC_IMAGE, true);
       window_stack_push(popup_window, true);
       // start the pin sending process
-      phone_connect();
-      phone_send_timestamp_to_phone(data_api_get_charge_by_time(context));
-      phone_set_window_close_on_complete(popup_window);
+      int32_t pin_times[DATA_PIN_MAX_COUNT];
+      uint8_t pin_count = data_api_get_pin_times(context, pin_times);
+      phone_send_pin_times_to_phone(pin_times, pin_count, phone_remove_window_on_complete,
+        popup_window);
       break;
   }
 }
@@ -165,6 +184,7 @@ static void prv_action_performed_handler(ActionMenu *action_menu, const ActionMe
 // Menu did close callback
 static void prv_menu_did_close_handler(ActionMenu *action_menu,
                                        const ActionMenuItem *performed_action, void *context) {
+  memory_unregister_cache(prv_menu_evict_handler, NULL);
   if (s_action_menu) {
     action_menu_hierarchy_destroy(s_root_level, NULL, NULL);
   }
@@ -177,13 +197,17 @@ static void prv_menu_did_close_handler(ActionMenu *action_menu,
 
 // Show the action menu
 void menu_show(DataAPI *data_api) {
+  // free cached memory if there isn't room for the menu
+  memory_reserve(MENU_HEAP_RESERVE, MemoryPriorityHigh);
   // create root level
   s_root_level = action_menu_level_create(3);
   // create data level
-  s_data_level = action_menu_level_create(2);
+  s_data_level = action_menu_level_create(3);
   action_menu_level_add_child(s_root_level, s_data_level, "Data");
   action_menu_level_add_action(s_data_level, "Export", prv_action_performed_handler,
     (void*)ActionTypeDataExport);
+  action_menu_level_add_action(s_data_level, "Restore", prv_action_performed_handler,
+    (void*)ActionTypeDataRestore);
   action_menu_level_add_action(s_data_level, "Reset Record\nBattery Life",
     prv_action_performed_handler, (void*) ActionTypeResetRecord);
   // create alert level
@@ -2,72 +2,216 @@
 // @brief Controls communication between watch and phone
 //
 // Deals with sending and receiving information between watch and phone
-// including API requests to servers and Timeline Pins
+// including API requests to servers and Timeline Pins. Outgoing messages are queued and sent
+// one at a time. Small messages are copied into the queue, while large ones such as exported
+// SaveStateBlocks are written by a callback each time they are sent, so the queue stays small.
 //
 // @author Eric D. Phillips
 // @date February 25, 2016
 // @bugs No known bugs
 
 #include "phone.h"
+#include "memory_manager.h"
 
 // Constants
-#define KEY_CHARGE_BY 837502
-#define MESSAGE_RESEND_DELAY_MS 500
-#define MESSAGE_RESEND_MAX_ATTEMPTS 5
-#define WINDOW_FORCE_CLOSE_TIME 7000
+#define KEY_PIN_TIMES 837502
+#define PHONE_QUEUE_MAX_COUNT 4         //< Most messages waiting to be sent at once
+#define PHONE_RESEND_DELAY_MS 500       //< Delay before the first resend, doubled for each failure
+#define PHONE_RESEND_MAX_DELAY_MS 8000  //< Longest delay between resends
+#define PHONE_RESEND_MAX_ATTEMPTS 5     //< Resends before a message fails
+#define PHONE_REPLY_TIMEOUT_MS 10000    //< Time to wait for the phone to reply to a message
 
-// AppTimer for resending failed messages
-static AppTimer *app_timer = NULL, *close_timer = NULL;
-static uint8_t send_fail_count = 0;
-static Window *window_close_on_complete = NULL;
+// Queued message
+typedef struct {
+  uint32_t            key;              //< AppMessage key of the data tuple
+  uint32_t            reply_key;        //< Key of the reply which completes it, 0 for delivery
+  uint8_t             data[PHONE_MESSAGE_MAX_SIZE]; //< Data to send
+  uint16_t            size;             //< Size of the data in bytes
+  PhoneWriteCallback  write_callback;   //< Writes the tuples instead of the data, may be NULL
+  PhoneSendCallback   callback;         //< Called when the message completes
+  void                *context;         //< Context passed to the callbacks
+} PhoneMessage;
+
+// Main data struct
+static struct {
+  PhoneMessage  queue[PHONE_QUEUE_MAX_COUNT]; //< Messages to send, the first is being sent
+  uint8_t       count;                  //< Number of queued messages
+  uint8_t       attempts;               //< Failed attempts at sending the first message
+  bool          in_flight;              //< Whether the first message awaits a reply or delivery
+  bool          stale;                  //< Whether the first message changed while in flight
+  bool          connected;              //< Whether AppMessage is open
+  AppTimer      *timer;                 //< Timer for resending or timing out
+  PhoneReceiveCallback receive_callback; //< Called for messages which are not replies
+  void          *receive_context;       //< Context passed to the receive callback
+} phone_data;
+
+// Function declarations
+static void prv_send_head(void);
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// Callbacks
+// Private Functions
 //
 
-// Close all windows and exit the program
-static void prv_exit_app(void *data) {
-  // destroy timers
-  app_timer_cancel(app_timer);
-  app_timer_cancel(close_timer);
-  app_timer = NULL;
-  close_timer = NULL;
-  // close window
-  phone_disconnect();
-  window_stack_remove(window_close_on_complete, true);
-  window_close_on_complete = NULL;
-}
-
-// AppTimer callback
-static void prv_app_timer_callback(void *data) {
-  app_timer = NULL;
-  // attempt to resend message
-  if (send_fail_count < MESSAGE_RESEND_MAX_ATTEMPTS) {
-    send_fail_count++;
-    phone_send_timestamp_to_phone((int32_t)data);
+// Cancel the resend or reply timer
+static void prv_cancel_timer(void) {
+  if (phone_data.timer) {
+    app_timer_cancel(phone_data.timer);
+    phone_data.timer = NULL;
+  }
+}
+
+// Remove the first message from the queue, start sending the next, and call its callback
+static void prv_complete_head(PhoneResult result, DictionaryIterator *reply) {
+  PhoneMessage message = phone_data.queue[0];
+  phone_data.count--;
+  memmove(&phone_data.queue[0], &phone_data.queue[1], phone_data.count * sizeof(PhoneMessage));
+  phone_data.attempts = 0;
+  phone_data.in_flight = false;
+  phone_data.stale = false;
+  if (phone_data.count) {
+    prv_send_head();
+  }
+  if (message.callback) {
+    message.callback(result, reply, message.context);
+  }
+}
+
+// AppTimer callback to resend the first message
+static void prv_resend_timer_callback(void *data) {
+  phone_data.timer = NULL;
+  prv_send_head();
+}
+
+// Schedule a resend of the first message with exponential backoff and jitter
+static void prv_schedule_resend(void) {
+  phone_data.in_flight = false;
+  prv_cancel_timer();
+  if (phone_data.attempts++ >= PHONE_RESEND_MAX_ATTEMPTS) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Message %d failed", (int)phone_data.queue[0].key);
+    prv_complete_head(PhoneResultFailed, NULL);
+    return;
+  }
+  uint32_t delay = PHONE_RESEND_DELAY_MS << (phone_data.attempts - 1);
+  if (delay > PHONE_RESEND_MAX_DELAY_MS) {
+    delay = PHONE_RESEND_MAX_DELAY_MS;
+  }
+  // spread resends over the upper half of the delay so retries do not line up
+  delay = delay / 2 + rand() % (delay / 2 + 1);
+  phone_data.timer = app_timer_register(delay, prv_resend_timer_callback, NULL);
+}
+
+// AppTimer callback for when the phone does not reply
+static void prv_reply_timer_callback(void *data) {
+  phone_data.timer = NULL;
+  APP_LOG(APP_LOG_LEVEL_ERROR, "No reply to message %d", (int)phone_data.queue[0].key);
+  prv_schedule_resend();
+}
+
+// Send the first message in the queue
+static void prv_send_head(void) {
+  PhoneMessage *message = &phone_data.queue[0];
+  // begin iterator
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if (result == APP_MSG_OK) {
+    // write data
+    if (message->write_callback) {
+      message->write_callback(iter, message->context);
+    } else {
+      dict_write_data(iter, message->key, message->data, message->size);
+    }
+    dict_write_end(iter);
+    // send
+    result = app_message_outbox_send();
+  }
+  // resend message if failed
+  if (result != APP_MSG_OK) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Dictionary send failed: %d", (int)result);
+    prv_schedule_resend();
+    return;
+  }
+  phone_data.in_flight = true;
+  phone_data.stale = false;
+  prv_cancel_timer();
+  phone_data.timer = app_timer_register(PHONE_REPLY_TIMEOUT_MS, prv_reply_timer_callback, NULL);
+}
+
+// Finish the message in flight, sending it again if it was replaced while in flight
+static void prv_finish_head(DictionaryIterator *reply) {
+  prv_cancel_timer();
+  phone_data.in_flight = false;
+  if (phone_data.stale) {
+    prv_send_head();
+  } else {
+    prv_complete_head(PhoneResultSuccess, reply);
+  }
+}
+
+// Add a message to the queue, replacing any queued message with the same key
+static PhoneMessage *prv_queue_add(uint32_t key, PhoneSendCallback callback, void *context) {
+  // find a queued message with the same key to replace, else add to the end
+  uint8_t index = 0;
+  while (index < phone_data.count && phone_data.queue[index].key != key) {
+    index++;
+  }
+  PhoneMessage *message = &phone_data.queue[index];
+  if (index < phone_data.count) {
+    if (message->callback) {
+      message->callback(PhoneResultSuperseded, NULL, message->context);
+    }
+    phone_data.stale = phone_data.stale || (index == 0 && phone_data.in_flight);
+  } else if (phone_data.count < PHONE_QUEUE_MAX_COUNT) {
+    phone_data.count++;
   } else {
-    send_fail_count = 0;
-    prv_exit_app(NULL);
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Message queue full");
+    return NULL;
+  }
+  (*message) = (PhoneMessage) {
+    .key = key,
+    .reply_key = key,
+    .callback = callback,
+    .context = context
+  };
+  return message;
+}
+
+// Start sending if the queue was idle
+static void prv_queue_start(void) {
+  if (phone_data.count == 1 && !phone_data.in_flight && !phone_data.timer) {
+    phone_connect();
+    prv_send_head();
   }
 }
 
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Callbacks
+//
+
 // AppMessage inbox received callback
 static void prv_inbox_received_callback(DictionaryIterator *iterator, void *context) {
-  // for now there is only one thing this will do, so no need to check for a key
-  prv_exit_app(NULL);
+  // the phone replies with the reply key of the message it handled
+  uint32_t reply_key = phone_data.queue[0].reply_key;
+  if (phone_data.in_flight && reply_key && dict_find(iterator, reply_key)) {
+    prv_finish_head(iterator);
+  } else if (phone_data.receive_callback) {
+    phone_data.receive_callback(iterator, phone_data.receive_context);
+  }
 }
 
-// AppMessage sent callback
+// AppMessage outbox sent callback
 static void prv_outbox_sent_callback(DictionaryIterator *iterator, void *context) {
-  // reset send count
-  send_fail_count = 0;
+  // messages which do not wait for a reply complete once delivered
+  if (phone_data.in_flight && !phone_data.queue[0].reply_key) {
+    prv_finish_head(NULL);
+  }
 }
 
 // AppMessage inbox dropped callback
 static void prv_inbox_dropped_callback(AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Inbox message dropped!");
-  prv_exit_app(NULL);
+  // the reply timer resends the message if this was its reply
+  APP_LOG(APP_LOG_LEVEL_ERROR, "Inbox message dropped: %d", (int)reason);
 }
 
 // AppMessage outbox send failed callback
@@ -76,8 +220,8 @@ static void prv_outbox_failed_callback(DictionaryIterator *iterator, AppMessageR
   // log message failure
   APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox send failed: %d", (int)reason);
   // attempt to resend message
-  if (!app_timer) {
-    app_timer_register(MESSAGE_RESEND_DELAY_MS, prv_app_timer_callback, context);
+  if (phone_data.count) {
+    prv_schedule_resend();
   }
 }
 
@@ -86,44 +230,75 @@ static void prv_outbox_failed_callback(DictionaryIterator *iterator, AppMessageR
 // API Implementation
 //
 
-// Close window when sending is complete or timed out
-void phone_set_window_close_on_complete(Window *window) {
-  window_close_on_complete = window;
-  app_timer_register(WINDOW_FORCE_CLOSE_TIME, prv_exit_app, NULL);
+// Queue a message with a single data tuple, replacing any queued message with the same key
+bool phone_queue_message(uint32_t key, const void *data, uint16_t size,
+                         PhoneSendCallback callback, void *context) {
+  if (size > PHONE_MESSAGE_MAX_SIZE) {
+    return false;
+  }
+  PhoneMessage *message = prv_queue_add(key, callback, context);
+  if (!message) {
+    return false;
+  }
+  memcpy(message->data, data, size);
+  message->size = size;
+  prv_queue_start();
+  return true;
 }
 
-// Send timestamp to phone
-void phone_send_timestamp_to_phone(int32_t charge_by_epoch) {
-  // begin iterator
-  DictionaryIterator *iter;
-  app_message_outbox_begin(&iter);
-  // write data
-  dict_write_int32(iter, KEY_CHARGE_BY, charge_by_epoch);
-  dict_write_end(iter);
-  // send
-  AppMessageResult result = app_message_outbox_send();
-  // resend message if failed
-  app_message_set_context((void*)charge_by_epoch);
-  if (result != APP_MSG_OK && !app_timer) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Dictionary send failed: %d", (int)result);
-    app_timer_register(MESSAGE_RESEND_DELAY_MS, prv_app_timer_callback, (void*)charge_by_epoch);
+// Queue a message whose tuples are written when it is sent
+bool phone_queue_dictionary(uint32_t key, uint32_t reply_key, PhoneWriteCallback write_callback,
+                            PhoneSendCallback callback, void *context) {
+  PhoneMessage *message = prv_queue_add(key, callback, context);
+  if (!message) {
+    return false;
+  }
+  message->reply_key = reply_key;
+  message->write_callback = write_callback;
+  prv_queue_start();
+  return true;
+}
+
+// Set the callback for messages from the phone which are not a reply to a queued message
+void phone_set_receive_callback(PhoneReceiveCallback callback, void *context) {
+  phone_data.receive_callback = callback;
+  phone_data.receive_context = context;
+}
+
+// Send the pin times to the phone in one message
+void phone_send_pin_times_to_phone(int32_t *times, uint8_t count,
+                                   PhoneSendCallback callback, void *context) {
+  if (count > DATA_PIN_MAX_COUNT) {
+    count = DATA_PIN_MAX_COUNT;
+  }
+  if (!phone_queue_message(KEY_PIN_TIMES, times, count * sizeof(int32_t), callback, context) &&
+      callback) {
+    callback(PhoneResultFailed, NULL, context);
   }
 }
 
-//! Establish AppMessage communication with the phone
+// Send callback which removes the window passed as its context once the message completes
+void phone_remove_window_on_complete(PhoneResult result, DictionaryIterator *reply,
+                                     void *context) {
+  if (window_stack_contains_window(context)) {
+    window_stack_remove(context, true);
+  }
+}
+
+// Open AppMessage with buffers for the largest message
 void phone_connect(void) {
+  if (phone_data.connected) {
+    return;
+  }
+  phone_data.connected = true;
+  srand(time(NULL));
   // register callbacks
   app_message_register_inbox_received(prv_inbox_received_callback);
-  app_message_register_outbox_sent(prv_outbox_sent_callback);
   app_message_register_inbox_dropped(prv_inbox_dropped_callback);
+  app_message_register_outbox_sent(prv_outbox_sent_callback);
   app_message_register_outbox_failed(prv_outbox_failed_callback);
-  // open AppMessage
+  // free cached memory for the AppMessage buffers and open AppMessage
+  memory_reserve(PHONE_BUFFER_SIZE * 2, MemoryPriorityHigh);
   APP_LOG(APP_LOG_LEVEL_DEBUG, "Ram: %d", (int)heap_bytes_free());
-  app_message_open(APP_MESSAGE_INBOX_SIZE_MINIMUM, APP_MESSAGE_OUTBOX_SIZE_MINIMUM);
-}
-
-//! Terminate AppMessage communication with the phone
-void phone_disconnect(void) {
-  // deregister callbacks
-  app_message_deregister_callbacks();
+  app_message_open(PHONE_BUFFER_SIZE, PHONE_BUFFER_SIZE);
 }
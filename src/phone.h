@@ -2,7 +2,10 @@
 //! @brief Controls communication between watch and phone
 //!
 //! Deals with sending and receiving information between watch and phone
-//! including API requests to servers and Timeline Pins
+//! including API requests to servers and Timeline Pins. Outgoing messages are queued and sent
+//! one at a time, each completing when the phone replies or, if no reply is expected, when it
+//! is delivered. AppMessage is opened once, sized for the largest message, and every module
+//! talks to the phone through this queue.
 //!
 //! @author Eric D. Phillips
 //! @date February 25, 2016
@@ -10,22 +13,87 @@
 
 #pragma once
 #include <pebble.h>
+#include "data/data_shared.h"
+
+// Constants
+#define PHONE_MESSAGE_MAX_SIZE (DATA_PIN_MAX_COUNT * sizeof(int32_t)) //< Largest copied data
+#define PHONE_TUPLE_HEADER_SIZE 7       //< Key, type and length of a tuple in a dictionary
+#define PHONE_DICT_SIZE(tuple_count, data_size) \
+  (1 + (tuple_count) * PHONE_TUPLE_HEADER_SIZE + (data_size))
+//! Size of the largest message either way, a SaveStateBlock and up to two int32 tuples
+#define PHONE_BUFFER_SIZE PHONE_DICT_SIZE(3, 2 * sizeof(int32_t) + sizeof(SaveStateBlock))
+
+//! Result of a queued message
+typedef enum {
+  PhoneResultSuccess,                   //< The phone replied to the message
+  PhoneResultFailed,                    //< The message could not be delivered
+  PhoneResultSuperseded                 //< A newer message with the same key replaced it
+} PhoneResult;
+
+//! Callback for when a queued message completes
+//! @param result How the message completed
+//! @param reply The phone's reply if the message waited for one and succeeded, else NULL
+//! @param context The context passed when the message was queued
+typedef void (*PhoneSendCallback)(PhoneResult result, DictionaryIterator *reply, void *context);
+
+//! Callback to write the tuples of a queued message each time it is sent
+//! @param iter The outbox dictionary to write to
+//! @param context The context passed when the message was queued
+typedef void (*PhoneWriteCallback)(DictionaryIterator *iter, void *context);
+
+//! Callback for a message from the phone which is not a reply to a queued message
+//! @param iter The received dictionary
+//! @param context The context passed when the callback was set
+typedef void (*PhoneReceiveCallback)(DictionaryIterator *iter, void *context);
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // API Implementation
 //
 
-//! Close window when sending is complete or timed out
-//! @param window Pointer to window to close when complete
-void phone_set_window_close_on_complete(Window *window);
+//! Queue a message with a single data tuple, replacing any queued message with the same key
+//! The message completes when the phone replies with the same key
+//! @param key The AppMessage key to send the data under
+//! @param data The data to send
+//! @param size The size of the data in bytes, at most PHONE_MESSAGE_MAX_SIZE
+//! @param callback Called when the message completes, may be NULL
+//! @param context Context passed to the callback
+//! @return False if the queue was full and the message was not queued
+bool phone_queue_message(uint32_t key, const void *data, uint16_t size,
+                         PhoneSendCallback callback, void *context);
 
-//! Send a timestamp to the phone to be converted to a pin
-//! @param charge_by_epoch The time the pin should be created for
-void phone_send_timestamp_to_phone(int32_t charge_by_epoch);
+//! Queue a message whose tuples are written when it is sent, replacing any queued message with
+//! the same key. Used for messages too large to copy into the queue.
+//! @param key The key identifying the message in the queue
+//! @param reply_key The key of the reply which completes the message, 0 to complete it once
+//! delivered
+//! @param write_callback Writes the tuples of the message, called again for each resend
+//! @param callback Called when the message completes, may be NULL
+//! @param context Context passed to both callbacks
+//! @return False if the queue was full and the message was not queued
+bool phone_queue_dictionary(uint32_t key, uint32_t reply_key, PhoneWriteCallback write_callback,
+                            PhoneSendCallback callback, void *context);
 
-//! Establish AppMessage communication with the phone
-void phone_connect(void);
+//! Set the callback for messages from the phone which are not a reply to a queued message
+//! @param callback The callback, NULL to drop such messages
+//! @param context Context passed to the callback
+void phone_set_receive_callback(PhoneReceiveCallback callback, void *context);
+
+//! Send the pin times to the phone in one message, each is converted to a pin
+//! @param times The charge by time followed by each alert's fire time
+//! @param count The number of times, at most DATA_PIN_MAX_COUNT
+//! @param callback Called when the phone has handled the pins or sending failed
+//! @param context Context passed to the callback
+void phone_send_pin_times_to_phone(int32_t *times, uint8_t count,
+                                   PhoneSendCallback callback, void *context);
 
-//! Terminate AppMessage communication with the phone
-void phone_disconnect(void);
+//! Send callback which removes the window passed as its context once the message completes
+//! @param result How the message completed
+//! @param reply The phone's reply, unused
+//! @param context The window to remove from the window stack
+void phone_remove_window_on_complete(PhoneResult result, DictionaryIterator *reply,
+                                     void *context);
+
+//! Open AppMessage with buffers for the largest message, done automatically when queueing.
+//! AppMessage can only be opened once, so it stays open until the app exits.
+void phone_connect(void);
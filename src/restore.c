@@ -0,0 +1,193 @@
+// @file restore.c
+// @brief Restores the battery history from the phone's archive
+//
+// Requests the archived SaveStateBlocks from the phone one at a time while the worker is
+// stopped. The blocks are held in memory until every one has arrived, and only then written
+// into persistent storage, so a failed restore leaves the watch's history as it was and shows
+// an error. The worker reads them back when it is relaunched, so its estimates start from the
+// archived history instead of the defaults. Each request goes through the phone's outgoing
+// queue and completes when the phone replies with the block.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "restore.h"
+#include "data/data_shared.h"
+#include "drawing/windows/alert/popup_window.h"
+#include "memory_manager.h"
+#include "phone.h"
+#include "utility.h"
+
+// Constants
+#define KEY_RESTORE_REQUEST 837510      //< Index of the block the watch wants next
+#define KEY_RESTORE_COUNT 837511        //< Number of blocks the phone will send
+#define KEY_RESTORE_BLOCK 837512        //< Index of the block in the message
+#define KEY_RESTORE_DATA 837513         //< Raw bytes of the block
+#define RESTORE_FAILED_TIMEOUT 3000     //< Time the failure popup is shown for (ms)
+
+// Main data struct
+static struct {
+  Window      *popup_window;            //< Window shown while restoring
+  SaveStateBlock *blocks;               //< Blocks received, written once all have arrived
+  uint16_t    block_index;              //< Index of the next block to request
+  uint16_t    block_count;              //< Number of blocks the phone will send
+} restore_data;
+
+// Function declarations
+static void prv_send_request(void);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Delete the blocks of every index in a range, which wraps around the range of keys
+static void prv_delete_blocks(uint32_t first_index, uint32_t end_index) {
+  for (uint32_t index = first_index; index < end_index; index++) {
+    persist_delete(DATA_BLOCK_KEY(index));
+  }
+}
+
+// Write the received blocks over the watch's history and point the worker at them, returning
+// whether all of them were written. The newest is written first, so if storage runs out part
+// way the newest blocks still form a contiguous history.
+static bool prv_commit(void) {
+  uint16_t oldest_index = restore_data.block_count;
+  for (int32_t index = restore_data.block_count - 1; index >= 0; index--) {
+    int result = persist_write_data(DATA_BLOCK_KEY(index), &restore_data.blocks[index],
+      sizeof(SaveStateBlock));
+    // once a block is replaced the old history is gone, so make room by deleting the rest of it
+    if (result < (int)sizeof(SaveStateBlock) && oldest_index < restore_data.block_count) {
+      prv_delete_blocks(restore_data.block_count, index + DATA_BLOCK_KEY_COUNT + 1);
+      result = persist_write_data(DATA_BLOCK_KEY(index), &restore_data.blocks[index],
+        sizeof(SaveStateBlock));
+    }
+    if (result < (int)sizeof(SaveStateBlock)) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Restore ran out of storage: %d", result);
+      break;
+    }
+    oldest_index = index;
+  }
+  // nothing was replaced, so the old history is kept as it was
+  if (oldest_index == restore_data.block_count) {
+    return false;
+  }
+  // the phone sends the newest block full, so the worker starts a new block after it
+  prv_delete_blocks(restore_data.block_count, oldest_index + DATA_BLOCK_KEY_COUNT);
+  DataBlockRing block_ring = {
+    .oldest_index = oldest_index,
+    .newest_index = restore_data.block_count
+  };
+  persist_write_data(PERSIST_DATA_KEY, &block_ring, sizeof(DataBlockRing));
+  APP_LOG(APP_LOG_LEVEL_INFO, "Restored %d blocks", restore_data.block_count - oldest_index);
+  return oldest_index == 0;
+}
+
+// Write the blocks if all of them arrived, restart the worker, and close the window, showing an
+// error if the restore failed
+static void prv_finish(bool received) {
+  bool restored = received && restore_data.block_count && prv_commit();
+  free(restore_data.blocks);
+  restore_data.blocks = NULL;
+  app_worker_launch();
+  // close window
+  if (window_stack_contains_window(restore_data.popup_window)) {
+    window_stack_remove(restore_data.popup_window, true);
+  }
+  restore_data.popup_window = NULL;
+  // show the error
+  if (!restored) {
+    Window *popup_window = popup_window_create(true);
+    popup_window_set_text(popup_window, "Battery+", "Restore Failed");
+    popup_window_set_visual(popup_window, RESOURCE_ID_TIMELINE_SYNC_IMAGE, true);
+    popup_window_set_timeout(popup_window, RESTORE_FAILED_TIMEOUT);
+    window_stack_push(popup_window, true);
+  }
+}
+
+// Write the request for the next block
+static void prv_write_request(DictionaryIterator *iter, void *context) {
+  dict_write_uint16(iter, KEY_RESTORE_REQUEST, restore_data.block_index);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Callbacks
+//
+
+// Request callback, keeps the block the phone replied with and requests the next
+static void prv_request_callback(PhoneResult result, DictionaryIterator *reply, void *context) {
+  Tuple *count_tuple = reply ? dict_find(reply, KEY_RESTORE_COUNT) : NULL;
+  if (result != PhoneResultSuccess || !count_tuple) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Restore request failed: %d", (int)result);
+    prv_finish(false);
+    return;
+  }
+  Tuple *index_tuple = dict_find(reply, KEY_RESTORE_BLOCK);
+  Tuple *data_tuple = dict_find(reply, KEY_RESTORE_DATA);
+  // leave the last key of the range for the block the worker starts after them
+  if (!restore_data.blocks) {
+    restore_data.block_count = count_tuple->value->uint32 < DATA_BLOCK_KEY_COUNT ?
+      count_tuple->value->uint32 : DATA_BLOCK_KEY_COUNT - 1;
+    uint32_t size = restore_data.block_count * sizeof(SaveStateBlock);
+    if (!restore_data.block_count || !memory_reserve(size, MemoryPriorityHigh)) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Restore has no room for %d blocks", restore_data.block_count);
+      prv_finish(false);
+      return;
+    }
+    restore_data.blocks = MALLOC(size);
+  }
+  // keep the block
+  if (index_tuple && data_tuple && index_tuple->value->uint32 == restore_data.block_index) {
+    if (data_tuple->length != sizeof(SaveStateBlock)) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Restore block has %d bytes", data_tuple->length);
+      prv_finish(false);
+      return;
+    }
+    memcpy(&restore_data.blocks[restore_data.block_index++], data_tuple->value->data,
+      sizeof(SaveStateBlock));
+  }
+  // request the next block or finish
+  if (restore_data.block_index < restore_data.block_count) {
+    prv_send_request();
+  } else {
+    prv_finish(true);
+  }
+}
+
+// Request the next block from the phone
+static void prv_send_request(void) {
+  if (!phone_queue_dictionary(KEY_RESTORE_REQUEST, KEY_RESTORE_COUNT, prv_write_request,
+                              prv_request_callback, NULL)) {
+    prv_finish(false);
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+// Stop the worker and restore the battery history archived on the phone
+void restore_start(void) {
+  if (restore_data.popup_window) {
+    return;
+  }
+  restore_data.block_index = 0;
+  restore_data.block_count = 0;
+  // create popup window
+  restore_data.popup_window = popup_window_create(true);
+  popup_window_set_text(restore_data.popup_window, "Battery+", "Restoring Data");
+  popup_window_set_visual(restore_data.popup_window, RESOURCE_ID_TIMELINE_SYNC_IMAGE, true);
+  window_stack_push(restore_data.popup_window, true);
+  // stop the worker so it does not write while the blocks are replaced
+  AppWorkerResult result = app_worker_kill();
+  if (result != APP_WORKER_RESULT_SUCCESS && result != APP_WORKER_RESULT_NOT_RUNNING) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Restore could not stop the worker: %d", (int)result);
+    prv_finish(false);
+    return;
+  }
+  // request the first block
+  prv_send_request();
+}
@@ -0,0 +1,22 @@
+//! @file restore.h
+//! @brief Restores the battery history from the phone's archive
+//!
+//! Requests the archived SaveStateBlocks from the phone one at a time while the worker is
+//! stopped, and writes them into persistent storage once all of them have arrived. The worker
+//! reads them back when it is relaunched, so its estimates start from the archived history
+//! instead of the defaults. A failed restore leaves the history as it was and shows an error.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <pebble.h>
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+//! Stop the worker and restore the battery history archived on the phone
+void restore_start(void);
@@ -0,0 +1,106 @@
+//! @file columnar_format.h
+//! @brief Columnar file format for analyzing the battery history of many devices
+//!
+//! One file holds one device. It starts with a ColumnarHeader, followed by a ColumnarGroup for
+//! each column group and then a ColumnarColumn for each column, the columns of each group
+//! together. Column data follows the directory. Every column starts on an 8 byte boundary, so
+//! a reader can mmap the file and scan the packed words in place. All values are little endian.
+//!
+//! Each column directory entry records the smallest and largest decoded value. A reader can
+//! skip a whole file for a predicate such as "percent below 20" without touching its data.
+//!
+//! Columns are bit packed, with each value stored in bit_width bits, lowest bits first. A
+//! value may straddle two 64 bit words. A bit_width of 0 means no data is stored and every
+//! packed value is 0. Decoding depends on the encoding:
+//! - COLUMNAR_ENCODING_PACKED: value[i] = base + packed[i]
+//! - COLUMNAR_ENCODING_DELTA: value[0] = first, value[i] = value[i - 1] + base + packed[i]
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <stdint.h>
+
+//! Constants
+#define COLUMNAR_MAGIC 0x46435042       //< "BPCF" read as a little endian word
+#define COLUMNAR_VERSION 1              //< The current columnar format version
+#define COLUMNAR_ALIGNMENT 8            //< Byte alignment of each column's data
+
+//! Column encodings
+typedef enum {
+  COLUMNAR_ENCODING_PACKED = 0,         //< Offset from base, bit packed
+  COLUMNAR_ENCODING_DELTA = 1           //< Difference from the previous value, offset from base
+} ColumnarEncoding;
+
+//! Column groups
+typedef enum {
+  COLUMNAR_GROUP_POINTS = 0,            //< One row per data point, oldest first
+  COLUMNAR_GROUP_CYCLES = 1,            //< One row per discharge which ended in a charge
+  COLUMNAR_GROUP_STATS = 2              //< A single row of stats for the whole history
+} ColumnarGroupId;
+
+//! Columns of the points group
+typedef enum {
+  COLUMNAR_POINT_EPOCH = 0,             //< Seconds since the Unix epoch
+  COLUMNAR_POINT_PERCENT = 1,           //< Battery percent
+  COLUMNAR_POINT_CHARGING = 2,          //< Whether the battery was charging
+  COLUMNAR_POINT_PLUGGED = 3,           //< Whether the watch was plugged in
+  COLUMNAR_POINT_CONTIGUOUS = 4,        //< Whether the worker stayed active since the last point
+  COLUMNAR_POINT_RATE = 5               //< Seconds per percent since the last point, 0 if unknown
+} ColumnarPointColumn;
+
+//! Columns of the cycles group
+typedef enum {
+  COLUMNAR_CYCLE_DISCHARGE_EPOCH = 0,   //< When the discharge started
+  COLUMNAR_CYCLE_END_EPOCH = 1,         //< When charging started
+  COLUMNAR_CYCLE_RUN_TIME = 2,          //< Seconds between the two
+  COLUMNAR_CYCLE_RATE = 3               //< Average seconds per percent over the discharge
+} ColumnarCycleColumn;
+
+//! Columns of the stats group
+typedef enum {
+  COLUMNAR_STAT_POINT_COUNT = 0,        //< Number of data points
+  COLUMNAR_STAT_SKIPPED_COUNT = 1,      //< Invalid blocks or records skipped in the dump
+  COLUMNAR_STAT_FIRST_EPOCH = 2,        //< Time of the first data point
+  COLUMNAR_STAT_LAST_EPOCH = 3,         //< Time of the last data point
+  COLUMNAR_STAT_CYCLE_COUNT = 4,        //< Number of cycles
+  COLUMNAR_STAT_MEAN_RUN_TIME = 5,      //< Mean run time of the cycles in seconds
+  COLUMNAR_STAT_RECORD_RUN_TIME = 6,    //< Longest run time of the cycles in seconds
+  COLUMNAR_STAT_MEAN_RATE = 7           //< Mean seconds per percent over all discharging
+} ColumnarStatColumn;
+
+//! File header
+typedef struct {
+  uint32_t    magic;                    //< COLUMNAR_MAGIC
+  uint16_t    version;                  //< COLUMNAR_VERSION
+  uint16_t    group_count;              //< Number of column groups
+  uint32_t    column_count;             //< Number of columns in all groups
+  uint32_t    reserved;                 //< Zero, pads the header to 16 bytes
+} ColumnarHeader;
+
+//! Column group directory entry
+typedef struct {
+  uint32_t    id;                       //< A ColumnarGroupId
+  uint32_t    row_count;                //< Number of values in each of the group's columns
+  uint32_t    first_column;             //< Index of the group's first column in the directory
+  uint32_t    column_count;             //< Number of columns in the group
+} ColumnarGroup;
+
+//! Column directory entry
+typedef struct {
+  uint32_t    id;                       //< The column's id within its group
+  uint8_t     encoding;                 //< A ColumnarEncoding
+  uint8_t     bit_width;                //< Bits per packed value, 0 to 64
+  uint16_t    reserved;                 //< Zero
+  int64_t     first;                    //< First value of a delta column
+  int64_t     base;                     //< Added to each packed value
+  int64_t     min;                      //< Smallest value in the column
+  int64_t     max;                      //< Largest value in the column
+  uint64_t    offset;                   //< Byte offset of the packed words from the file start
+  uint64_t    size;                     //< Size of the packed words in bytes
+} ColumnarColumn;
+
+_Static_assert(sizeof(ColumnarHeader) == 16, "ColumnarHeader must stay 16 bytes");
+_Static_assert(sizeof(ColumnarGroup) == 16, "ColumnarGroup must stay 16 bytes");
+_Static_assert(sizeof(ColumnarColumn) == 56, "ColumnarColumn must stay 56 bytes");
@@ -0,0 +1,225 @@
+// @file columnar_writer.c
+// @brief Host library for writing battery history in the columnar format
+//
+// Each column keeps its raw values until the file is written. Values are then turned into
+// unsigned offsets from the column's base: the smallest value for packed columns, the
+// smallest difference for delta columns. The largest offset sets the bit width.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "columnar_writer.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Constants
+#define COLUMNAR_VALUE_CAPACITY 256     //< Values allocated when a column first grows
+#define COLUMNAR_WORD_BITS 64           //< Bits in each packed word
+
+// A column being built
+typedef struct {
+  uint32_t          group_id;           //< The group of the column
+  ColumnarColumn    entry;              //< Directory entry, filled in when written
+  int64_t           *values;            //< Raw values
+  size_t            value_count;        //< Number of values
+  size_t            value_capacity;     //< Allocated length of values
+  uint64_t          *words;             //< Packed words, filled in when written
+} ColumnarBuilder;
+
+// Writer, holding the columns being built
+struct ColumnarWriter {
+  ColumnarGroup     *groups;            //< Group directory entries
+  uint16_t          group_count;        //< Number of groups
+  ColumnarBuilder   *columns;           //< Columns of all groups, in group order
+  uint32_t          column_count;       //< Number of columns
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Get a column by group and id, or NULL if it was not added
+static ColumnarBuilder *prv_get_column(ColumnarWriter *writer, uint32_t group_id,
+                                       uint32_t column_id) {
+  for (uint32_t ii = 0; ii < writer->column_count; ii++) {
+    if (writer->columns[ii].group_id == group_id && writer->columns[ii].entry.id == column_id) {
+      return &writer->columns[ii];
+    }
+  }
+  return NULL;
+}
+
+// Get the number of bits needed to hold an unsigned value
+static uint8_t prv_get_bit_width(uint64_t value) {
+  return value ? COLUMNAR_WORD_BITS - __builtin_clzll(value) : 0;
+}
+
+// Get the value a column packs at an index before its base is removed
+static int64_t prv_get_unpacked(ColumnarBuilder *column, size_t index) {
+  if (column->entry.encoding == COLUMNAR_ENCODING_DELTA) {
+    return index ? column->values[index] - column->values[index - 1] : column->entry.base;
+  }
+  return column->values[index];
+}
+
+// Set the index, base and bit width of a column and pack its values
+static void prv_encode_column(ColumnarBuilder *column) {
+  ColumnarColumn *entry = &column->entry;
+  entry->first = entry->base = entry->min = entry->max = 0;
+  entry->bit_width = 0;
+  if (!column->value_count) {
+    return;
+  }
+  // find the min/max index and the range of the packed values
+  entry->min = entry->max = column->values[0];
+  for (size_t ii = 1; ii < column->value_count; ii++) {
+    int64_t value = column->values[ii];
+    entry->min = value < entry->min ? value : entry->min;
+    entry->max = value > entry->max ? value : entry->max;
+  }
+  int64_t unpacked_max;
+  if (entry->encoding == COLUMNAR_ENCODING_DELTA) {
+    entry->first = column->values[0];
+    if (column->value_count > 1) {
+      entry->base = unpacked_max = column->values[1] - column->values[0];
+      for (size_t ii = 2; ii < column->value_count; ii++) {
+        int64_t delta = column->values[ii] - column->values[ii - 1];
+        entry->base = delta < entry->base ? delta : entry->base;
+        unpacked_max = delta > unpacked_max ? delta : unpacked_max;
+      }
+    } else {
+      unpacked_max = 0;
+    }
+  } else {
+    entry->base = entry->min;
+    unpacked_max = entry->max;
+  }
+  entry->bit_width = prv_get_bit_width((uint64_t)unpacked_max - (uint64_t)entry->base);
+  // pack each offset from the base, lowest bits first, straddling words where needed
+  uint8_t width = entry->bit_width;
+  size_t word_count = (column->value_count * width + COLUMNAR_WORD_BITS - 1) /
+    COLUMNAR_WORD_BITS;
+  column->words = calloc(word_count ? word_count : 1, sizeof(uint64_t));
+  entry->size = word_count * sizeof(uint64_t);
+  for (size_t ii = 0; width && ii < column->value_count; ii++) {
+    uint64_t packed = (uint64_t)prv_get_unpacked(column, ii) - (uint64_t)entry->base;
+    size_t bit = ii * width;
+    uint8_t shift = bit % COLUMNAR_WORD_BITS;
+    column->words[bit / COLUMNAR_WORD_BITS] |= packed << shift;
+    if (shift + width > COLUMNAR_WORD_BITS) {
+      column->words[bit / COLUMNAR_WORD_BITS + 1] |= packed >> (COLUMNAR_WORD_BITS - shift);
+    }
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+// Create an empty writer
+ColumnarWriter *columnar_writer_create(void) {
+  return calloc(1, sizeof(ColumnarWriter));
+}
+
+// Destroy a writer and the values it holds
+void columnar_writer_destroy(ColumnarWriter *writer) {
+  for (uint32_t ii = 0; ii < writer->column_count; ii++) {
+    free(writer->columns[ii].values);
+    free(writer->columns[ii].words);
+  }
+  free(writer->columns);
+  free(writer->groups);
+  free(writer);
+}
+
+// Add a column group, to which the columns added after it belong
+void columnar_writer_add_group(ColumnarWriter *writer, uint32_t group_id) {
+  writer->groups = realloc(writer->groups, (writer->group_count + 1) * sizeof(ColumnarGroup));
+  writer->groups[writer->group_count++] = (ColumnarGroup) {
+    .id = group_id,
+    .first_column = writer->column_count
+  };
+}
+
+// Add a column to the last group added
+void columnar_writer_add_column(ColumnarWriter *writer, uint32_t column_id,
+                                ColumnarEncoding encoding) {
+  ColumnarGroup *group = &writer->groups[writer->group_count - 1];
+  writer->columns = realloc(writer->columns,
+    (writer->column_count + 1) * sizeof(ColumnarBuilder));
+  writer->columns[writer->column_count++] = (ColumnarBuilder) {
+    .group_id = group->id,
+    .entry = { .id = column_id, .encoding = encoding }
+  };
+  group->column_count++;
+}
+
+// Append a value to a column
+void columnar_writer_append(ColumnarWriter *writer, uint32_t group_id, uint32_t column_id,
+                            int64_t value) {
+  ColumnarBuilder *column = prv_get_column(writer, group_id, column_id);
+  if (!column) {
+    return;
+  }
+  if (column->value_count >= column->value_capacity) {
+    column->value_capacity = column->value_capacity ? column->value_capacity * 2 :
+      COLUMNAR_VALUE_CAPACITY;
+    column->values = realloc(column->values, column->value_capacity * sizeof(int64_t));
+  }
+  column->values[column->value_count++] = value;
+}
+
+// Encode every column and write the file
+bool columnar_writer_write(ColumnarWriter *writer, const char *path) {
+  // set each group's row count, every column of it must have the same number of values
+  for (uint16_t ii = 0; ii < writer->group_count; ii++) {
+    ColumnarGroup *group = &writer->groups[ii];
+    ColumnarBuilder *columns = &writer->columns[group->first_column];
+    group->row_count = group->column_count ? columns[0].value_count : 0;
+    for (uint32_t jj = 1; jj < group->column_count; jj++) {
+      if (columns[jj].value_count != group->row_count) {
+        errno = EINVAL;
+        return false;
+      }
+    }
+  }
+  // encode the columns and lay their data out after the directory
+  uint64_t offset = sizeof(ColumnarHeader) + writer->group_count * sizeof(ColumnarGroup) +
+    writer->column_count * sizeof(ColumnarColumn);
+  for (uint32_t ii = 0; ii < writer->column_count; ii++) {
+    free(writer->columns[ii].words);
+    prv_encode_column(&writer->columns[ii]);
+    writer->columns[ii].entry.offset = offset;
+    offset += writer->columns[ii].entry.size;
+  }
+  // write the header, directory and data, which are all multiples of the alignment
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  ColumnarHeader header = {
+    .magic = COLUMNAR_MAGIC,
+    .version = COLUMNAR_VERSION,
+    .group_count = writer->group_count,
+    .column_count = writer->column_count
+  };
+  bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(writer->groups, sizeof(ColumnarGroup), writer->group_count, file) ==
+      writer->group_count;
+  for (uint32_t ii = 0; success && ii < writer->column_count; ii++) {
+    success = fwrite(&writer->columns[ii].entry, sizeof(ColumnarColumn), 1, file) == 1;
+  }
+  for (uint32_t ii = 0; success && ii < writer->column_count; ii++) {
+    ColumnarBuilder *column = &writer->columns[ii];
+    success = fwrite(column->words, 1, column->entry.size, file) == column->entry.size;
+  }
+  if (fclose(file) != 0) {
+    success = false;
+  }
+  return success;
+}
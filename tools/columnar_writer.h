@@ -0,0 +1,60 @@
+//! @file columnar_writer.h
+//! @brief Host library for writing battery history in the columnar format
+//!
+//! Values are appended to columns in memory. When the file is written, each column is encoded
+//! with the smallest bit width that holds it, and its min/max index is filled in. See
+//! columnar_format.h for the layout. The writer assumes a little endian host.
+//!
+//! Build with the decode_dump command line tool:
+//!   cc -O2 -o decode_dump tools/decode_dump.c tools/dump_reader.c tools/columnar_writer.c
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "columnar_format.h"
+
+//! Opaque writer, holding the columns being built
+typedef struct ColumnarWriter ColumnarWriter;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+//! Create an empty writer
+//! @return The writer, destroy it with columnar_writer_destroy
+ColumnarWriter *columnar_writer_create(void);
+
+//! Destroy a writer and the values it holds
+//! @param writer The writer
+void columnar_writer_destroy(ColumnarWriter *writer);
+
+//! Add a column group, to which the columns added after it belong
+//! @param writer The writer
+//! @param group_id The ColumnarGroupId of the group
+void columnar_writer_add_group(ColumnarWriter *writer, uint32_t group_id);
+
+//! Add a column to the last group added
+//! @param writer The writer
+//! @param column_id The id of the column within its group
+//! @param encoding How to encode the column
+void columnar_writer_add_column(ColumnarWriter *writer, uint32_t column_id,
+                                ColumnarEncoding encoding);
+
+//! Append a value to a column, every column of a group must end with the same number of values
+//! @param writer The writer
+//! @param group_id The group of the column
+//! @param column_id The id of the column within the group
+//! @param value The value to append
+void columnar_writer_append(ColumnarWriter *writer, uint32_t group_id, uint32_t column_id,
+                            int64_t value);
+
+//! Encode every column and write the file
+//! @param writer The writer
+//! @param path Path of the file to write
+//! @return False if the file could not be written, errno is set
+bool columnar_writer_write(ColumnarWriter *writer, const char *path);
@@ -0,0 +1,78 @@
+// Decode Battery+ data logging records into CSV
+//
+// Usage: node decode_data_log.js <records.bin>
+//
+// The input is the raw byte array of a data logging session with the Battery+ tag (5155346),
+// as delivered to the phone. Each record is one version byte followed by a 5 byte SaveState.
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+
+var DATA_LOG_VERSION = 1;             // record format version written by the worker
+var DATA_LOG_RECORD_SIZE = 6;         // version byte followed by a packed SaveState
+var DATA_EPOCH_OFFSET = 1420070400;   // Jan 1, 2015 at 0:00:00, added back to each epoch
+var BATTERY_PERCENTAGE_OFFSET = 10;   // added to the battery percent by the worker
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Decoding
+//
+
+// decode a packed SaveState bitfield (epoch:30, percent:7, charging, plugged, contiguous)
+function decodeSaveState(bytes, offset) {
+  var low = bytes.readUInt32LE(offset);
+  var high = bytes[offset + 4];
+  return {
+    epoch: (low & 0x3FFFFFFF) + DATA_EPOCH_OFFSET,
+    percent: ((low >>> 30) | ((high & 0x1F) << 2)) - BATTERY_PERCENTAGE_OFFSET,
+    charging: !!(high & 0x20),
+    plugged: !!(high & 0x40),
+    contiguous: !!(high & 0x80)
+  };
+}
+
+// decode all records in a data logging byte array, skipping unknown versions
+function decodeDataLog(bytes) {
+  var points = [];
+  for (var offset = 0; offset + DATA_LOG_RECORD_SIZE <= bytes.length;
+       offset += DATA_LOG_RECORD_SIZE) {
+    if (bytes[offset] !== DATA_LOG_VERSION) {
+      console.error('Skipping record with unknown version ' + bytes[offset]);
+      continue;
+    }
+    points.push(decodeSaveState(bytes, offset + 1));
+  }
+  return points;
+}
+
+// format decoded data points as CSV
+function formatCSV(points) {
+  var lines = ['epoch,percent,charging,plugged,contiguous'];
+  points.forEach(function (point) {
+    lines.push([point.epoch, point.percent, point.charging ? 1 : 0, point.plugged ? 1 : 0,
+      point.contiguous ? 1 : 0].join(','));
+  });
+  return lines.join('\n');
+}
+
+module.exports = {
+  decodeSaveState: decodeSaveState,
+  decodeDataLog: decodeDataLog,
+  formatCSV: formatCSV
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Command Line
+//
+
+if (require.main === module) {
+  if (process.argv.length < 3) {
+    console.error('Usage: node decode_data_log.js <records.bin>');
+    process.exit(1);
+  }
+  var bytes = require('fs').readFileSync(process.argv[2]);
+  console.log(formatCSV(decodeDataLog(bytes)));
+}
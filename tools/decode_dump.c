@@ -0,0 +1,205 @@
+// @file decode_dump.c
+// @brief Decode a dump of the battery history into CSV or the columnar format
+//
+// Usage: decode_dump [--log] [--columnar <out.bpc>] <dump.bin>
+//
+// Without --log the input is a persistent storage dump, the raw SaveStateBlocks back to back.
+// With --log the input is the raw byte array of a data logging session with the Battery+ tag.
+// Prints the same CSV columns as decode_data_log.js, or with --columnar writes the points, the
+// charge cycles and the stats of the history to a columnar file (see columnar_format.h).
+//
+// A cycle runs from the first point after a charge to the next charge, and is dropped if the
+// worker was stopped during it, the same way the replay tool scores cycle detection.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "columnar_writer.h"
+#include "dump_reader.h"
+
+// Running totals while building a columnar file
+typedef struct {
+  const SaveState *lst_state;           //< The previous data point
+  time_t          discharge_epoch;      //< Start of the current discharge, 0 if none
+  int64_t         cycle_rate_sum;       //< Sum of the rates over the current discharge
+  int64_t         cycle_rate_count;     //< Number of rates over the current discharge
+  int64_t         rate_sum;             //< Sum of all rates
+  int64_t         rate_count;           //< Number of rates
+  int64_t         point_count;          //< Number of data points
+  int64_t         cycle_count;          //< Number of cycles
+  int64_t         run_time_sum;         //< Sum of the cycles' run times
+  int64_t         record_run_time;      //< Longest run time of the cycles
+  time_t          first_epoch;          //< Time of the first data point
+} DecodeTotals;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Columnar
+//
+
+// Add the column groups and their columns
+static void prv_add_columns(ColumnarWriter *writer) {
+  columnar_writer_add_group(writer, COLUMNAR_GROUP_POINTS);
+  columnar_writer_add_column(writer, COLUMNAR_POINT_EPOCH, COLUMNAR_ENCODING_DELTA);
+  columnar_writer_add_column(writer, COLUMNAR_POINT_PERCENT, COLUMNAR_ENCODING_PACKED);
+  columnar_writer_add_column(writer, COLUMNAR_POINT_CHARGING, COLUMNAR_ENCODING_PACKED);
+  columnar_writer_add_column(writer, COLUMNAR_POINT_PLUGGED, COLUMNAR_ENCODING_PACKED);
+  columnar_writer_add_column(writer, COLUMNAR_POINT_CONTIGUOUS, COLUMNAR_ENCODING_PACKED);
+  columnar_writer_add_column(writer, COLUMNAR_POINT_RATE, COLUMNAR_ENCODING_PACKED);
+  columnar_writer_add_group(writer, COLUMNAR_GROUP_CYCLES);
+  columnar_writer_add_column(writer, COLUMNAR_CYCLE_DISCHARGE_EPOCH, COLUMNAR_ENCODING_DELTA);
+  columnar_writer_add_column(writer, COLUMNAR_CYCLE_END_EPOCH, COLUMNAR_ENCODING_DELTA);
+  columnar_writer_add_column(writer, COLUMNAR_CYCLE_RUN_TIME, COLUMNAR_ENCODING_PACKED);
+  columnar_writer_add_column(writer, COLUMNAR_CYCLE_RATE, COLUMNAR_ENCODING_PACKED);
+  columnar_writer_add_group(writer, COLUMNAR_GROUP_STATS);
+  for (uint32_t ii = COLUMNAR_STAT_POINT_COUNT; ii <= COLUMNAR_STAT_MEAN_RATE; ii++) {
+    columnar_writer_add_column(writer, ii, COLUMNAR_ENCODING_PACKED);
+  }
+}
+
+// Get the seconds per percent since the previous point, 0 unless both were discharging
+static int64_t prv_get_rate(const SaveState *lst_state, const SaveState *save_state) {
+  if (!lst_state || !save_state->contiguous || lst_state->charging || lst_state->plugged ||
+      save_state->charging || save_state->plugged || save_state->epoch <= lst_state->epoch ||
+      save_state->percent >= lst_state->percent) {
+    return 0;
+  }
+  return (int64_t)(save_state->epoch - lst_state->epoch) /
+    (lst_state->percent - save_state->percent);
+}
+
+// Add a data point, and the cycle it ends if any
+static void prv_add_point(ColumnarWriter *writer, DecodeTotals *totals,
+                          const SaveState *save_state) {
+  time_t epoch = dump_get_epoch(save_state);
+  int64_t rate = prv_get_rate(totals->lst_state, save_state);
+  columnar_writer_append(writer, COLUMNAR_GROUP_POINTS, COLUMNAR_POINT_EPOCH, epoch);
+  columnar_writer_append(writer, COLUMNAR_GROUP_POINTS, COLUMNAR_POINT_PERCENT,
+    dump_get_percent(save_state));
+  columnar_writer_append(writer, COLUMNAR_GROUP_POINTS, COLUMNAR_POINT_CHARGING,
+    save_state->charging);
+  columnar_writer_append(writer, COLUMNAR_GROUP_POINTS, COLUMNAR_POINT_PLUGGED,
+    save_state->plugged);
+  columnar_writer_append(writer, COLUMNAR_GROUP_POINTS, COLUMNAR_POINT_CONTIGUOUS,
+    save_state->contiguous);
+  columnar_writer_append(writer, COLUMNAR_GROUP_POINTS, COLUMNAR_POINT_RATE, rate);
+  if (!totals->point_count++) {
+    totals->first_epoch = epoch;
+  }
+  if (rate) {
+    totals->rate_sum += rate;
+    totals->rate_count++;
+    totals->cycle_rate_sum += rate;
+    totals->cycle_rate_count++;
+  }
+  totals->lst_state = save_state;
+  // track whole discharges, from the end of a charge to the next charge without a gap
+  if (!save_state->contiguous) {
+    totals->discharge_epoch = 0;
+  }
+  if (save_state->charging && totals->discharge_epoch) {
+    int64_t run_time = epoch - totals->discharge_epoch;
+    columnar_writer_append(writer, COLUMNAR_GROUP_CYCLES, COLUMNAR_CYCLE_DISCHARGE_EPOCH,
+      totals->discharge_epoch);
+    columnar_writer_append(writer, COLUMNAR_GROUP_CYCLES, COLUMNAR_CYCLE_END_EPOCH, epoch);
+    columnar_writer_append(writer, COLUMNAR_GROUP_CYCLES, COLUMNAR_CYCLE_RUN_TIME, run_time);
+    columnar_writer_append(writer, COLUMNAR_GROUP_CYCLES, COLUMNAR_CYCLE_RATE,
+      totals->cycle_rate_count ? totals->cycle_rate_sum / totals->cycle_rate_count : 0);
+    totals->cycle_count++;
+    totals->run_time_sum += run_time;
+    totals->record_run_time = run_time > totals->record_run_time ? run_time :
+      totals->record_run_time;
+    totals->discharge_epoch = 0;
+  } else if (!save_state->charging && !totals->discharge_epoch && save_state->contiguous) {
+    totals->discharge_epoch = epoch;
+    totals->cycle_rate_sum = totals->cycle_rate_count = 0;
+  }
+}
+
+// Add the single row of stats
+static void prv_add_stats(ColumnarWriter *writer, DecodeTotals *totals, size_t skipped_count) {
+  int64_t stats[] = {
+    [COLUMNAR_STAT_POINT_COUNT] = totals->point_count,
+    [COLUMNAR_STAT_SKIPPED_COUNT] = skipped_count,
+    [COLUMNAR_STAT_FIRST_EPOCH] = totals->first_epoch,
+    [COLUMNAR_STAT_LAST_EPOCH] = totals->lst_state ? dump_get_epoch(totals->lst_state) : 0,
+    [COLUMNAR_STAT_CYCLE_COUNT] = totals->cycle_count,
+    [COLUMNAR_STAT_MEAN_RUN_TIME] = totals->cycle_count ?
+      totals->run_time_sum / totals->cycle_count : 0,
+    [COLUMNAR_STAT_RECORD_RUN_TIME] = totals->record_run_time,
+    [COLUMNAR_STAT_MEAN_RATE] = totals->rate_count ? totals->rate_sum / totals->rate_count : 0
+  };
+  for (uint32_t ii = COLUMNAR_STAT_POINT_COUNT; ii <= COLUMNAR_STAT_MEAN_RATE; ii++) {
+    columnar_writer_append(writer, COLUMNAR_GROUP_STATS, ii, stats[ii]);
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry Point
+//
+
+// Entry point
+int main(int argc, char **argv) {
+  bool log = false;
+  const char *columnar_path = NULL;
+  int ii = 1;
+  for (; ii < argc - 1; ii++) {
+    if (strcmp(argv[ii], "--log") == 0) {
+      log = true;
+    } else if (strcmp(argv[ii], "--columnar") == 0 && ii + 2 < argc) {
+      columnar_path = argv[++ii];
+    } else {
+      break;
+    }
+  }
+  if (ii != argc - 1) {
+    fprintf(stderr, "Usage: %s [--log] [--columnar <out.bpc>] <dump.bin>\n", argv[0]);
+    return 1;
+  }
+  const char *path = argv[argc - 1];
+  Dump dump;
+  if (!dump_open(&dump, path)) {
+    fprintf(stderr, "Could not map %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  // print or collect each data point
+  ColumnarWriter *writer = NULL;
+  DecodeTotals totals = { 0 };
+  if (columnar_path) {
+    writer = columnar_writer_create();
+    prv_add_columns(writer);
+  } else {
+    printf("epoch,percent,charging,plugged,contiguous\n");
+  }
+  DumpIterator iter;
+  dump_iterator_init(&iter, &dump);
+  const SaveState *save_state;
+  while ((save_state = log ? dump_iterator_next_log_state(&iter) :
+                             dump_iterator_next_block_state(&iter))) {
+    if (writer) {
+      prv_add_point(writer, &totals, save_state);
+    } else {
+      printf("%ld,%d,%d,%d,%d\n", (long)dump_get_epoch(save_state), dump_get_percent(save_state),
+        save_state->charging, save_state->plugged, save_state->contiguous);
+    }
+  }
+  if (iter.skipped_count) {
+    fprintf(stderr, "Skipped %zu invalid %s\n", iter.skipped_count, log ? "records" : "blocks");
+  }
+  int result = 0;
+  if (writer) {
+    prv_add_stats(writer, &totals, iter.skipped_count);
+    if (!columnar_writer_write(writer, columnar_path)) {
+      fprintf(stderr, "Could not write %s: %s\n", columnar_path, strerror(errno));
+      result = 1;
+    }
+    columnar_writer_destroy(writer);
+  }
+  dump_close(&dump);
+  return result;
+}
@@ -0,0 +1,126 @@
+// @file dump_reader.c
+// @brief Host library for reading dumps of the battery history
+//
+// Maps the dump with mmap and returns pointers into the mapping. The formats are packed, so
+// SaveStates are read through their packed struct definitions and need no alignment.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "dump_reader.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+// Memory map a dump file read only
+bool dump_open(Dump *dump, const char *path) {
+  dump->data = NULL;
+  dump->size = 0;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  // an empty file cannot be mapped but is a valid empty dump
+  if (st.st_size > 0) {
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    dump->data = data;
+    dump->size = st.st_size;
+  }
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  return true;
+}
+
+// Unmap a dump file
+void dump_close(Dump *dump) {
+  if (dump->data) {
+    munmap((void*)dump->data, dump->size);
+  }
+  dump->data = NULL;
+  dump->size = 0;
+}
+
+// Get the number of whole SaveStateBlocks in a persistent storage dump
+size_t dump_get_block_count(const Dump *dump) {
+  return dump->size / sizeof(SaveStateBlock);
+}
+
+// Get a SaveStateBlock of a persistent storage dump in place
+const SaveStateBlock *dump_get_block(const Dump *dump, size_t index) {
+  if (index >= dump_get_block_count(dump)) {
+    return NULL;
+  }
+  return (const SaveStateBlock*)(dump->data + index * sizeof(SaveStateBlock));
+}
+
+// Check that the header of a SaveStateBlock is one this library understands, the check value
+// needs the block's index in persistent storage so it is not verified here
+bool dump_is_block_valid(const SaveStateBlock *block) {
+  return (block->data_version == DATA_VERSION ||
+          block->data_version == DATA_VERSION_UNCHECKED) &&
+    block->save_state_count <= DATA_BLOCK_SAVE_STATE_COUNT;
+}
+
+// Start iterating the data points of a dump
+void dump_iterator_init(DumpIterator *iter, const Dump *dump) {
+  iter->dump = dump;
+  iter->offset = 0;
+  iter->index = 0;
+  iter->skipped_count = 0;
+}
+
+// Get the next SaveState of a persistent storage dump, skipping invalid blocks
+const SaveState *dump_iterator_next_block_state(DumpIterator *iter) {
+  for (; iter->offset + sizeof(SaveStateBlock) <= iter->dump->size;
+       iter->offset += sizeof(SaveStateBlock), iter->index = 0) {
+    const SaveStateBlock *block = (const SaveStateBlock*)(iter->dump->data + iter->offset);
+    if (!dump_is_block_valid(block)) {
+      iter->skipped_count++;
+      continue;
+    }
+    if (iter->index < block->save_state_count) {
+      return &block->save_states[iter->index++];
+    }
+  }
+  return NULL;
+}
+
+// Get the next SaveState of a data logging dump, skipping records of other versions
+const SaveState *dump_iterator_next_log_state(DumpIterator *iter) {
+  while (iter->offset + sizeof(DataLogRecord) <= iter->dump->size) {
+    const DataLogRecord *record = (const DataLogRecord*)(iter->dump->data + iter->offset);
+    iter->offset += sizeof(DataLogRecord);
+    if (record->version == DATA_LOG_VERSION) {
+      return &record->save_state;
+    }
+    iter->skipped_count++;
+  }
+  return NULL;
+}
+
+// Get the time of a SaveState in seconds since the Unix epoch
+time_t dump_get_epoch(const SaveState *save_state) {
+  return (time_t)save_state->epoch + DATA_EPOCH_OFFSET;
+}
+
+// Get the battery percent of a SaveState
+int dump_get_percent(const SaveState *save_state) {
+  return (int)save_state->percent - BATTERY_PERCENTAGE_OFFSET;
+}
@@ -0,0 +1,89 @@
+//! @file dump_reader.h
+//! @brief Host library for reading dumps of the battery history
+//!
+//! Memory maps a dump file and iterates the data points in place without copying them. Two
+//! kinds of dump are supported: persistent storage dumps, which are the raw SaveStateBlocks
+//! back to back in key order, and data logging dumps, which are the DataLogRecords of a data
+//! logging session back to back. Both use the formats in data_format.h, shared with the worker.
+//!
+//! Build with the decode_dump command line tool:
+//!   cc -O2 -o decode_dump tools/decode_dump.c tools/dump_reader.c tools/columnar_writer.c
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <stddef.h>
+#include <time.h>
+#include "../src/data/data_format.h"
+
+//! A memory mapped dump file
+typedef struct {
+  const uint8_t *data;                  //< Start of the mapped file
+  size_t        size;                   //< Size of the mapped file in bytes
+} Dump;
+
+//! Iterator over the data points of a dump
+typedef struct {
+  const Dump    *dump;                  //< The dump being iterated
+  size_t        offset;                 //< Byte offset of the current block or record
+  uint8_t       index;                  //< Index of the next SaveState in the current block
+  size_t        skipped_count;          //< Number of invalid blocks or records skipped
+} DumpIterator;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+//! Memory map a dump file read only
+//! @param dump The dump to initialize
+//! @param path Path of the file to map
+//! @return False if the file could not be opened or mapped, errno is set
+bool dump_open(Dump *dump, const char *path);
+
+//! Unmap a dump file
+//! @param dump The dump to close
+void dump_close(Dump *dump);
+
+//! Get the number of whole SaveStateBlocks in a persistent storage dump
+//! @param dump The dump
+//! @return The number of blocks, a partial block at the end is not counted
+size_t dump_get_block_count(const Dump *dump);
+
+//! Get a SaveStateBlock of a persistent storage dump in place
+//! @param dump The dump
+//! @param index The index of the block
+//! @return A pointer into the mapped file, or NULL if out of range
+const SaveStateBlock *dump_get_block(const Dump *dump, size_t index);
+
+//! Check that the header of a SaveStateBlock is one this library understands
+//! @param block The block
+//! @return True if the version is known and the count fits in the block
+bool dump_is_block_valid(const SaveStateBlock *block);
+
+//! Start iterating the data points of a dump
+//! @param iter The iterator to initialize
+//! @param dump The dump to iterate
+void dump_iterator_init(DumpIterator *iter, const Dump *dump);
+
+//! Get the next SaveState of a persistent storage dump, skipping invalid blocks
+//! @param iter The iterator
+//! @return A pointer into the mapped file, or NULL when done
+const SaveState *dump_iterator_next_block_state(DumpIterator *iter);
+
+//! Get the next SaveState of a data logging dump, skipping records of other versions
+//! @param iter The iterator
+//! @return A pointer into the mapped file, or NULL when done
+const SaveState *dump_iterator_next_log_state(DumpIterator *iter);
+
+//! Get the time of a SaveState in seconds since the Unix epoch
+//! @param save_state The SaveState
+//! @return The epoch with DATA_EPOCH_OFFSET applied
+time_t dump_get_epoch(const SaveState *save_state);
+
+//! Get the battery percent of a SaveState
+//! @param save_state The SaveState
+//! @return The percent with BATTERY_PERCENTAGE_OFFSET removed
+int dump_get_percent(const SaveState *save_state);
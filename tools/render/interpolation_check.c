@@ -0,0 +1,203 @@
+// @file interpolation_check.c
+// @brief Check each fixed point easing table against its float curve and time both
+//
+// Usage: interpolation_check [--repeat count]
+//
+// interpolation_progress is evaluated at every fixed point progress from 0 to
+// INTERPOLATION_PROGRESS_MAX and compared to the curve it samples, computed in double
+// precision. Two errors are reported for each curve, in units of 1 / INTERPOLATION_PROGRESS_MAX:
+// at the table samples, which should only differ by rounding, and anywhere between them, where
+// the linear blend adds its own error. A curve fails if either error is over its limit or if
+// it ever steps backwards.
+//
+// Each curve is then evaluated --repeat times over the whole range both ways, and the average
+// time of one call is reported for the table and the float curve. One CSV row per curve is
+// printed on stdout. Exits with 1 if any curve fails.
+//
+// Build from the repository root:
+//   cc -O2 -I tools/render -o interpolation_check tools/render/interpolation_check.c
+//     src/animation/interpolation.c -lm
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include <math.h>
+#include "pebble.h"
+#include "../../src/animation/interpolation.h"
+
+// Constants
+#define CHECK_REPEAT_COUNT 100          //< Default number of passes to time over the range
+#define CHECK_TABLE_SEGMENTS 32         //< Number of segments in each curve table
+#define CHECK_SAMPLE_MAX_ERROR 1        //< Largest error at a table sample, from rounding
+#define CHECK_BLEND_MAX_ERROR 32        //< Largest error between samples, under 1/7 pixel
+                                        //  when easing across a 144 pixel display
+
+// Curve under test
+typedef struct {
+  char                *name;            //< Name of the curve in the output
+  InterpolationCurve  curve;            //< Curve passed to interpolation_progress
+  double              (*float_handler)(double); //< Curve in double precision
+} CheckCurve;
+
+// Result of checking one curve
+typedef struct {
+  double      sample_error;             //< Largest error at a table sample
+  double      blend_error;              //< Largest error anywhere in the range
+  bool        monotonic;                //< Whether the progress never steps backwards
+  double      table_ns;                 //< Average time of one table call
+  double      float_ns;                 //< Average time of one float call
+} CheckResult;
+
+// Main data struct
+static struct {
+  uint32_t    repeat_count;             //< Number of passes to time over the range
+  volatile double sink;                 //< Where timed results go so they are not optimized out
+} check_data;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Float Curves
+//
+
+// Linear
+static double prv_float_linear(double t) {
+  return t;
+}
+
+// Quadratic in
+static double prv_float_quad_ease_in(double t) {
+  return t * t;
+}
+
+// Quadratic out
+static double prv_float_quad_ease_out(double t) {
+  return 1. - (1. - t) * (1. - t);
+}
+
+// Quadratic in out
+static double prv_float_quad_ease_in_out(double t) {
+  return t < 0.5 ? 2. * t * t : 1. - 2. * (1. - t) * (1. - t);
+}
+
+// Sinusoidal in
+static double prv_float_sin_ease_in(double t) {
+  return 1. - cos(t * M_PI / 2.);
+}
+
+// Sinusoidal out
+static double prv_float_sin_ease_out(double t) {
+  return sin(t * M_PI / 2.);
+}
+
+// Sinusoidal in out
+static double prv_float_sin_ease_in_out(double t) {
+  return (1. - cos(t * M_PI)) / 2.;
+}
+
+// Curves to check
+static CheckCurve check_curves[] = {
+  { "linear",           CurveLinear,        prv_float_linear },
+  { "quad_ease_in",     CurveQuadEaseIn,    prv_float_quad_ease_in },
+  { "quad_ease_out",    CurveQuadEaseOut,   prv_float_quad_ease_out },
+  { "quad_ease_in_out", CurveQuadEaseInOut, prv_float_quad_ease_in_out },
+  { "sin_ease_in",      CurveSinEaseIn,     prv_float_sin_ease_in },
+  { "sin_ease_out",     CurveSinEaseOut,    prv_float_sin_ease_out },
+  { "sin_ease_in_out",  CurveSinEaseInOut,  prv_float_sin_ease_in_out }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Get the seconds elapsed on the monotonic clock
+static double prv_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Compare a curve's table to its float curve at every fixed point progress
+static void prv_check_error(const CheckCurve *check_curve, CheckResult *result) {
+  int32_t last_progress = 0;
+  result->monotonic = true;
+  for (uint32_t percent = 0; percent <= INTERPOLATION_PROGRESS_MAX; percent++) {
+    int32_t progress = interpolation_progress(percent, INTERPOLATION_PROGRESS_MAX,
+      check_curve->curve);
+    double expected = check_curve->float_handler((double)percent / INTERPOLATION_PROGRESS_MAX) *
+      INTERPOLATION_PROGRESS_MAX;
+    double error = fabs(progress - expected);
+    if (percent % (INTERPOLATION_PROGRESS_MAX / CHECK_TABLE_SEGMENTS) == 0) {
+      result->sample_error = fmax(result->sample_error, error);
+    }
+    result->blend_error = fmax(result->blend_error, error);
+    result->monotonic = result->monotonic && progress >= last_progress;
+    last_progress = progress;
+  }
+}
+
+// Time a curve's table and float curve over the whole range
+static void prv_check_timing(const CheckCurve *check_curve, CheckResult *result) {
+  double call_count = (double)check_data.repeat_count * INTERPOLATION_PROGRESS_MAX;
+  // table
+  double start = prv_seconds();
+  int32_t table_sum = 0;
+  for (uint32_t ii = 0; ii < check_data.repeat_count; ii++) {
+    for (uint32_t percent = 0; percent < INTERPOLATION_PROGRESS_MAX; percent++) {
+      table_sum += interpolation_progress(percent, INTERPOLATION_PROGRESS_MAX,
+        check_curve->curve);
+    }
+  }
+  result->table_ns = (prv_seconds() - start) * 1e9 / call_count;
+  check_data.sink = table_sum;
+  // float curve
+  start = prv_seconds();
+  double float_sum = 0.;
+  for (uint32_t ii = 0; ii < check_data.repeat_count; ii++) {
+    for (uint32_t percent = 0; percent < INTERPOLATION_PROGRESS_MAX; percent++) {
+      float_sum += check_curve->float_handler((double)percent / INTERPOLATION_PROGRESS_MAX) *
+        INTERPOLATION_PROGRESS_MAX;
+    }
+  }
+  result->float_ns = (prv_seconds() - start) * 1e9 / call_count;
+  check_data.sink = float_sum;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+
+int main(int argc, char **argv) {
+  check_data.repeat_count = CHECK_REPEAT_COUNT;
+  bool valid = true;
+  for (int ii = 1; ii < argc && valid; ii++) {
+    if (strcmp(argv[ii], "--repeat") == 0 && ii + 1 < argc) {
+      check_data.repeat_count = atol(argv[++ii]);
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    fprintf(stderr, "Usage: %s [--repeat count]\n", argv[0]);
+    return 1;
+  }
+  // check every curve
+  printf("curve,sample_error,blend_error,monotonic,table_ns,float_ns,result\n");
+  uint32_t failed_count = 0;
+  for (uint8_t ii = 0; ii < ARRAY_LENGTH(check_curves); ii++) {
+    CheckResult result = { 0 };
+    prv_check_error(&check_curves[ii], &result);
+    prv_check_timing(&check_curves[ii], &result);
+    bool passed = result.sample_error <= CHECK_SAMPLE_MAX_ERROR &&
+      result.blend_error <= CHECK_BLEND_MAX_ERROR && result.monotonic;
+    failed_count += !passed;
+    printf("%s,%.2f,%.2f,%s,%.2f,%.2f,%s\n", check_curves[ii].name, result.sample_error,
+      result.blend_error, result.monotonic ? "yes" : "no", result.table_ns, result.float_ns,
+      passed ? "pass" : "fail");
+  }
+  fprintf(stderr, "Checked %u curves, %u failed\n", (uint32_t)ARRAY_LENGTH(check_curves),
+    failed_count);
+  return failed_count ? 1 : 0;
+}
@@ -0,0 +1,299 @@
+//! @file pebble.h
+//! @brief Host stand-in for the Pebble app SDK header
+//!
+//! Declares the subset of the app SDK used by the card renderers and data_api.c so they can be
+//! built on a host for the render check. Drawing goes to a software framebuffer in
+//! render_shim.c, which counts the cost of every call. Build with -DPBL_PLATFORM_CHALK for the
+//! round display, the default is the rectangular color display of basalt.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Platform
+#ifdef PBL_PLATFORM_CHALK
+#define PBL_ROUND
+#define PBL_COLOR
+#define PBL_DISPLAY_WIDTH 180
+#define PBL_DISPLAY_HEIGHT 180
+#define PBL_PLATFORM_NAME "chalk"
+#else
+#define PBL_PLATFORM_BASALT
+#define PBL_RECT
+#define PBL_COLOR
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#define PBL_PLATFORM_NAME "basalt"
+#endif
+
+#ifdef PBL_ROUND
+#define PBL_IF_ROUND_ELSE(if_true, if_false) (if_true)
+#define PBL_IF_RECT_ELSE(if_true, if_false) (if_false)
+#else
+#define PBL_IF_ROUND_ELSE(if_true, if_false) (if_false)
+#define PBL_IF_RECT_ELSE(if_true, if_false) (if_true)
+#endif
+#define PBL_IF_COLOR_ELSE(if_true, if_false) (if_true)
+#define PBL_IF_BW_ELSE(if_true, if_false) (if_false)
+
+//! Number of elements in an array
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+//! Trigonometry, angles run clockwise from 12 o'clock
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+
+//! Colors, two bits each of alpha, red, green and blue
+typedef union GColor8 {
+  uint8_t argb;                         //< All channels
+  struct {
+    uint8_t b : 2;                      //< Blue
+    uint8_t g : 2;                      //< Green
+    uint8_t r : 2;                      //< Red
+    uint8_t a : 2;                      //< Alpha
+  };
+} GColor8;
+typedef GColor8 GColor;
+
+#define GColorClearARGB8 0x00
+#define GColorBlackARGB8 0xC0
+#define GColorBlueARGB8 0xC3
+#define GColorDarkGreenARGB8 0xC4
+#define GColorBlueMoonARGB8 0xC7
+#define GColorGreenARGB8 0xCC
+#define GColorDarkGrayARGB8 0xD5
+#define GColorElectricBlueARGB8 0xDF
+#define GColorLightGrayARGB8 0xEA
+#define GColorRedARGB8 0xF0
+#define GColorOrangeARGB8 0xF4
+#define GColorChromeYellowARGB8 0xF8
+#define GColorMelonARGB8 0xFA
+#define GColorYellowARGB8 0xFC
+#define GColorPastelYellowARGB8 0xFE
+#define GColorWhiteARGB8 0xFF
+
+#define GColorClear ((GColor8){ .argb = GColorClearARGB8 })
+#define GColorBlack ((GColor8){ .argb = GColorBlackARGB8 })
+#define GColorBlue ((GColor8){ .argb = GColorBlueARGB8 })
+#define GColorDarkGreen ((GColor8){ .argb = GColorDarkGreenARGB8 })
+#define GColorBlueMoon ((GColor8){ .argb = GColorBlueMoonARGB8 })
+#define GColorGreen ((GColor8){ .argb = GColorGreenARGB8 })
+#define GColorDarkGray ((GColor8){ .argb = GColorDarkGrayARGB8 })
+#define GColorElectricBlue ((GColor8){ .argb = GColorElectricBlueARGB8 })
+#define GColorLightGray ((GColor8){ .argb = GColorLightGrayARGB8 })
+#define GColorRed ((GColor8){ .argb = GColorRedARGB8 })
+#define GColorOrange ((GColor8){ .argb = GColorOrangeARGB8 })
+#define GColorChromeYellow ((GColor8){ .argb = GColorChromeYellowARGB8 })
+#define GColorMelon ((GColor8){ .argb = GColorMelonARGB8 })
+#define GColorYellow ((GColor8){ .argb = GColorYellowARGB8 })
+#define GColorPastelYellow ((GColor8){ .argb = GColorPastelYellowARGB8 })
+#define GColorWhite ((GColor8){ .argb = GColorWhiteARGB8 })
+
+//! Geometry
+typedef struct {
+  int16_t x;                            //< Horizontal position
+  int16_t y;                            //< Vertical position
+} GPoint;
+
+typedef struct {
+  int16_t w;                            //< Width
+  int16_t h;                            //< Height
+} GSize;
+
+typedef struct {
+  GPoint  origin;                       //< Top left corner
+  GSize   size;                         //< Dimensions
+} GRect;
+
+typedef struct {
+  int16_t top;                          //< Inset of the top edge
+  int16_t right;                        //< Inset of the right edge
+  int16_t bottom;                       //< Inset of the bottom edge
+  int16_t left;                         //< Inset of the left edge
+} GEdgeInsets;
+
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GSize(w, h) ((GSize){ (w), (h) })
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+#define GPointZero GPoint(0, 0)
+#define GEdgeInsets1(all) ((GEdgeInsets){ (all), (all), (all), (all) })
+#define GEdgeInsets2(vertical, horizontal) \
+  ((GEdgeInsets){ (vertical), (horizontal), (vertical), (horizontal) })
+#define GEdgeInsets3(top, horizontal, bottom) \
+  ((GEdgeInsets){ (top), (horizontal), (bottom), (horizontal) })
+
+//! Rounded corners of a filled rectangle
+typedef enum {
+  GCornerNone = 0,
+  GCornerTopLeft = 1 << 0,
+  GCornerTopRight = 1 << 1,
+  GCornerBottomLeft = 1 << 2,
+  GCornerBottomRight = 1 << 3,
+  GCornersAll = 0x0f
+} GCornerMask;
+
+//! How a circle is fit into a rectangle which is not square
+typedef enum {
+  GOvalScaleModeFitCircle,
+  GOvalScaleModeFillCircle
+} GOvalScaleMode;
+
+//! Text layout
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill
+} GTextOverflowMode;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight
+} GTextAlignment;
+
+//! Bitmap formats, only named by the card declarations
+typedef enum {
+  GBitmapFormat1Bit,
+  GBitmapFormat8Bit,
+  GBitmapFormat1BitPalette,
+  GBitmapFormat2BitPalette,
+  GBitmapFormat4BitPalette
+} GBitmapFormat;
+
+//! Path of points
+typedef struct {
+  uint32_t  num_points;                 //< Number of points
+  GPoint    *points;                    //< The points
+} GPathInfo;
+
+typedef struct {
+  uint32_t  num_points;                 //< Number of points
+  GPoint    *points;                    //< The points
+  int32_t   rotation;                   //< Rotation, always 0 here
+  GPoint    offset;                     //< Offset, always 0 here
+} GPath;
+
+//! System font keys, the fake fonts take their size from the number in the key
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_LECO_26_BOLD_NUMBERS_AM_PM "RESOURCE_ID_LECO_26_BOLD_NUMBERS_AM_PM"
+#define FONT_KEY_LECO_32_BOLD_NUMBERS "RESOURCE_ID_LECO_32_BOLD_NUMBERS"
+#define FONT_KEY_LECO_42_NUMBERS "RESOURCE_ID_LECO_42_NUMBERS"
+
+//! Resources, loaded from the directory set with shim_set_resource_dir
+#define RESOURCE_ID_CUP_IMAGE 1
+
+//! Opaque handles
+typedef struct GContext GContext;
+typedef struct Layer Layer;
+typedef struct GDrawCommandImage GDrawCommandImage;
+typedef const struct ShimFont *GFont;
+typedef void *GTextAttributes;
+
+//! Calendar time, the fake clock is always UTC
+typedef struct tm tm;
+
+//! Battery state
+typedef struct {
+  uint8_t charge_percent;               //< Battery charge percent
+  bool    is_charging;                  //< Whether the battery is charging
+  bool    is_plugged;                   //< Whether the watch is plugged in
+} BatteryChargeState;
+
+//! Message between the app and worker
+typedef struct {
+  uint16_t data0;                       //< First value
+  uint16_t data1;                       //< Second value
+  uint16_t data2;                       //< Third value
+} AppWorkerMessage;
+
+//! Log levels
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200
+} AppLogLevel;
+
+//! Logging, printed on stderr
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+void app_log(uint8_t level, const char *file, int line, const char *fmt, ...);
+
+//! The fake clock replaces the system clock, so renders are the same on every run
+#define time(tloc) shim_time(tloc)
+#define localtime(timep) shim_localtime(timep)
+time_t shim_time(time_t *tloc);
+struct tm *shim_localtime(const time_t *timep);
+uint16_t time_ms(time_t *tloc, uint16_t *ms);
+void psleep(int millis);
+
+//! Persistent storage, always empty
+bool persist_exists(uint32_t key);
+int persist_get_size(uint32_t key);
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size);
+int persist_delete(uint32_t key);
+
+//! Services
+BatteryChargeState battery_state_service_peek(void);
+int app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+
+//! Layers
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+
+//! Geometry and trigonometry
+GRect grect_inset(GRect rect, GEdgeInsets insets);
+GPoint grect_center_point(const GRect *rect);
+GPoint gpoint_from_polar(GRect container, GOvalScaleMode scale_mode, int32_t angle);
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+int32_t atan2_lookup(int16_t y, int16_t x);
+GColor gcolor_legible_over(GColor background_color);
+
+//! Drawing state
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width);
+void graphics_context_set_antialiased(GContext *ctx, bool enable);
+
+//! Drawing
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_rect(GContext *ctx, GRect rect);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+                        GCornerMask corner_mask);
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_radial(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, uint16_t inset,
+                          int32_t angle_start, int32_t angle_end);
+
+//! Paths
+GPath *gpath_create(const GPathInfo *init);
+void gpath_destroy(GPath *path);
+void gpath_draw_filled(GContext *ctx, GPath *path);
+void gpath_draw_outline(GContext *ctx, GPath *path);
+void gpath_draw_outline_open(GContext *ctx, GPath *path);
+
+//! Text
+GFont fonts_get_system_font(const char *font_key);
+GSize graphics_text_layout_get_content_size(const char *text, const GFont font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment);
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes text_attributes);
+
+//! Draw command images
+GDrawCommandImage *gdraw_command_image_create_with_resource(uint32_t resource_id);
+GSize gdraw_command_image_get_bounds_size(GDrawCommandImage *image);
+void gdraw_command_image_draw(GContext *ctx, GDrawCommandImage *image, GPoint offset);
+void gdraw_command_image_destroy(GDrawCommandImage *image);
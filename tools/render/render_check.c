@@ -0,0 +1,295 @@
+// @file render_check.c
+// @brief Render every card on the host and check the images against goldens
+//
+// Usage: render_check [--update] [--repeat count] [--golden dir] [--resources dir]
+//                     [--actual dir]
+//
+// Each card is rendered against canned DataAPI snapshots (sparse and dense history, zero to
+// four alerts, each click mode) into the software framebuffer of render_shim.c, at a fixed
+// time. One CSV row per case is printed on stdout with the average time of a render over
+// --repeat renders and the drawing calls, pixels, path points and text measurements of one.
+//
+// Two cases of each card have golden images, <golden>/<platform>/<case>.ppm. Each is compared
+// to its render pixel by pixel, and the render of any that differ is written to the --actual
+// directory for review. With --update the goldens are written instead, after a change to the
+// cards which is meant to change how they look. Exits with 1 if any golden differs or is
+// missing.
+//
+// Build from the repository root, adding -DPBL_PLATFORM_CHALK for the round display:
+//   cc -O2 -I tools/render -o render_check tools/render/render_check.c
+//     tools/render/render_shim.c src/drawing/cards/*.c src/data/data_api.c src/utility.c -lm
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include <errno.h>
+#include "render_shim.h"
+#include "../../src/drawing/cards/card_render.h"
+#include "../../src/utility.h"
+
+// Constants
+#define RENDER_TIME 1476716400          //< Time of every render, October 17 2016 at 15:00 UTC
+#define RENDER_REPEAT_COUNT 100         //< Default number of renders to time for each case
+#define RENDER_SPARSE_POINT_COUNT 6     //< Number of data points in the sparse snapshot
+#define RENDER_DENSE_POINT_COUNT (DATA_POINT_MAX_COUNT - 1) //< Points in the dense snapshot
+#define RENDER_CHARGE_RATE (-6048)      //< Seconds per percent in the snapshots, a 7 day life
+#define RENDER_CLICK_MODE_COUNT 3       //< Click counts rendered for each snapshot
+#define RENDER_PATH_MAX_LENGTH 512      //< Longest path of a golden image
+
+// Card under test
+typedef struct {
+  char                *name;            //< Name of the card in the output and goldens
+  void                (*render_handler)(Layer*, GContext*, uint16_t, DataAPI*);
+  GColor              background_color; //< Background the card is drawn over
+} RenderCard;
+
+// Cards to render
+static RenderCard render_cards[] = {
+  { "dashboard",   card_render_dashboard,   CARD_BACK_COLOR_DASHBOARD },
+  { "line_graph",  card_render_line_graph,  CARD_BACK_COLOR_LINE_GRAPH },
+  { "bar_graph",   card_render_bar_graph,   CARD_BACK_COLOR_BAR_GRAPH },
+  { "record_life", card_render_record_life, CARD_BACK_COLOR_RECORD_LIFE }
+};
+
+// Result of comparing a render to its golden
+typedef enum {
+  RenderGoldenNone,
+  RenderGoldenMatch,
+  RenderGoldenDiffers,
+  RenderGoldenMissing,
+  RenderGoldenUpdated
+} RenderGolden;
+
+// Names of each RenderGolden
+static const char *render_golden_names[] = { "", "match", "differs", "missing", "updated" };
+
+// Main data struct
+static struct {
+  GContext    *ctx;                     //< Graphics context rendered into
+  Layer       *layer;                   //< Layer with the bounds of the display
+  DataAPI     *data_api;                //< Canned data snapshot for the current case
+  uint32_t    repeat_count;             //< Number of renders to time for each case
+  bool        update;                   //< Whether to write the goldens instead of checking
+  const char  *golden_dir;              //< Directory of the goldens of each platform
+  const char  *actual_dir;              //< Directory to write renders which differ to
+} render_data;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Fill the DataAPI with a canned snapshot and set the battery state to match
+static void prv_build_snapshot(DataAPI *data_api, bool dense, uint8_t alert_count) {
+  memset(data_api, 0, sizeof(DataAPI));
+  time_t cur_time = RENDER_TIME;
+  uint8_t point_count = dense ? RENDER_DENSE_POINT_COUNT : RENDER_SPARSE_POINT_COUNT;
+  // data points, newest first, spread over two weeks with a charge in the middle
+  int32_t point_spacing = SEC_IN_WEEK * 2 / point_count;
+  for (uint8_t ii = 0; ii < point_count; ii++) {
+    data_api->data_pt_epochs[ii] = cur_time - ii * point_spacing;
+    data_api->data_pt_percents[ii] = 100 - (ii % (point_count / 2)) * 90 / (point_count / 2);
+  }
+  data_api->data_pt_count = point_count;
+  // charge cycles
+  data_api->cycle_count = dense ? CHARGE_CYCLE_MAX_COUNT : 1;
+  for (uint8_t ii = 0; ii < data_api->cycle_count; ii++) {
+    data_api->run_times[ii] = SEC_IN_DAY * (5 + ii % 3);
+    data_api->max_lives[ii] = SEC_IN_DAY * (6 + ii % 2);
+  }
+  // current stats
+  data_api->charge_rate = RENDER_CHARGE_RATE;
+  data_api->last_charged_time = cur_time - SEC_IN_DAY * 3;
+  data_api->charge_by_time = cur_time + data_api->data_pt_percents[0] * -RENDER_CHARGE_RATE;
+  data_api->record_run_time = SEC_IN_DAY * 8;
+  // alerts, sorted short to long
+  for (uint8_t ii = 0; ii < alert_count; ii++) {
+    data_api->alert_threshold[ii] = SEC_IN_HR * 4 + ii * SEC_IN_DAY;
+  }
+  data_api->alert_count = alert_count;
+  // the battery service agrees with the newest data point
+  BatteryChargeState battery_state = {
+    .charge_percent = data_api->data_pt_percents[0] - BATTERY_PERCENTAGE_OFFSET
+  };
+  shim_set_battery(battery_state);
+}
+
+// Whether a case has a golden image, the sparse one without alerts and the dense one with the
+// most alerts after a click, so every card is checked in its simplest and busiest states
+static bool prv_has_golden(bool dense, uint8_t alert_count, uint16_t click_count) {
+  return dense ? alert_count == DATA_ALERT_MAX_COUNT && click_count == 1 :
+    !alert_count && !click_count;
+}
+
+// Get the seconds elapsed on the monotonic clock
+static double prv_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Write the framebuffer as a binary PPM image
+static bool prv_write_image(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+  const GColor8 *pixels = shim_context_get_pixels(render_data.ctx);
+  for (uint32_t ii = 0; ii < PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT; ii++) {
+    uint8_t rgb[] = { pixels[ii].r * 85, pixels[ii].g * 85, pixels[ii].b * 85 };
+    fwrite(rgb, 1, sizeof(rgb), file);
+  }
+  return fclose(file) == 0;
+}
+
+// Count the pixels of the framebuffer which differ from a binary PPM image
+// Returns -1 if the image could not be read or is not the size of the display
+static int32_t prv_compare_image(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return -1;
+  }
+  int width, height, max_value;
+  int32_t differ_count = -1;
+  if (fscanf(file, "P6 %d %d %d", &width, &height, &max_value) == 3 && fgetc(file) != EOF &&
+      width == PBL_DISPLAY_WIDTH && height == PBL_DISPLAY_HEIGHT && max_value == 255) {
+    const GColor8 *pixels = shim_context_get_pixels(render_data.ctx);
+    differ_count = 0;
+    for (uint32_t ii = 0; ii < PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT; ii++) {
+      uint8_t rgb[3];
+      if (fread(rgb, 1, sizeof(rgb), file) != sizeof(rgb)) {
+        differ_count = -1;
+        break;
+      }
+      differ_count += rgb[0] != pixels[ii].r * 85 || rgb[1] != pixels[ii].g * 85 ||
+        rgb[2] != pixels[ii].b * 85;
+    }
+  }
+  fclose(file);
+  return differ_count;
+}
+
+// Check the render of a case against its golden, or write the golden with --update
+static RenderGolden prv_check_golden(const char *case_name) {
+  char path[RENDER_PATH_MAX_LENGTH];
+  snprintf(path, sizeof(path), "%s/%s/%s.ppm", render_data.golden_dir, PBL_PLATFORM_NAME,
+    case_name);
+  if (render_data.update) {
+    if (!prv_write_image(path)) {
+      fprintf(stderr, "Could not write %s: %s\n", path, strerror(errno));
+      return RenderGoldenMissing;
+    }
+    return RenderGoldenUpdated;
+  }
+  int32_t differ_count = prv_compare_image(path);
+  if (differ_count < 0) {
+    fprintf(stderr, "Could not read %s\n", path);
+    return RenderGoldenMissing;
+  }
+  if (!differ_count) {
+    return RenderGoldenMatch;
+  }
+  // write the render for review
+  char actual_path[RENDER_PATH_MAX_LENGTH];
+  snprintf(actual_path, sizeof(actual_path), "%s/%s_%s.actual.ppm", render_data.actual_dir,
+    PBL_PLATFORM_NAME, case_name);
+  fprintf(stderr, "%s differs from %s in %d pixels, see %s\n", case_name, path,
+    (int)differ_count, actual_path);
+  if (!prv_write_image(actual_path)) {
+    fprintf(stderr, "Could not write %s: %s\n", actual_path, strerror(errno));
+  }
+  return RenderGoldenDiffers;
+}
+
+// Render one case, timing it and checking it against its golden if it has one
+static RenderGolden prv_render_case(RenderCard *card, bool dense, uint8_t alert_count,
+                                    uint16_t click_count) {
+  char case_name[64];
+  snprintf(case_name, sizeof(case_name), "%s_%s_%da_%dc", card->name,
+    dense ? "dense" : "sparse", alert_count, click_count);
+  prv_build_snapshot(render_data.data_api, dense, alert_count);
+  // count the cost of one render and check its image
+  shim_set_time(RENDER_TIME);
+  shim_context_clear(render_data.ctx, card->background_color);
+  shim_reset_stats();
+  card->render_handler(render_data.layer, render_data.ctx, click_count, render_data.data_api);
+  ShimStats stats = *shim_get_stats();
+  RenderGolden golden = RenderGoldenNone;
+  if (prv_has_golden(dense, alert_count, click_count)) {
+    golden = prv_check_golden(case_name);
+  }
+  // time repeated renders, clearing the framebuffer between them
+  double seconds = 0;
+  for (uint32_t ii = 0; ii < render_data.repeat_count; ii++) {
+    shim_set_time(RENDER_TIME);
+    shim_context_clear(render_data.ctx, card->background_color);
+    double start = prv_seconds();
+    card->render_handler(render_data.layer, render_data.ctx, click_count, render_data.data_api);
+    seconds += prv_seconds() - start;
+  }
+  double render_us = render_data.repeat_count ? seconds * 1e6 / render_data.repeat_count : 0;
+  printf("%s,%s,%s,%d,%d,%.1f,%u,%u,%u,%u,%s\n", PBL_PLATFORM_NAME, card->name,
+    dense ? "dense" : "sparse", alert_count, click_count, render_us, stats.draw_calls,
+    stats.pixels, stats.path_points, stats.text_measurements, render_golden_names[golden]);
+  return golden;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+
+int main(int argc, char **argv) {
+  render_data.repeat_count = RENDER_REPEAT_COUNT;
+  render_data.golden_dir = "tools/render/golden";
+  render_data.actual_dir = ".";
+  bool valid = true;
+  for (int ii = 1; ii < argc && valid; ii++) {
+    if (strcmp(argv[ii], "--update") == 0) {
+      render_data.update = true;
+    } else if (strcmp(argv[ii], "--repeat") == 0 && ii + 1 < argc) {
+      render_data.repeat_count = atol(argv[++ii]);
+    } else if (strcmp(argv[ii], "--golden") == 0 && ii + 1 < argc) {
+      render_data.golden_dir = argv[++ii];
+    } else if (strcmp(argv[ii], "--resources") == 0 && ii + 1 < argc) {
+      shim_set_resource_dir(argv[++ii]);
+    } else if (strcmp(argv[ii], "--actual") == 0 && ii + 1 < argc) {
+      render_data.actual_dir = argv[++ii];
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    fprintf(stderr, "Usage: %s [--update] [--repeat count] [--golden dir] [--resources dir] "
+      "[--actual dir]\n", argv[0]);
+    return 1;
+  }
+  render_data.ctx = shim_context_create();
+  render_data.layer = layer_create(GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT));
+  render_data.data_api = MALLOC(sizeof(DataAPI));
+  // render every case
+  printf("platform,card,history,alerts,clicks,render_us,draw_calls,pixels,path_points,"
+    "text_measurements,golden\n");
+  uint32_t case_count = 0, golden_count = 0, failed_count = 0;
+  for (uint8_t dense = 0; dense < 2; dense++) {
+    for (uint8_t alert_count = 0; alert_count <= DATA_ALERT_MAX_COUNT; alert_count++) {
+      for (uint8_t ii = 0; ii < ARRAY_LENGTH(render_cards); ii++) {
+        for (uint16_t click_count = 0; click_count < RENDER_CLICK_MODE_COUNT; click_count++) {
+          RenderGolden golden = prv_render_case(&render_cards[ii], dense, alert_count,
+            click_count);
+          case_count++;
+          golden_count += golden != RenderGoldenNone;
+          failed_count += golden == RenderGoldenDiffers || golden == RenderGoldenMissing;
+        }
+      }
+    }
+  }
+  fprintf(stderr, "Rendered %u cases on %s, %u goldens %s, %u failed\n", case_count,
+    PBL_PLATFORM_NAME, golden_count, render_data.update ? "written" : "checked", failed_count);
+  free(render_data.data_api);
+  layer_destroy(render_data.layer);
+  shim_context_destroy(render_data.ctx);
+  return failed_count ? 1 : 0;
+}
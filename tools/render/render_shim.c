@@ -0,0 +1,761 @@
+// @file render_shim.c
+// @brief Host stand-in for the Pebble app SDK
+//
+// Draws into an 8 bit color framebuffer without anti-aliasing or blending. Shapes are filled
+// where the center of a pixel falls inside them, lines are stamped with a square the size of
+// the stroke width, and text is drawn as one block per character with fake fonts whose size is
+// the number in the font key. Images are the app's draw command resources, read from disk.
+// None of this is pixel exact with the watch; it is stable, so the goldens catch any change in
+// what the cards draw.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include <math.h>
+#include <stdarg.h>
+#include "render_shim.h"
+
+// Constants
+#define SHIM_FONT_MAX_COUNT 8           //< Most fonts loaded at once
+#define SHIM_PATH_MAX_LENGTH 512        //< Longest path of a resource
+#define SHIM_PDC_HEADER_SIZE 8          //< Size of the magic and size before the image
+#define SHIM_PDC_IMAGE_HEADER_SIZE 6    //< Size of the version and view box before the commands
+#define SHIM_PDC_COMMAND_HEADER_SIZE 9  //< Size of a draw command before its points
+#define SHIM_PI 3.14159265358979323846
+
+// Fake font
+struct ShimFont {
+  const char  *key;                     //< Font key it was loaded with
+  int16_t     size;                     //< Line height in pixels
+};
+
+// Graphics context
+struct GContext {
+  GColor8     *pixels;                  //< Framebuffer, row by row from the top left
+  GColor      stroke_color;             //< Color of lines and outlines
+  GColor      fill_color;               //< Color of filled shapes
+  GColor      text_color;               //< Color of text
+  uint8_t     stroke_width;             //< Width of lines and outlines
+  bool        antialiased;              //< Whether anti-aliasing is on, ignored
+};
+
+// Layer
+struct Layer {
+  GRect       bounds;                   //< Bounds of the layer
+};
+
+// Draw command image, the contents of a PDC resource
+struct GDrawCommandImage {
+  GSize       view_box;                 //< Size of the image
+  size_t      size;                     //< Size of the command list in bytes
+  uint8_t     commands[];               //< Command list, as stored in the resource
+};
+
+// Draw command types
+typedef enum {
+  ShimCommandPath = 1,
+  ShimCommandCircle = 2,
+  ShimCommandPrecisePath = 3
+} ShimCommandType;
+
+// Main data struct
+static struct {
+  int64_t             now_ms;           //< Current time in milliseconds
+  BatteryChargeState  battery_state;    //< Current battery state
+  const char          *resource_dir;    //< Directory resources are loaded from
+  struct ShimFont     fonts[SHIM_FONT_MAX_COUNT]; //< Fonts loaded so far
+  uint8_t             font_count;       //< Number of fonts loaded
+  struct tm           local_time;       //< Result of the last localtime call
+  ShimStats           stats;            //< Counters since the last reset
+} shim_data = { .resource_dir = "resources" };
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Write one pixel, skipping those off screen or with a clear color
+static void prv_plot(GContext *ctx, int32_t x, int32_t y, GColor color) {
+  if (x < 0 || y < 0 || x >= PBL_DISPLAY_WIDTH || y >= PBL_DISPLAY_HEIGHT || !color.a) {
+    return;
+  }
+  ctx->pixels[y * PBL_DISPLAY_WIDTH + x] = color;
+  shim_data.stats.pixels++;
+}
+
+// Write a square of pixels centered on a point, as a stroke of a width
+static void prv_stamp(GContext *ctx, int32_t x, int32_t y, uint8_t width, GColor color) {
+  if (width <= 1) {
+    prv_plot(ctx, x, y, color);
+    return;
+  }
+  for (int32_t yy = y - width / 2; yy < y - width / 2 + width; yy++) {
+    for (int32_t xx = x - width / 2; xx < x - width / 2 + width; xx++) {
+      prv_plot(ctx, xx, yy, color);
+    }
+  }
+}
+
+// Draw a line with Bresenham's algorithm, stamping each point with the stroke width
+static void prv_line(GContext *ctx, GPoint p0, GPoint p1, uint8_t width, GColor color) {
+  int32_t x = p0.x, y = p0.y;
+  int32_t dx = abs(p1.x - p0.x), dy = -abs(p1.y - p0.y);
+  int32_t sx = p0.x < p1.x ? 1 : -1, sy = p0.y < p1.y ? 1 : -1;
+  int32_t error = dx + dy;
+  while (true) {
+    prv_stamp(ctx, x, y, width, color);
+    if (x == p1.x && y == p1.y) {
+      break;
+    }
+    int32_t double_error = 2 * error;
+    if (double_error >= dy) {
+      error += dy;
+      x += sx;
+    }
+    if (double_error <= dx) {
+      error += dx;
+      y += sy;
+    }
+  }
+}
+
+// Draw lines between the points of a path, closing it if not open
+static void prv_outline(GContext *ctx, const GPoint *points, uint32_t count, GPoint offset,
+                        bool open, uint8_t width, GColor color) {
+  for (uint32_t ii = 0; ii + 1 < count + (open ? 0 : 1) && count > 1; ii++) {
+    GPoint p0 = points[ii], p1 = points[(ii + 1) % count];
+    prv_line(ctx, GPoint(p0.x + offset.x, p0.y + offset.y),
+      GPoint(p1.x + offset.x, p1.y + offset.y), width, color);
+  }
+}
+
+// Fill a polygon with the even-odd rule, sampling each pixel at its center
+static void prv_fill_polygon(GContext *ctx, const GPoint *points, uint32_t count, GPoint offset,
+                             GColor color) {
+  if (count < 3) {
+    return;
+  }
+  int32_t min_y = points[0].y, max_y = points[0].y;
+  for (uint32_t ii = 1; ii < count; ii++) {
+    min_y = points[ii].y < min_y ? points[ii].y : min_y;
+    max_y = points[ii].y > max_y ? points[ii].y : max_y;
+  }
+  double *crossings = malloc(sizeof(double) * count);
+  for (int32_t y = min_y; y < max_y; y++) {
+    // find where each edge crosses the center of this row
+    double center_y = y + 0.5;
+    uint32_t crossing_count = 0;
+    for (uint32_t ii = 0; ii < count; ii++) {
+      GPoint a = points[ii], b = points[(ii + 1) % count];
+      if ((a.y <= center_y) != (b.y <= center_y)) {
+        crossings[crossing_count++] = a.x + (center_y - a.y) * (b.x - a.x) / (b.y - a.y);
+      }
+    }
+    // sort the crossings, there are only a few
+    for (uint32_t ii = 1; ii < crossing_count; ii++) {
+      for (uint32_t jj = ii; jj > 0 && crossings[jj - 1] > crossings[jj]; jj--) {
+        double swap = crossings[jj];
+        crossings[jj] = crossings[jj - 1];
+        crossings[jj - 1] = swap;
+      }
+    }
+    // fill the pixels whose centers are between each pair
+    for (uint32_t ii = 0; ii + 1 < crossing_count; ii += 2) {
+      for (int32_t x = ceil(crossings[ii] - 0.5); x < ceil(crossings[ii + 1] - 0.5); x++) {
+        prv_plot(ctx, x + offset.x, y + offset.y, color);
+      }
+    }
+  }
+  free(crossings);
+}
+
+// Fill the pixels of a ring around a point, from an inner to an outer radius
+static void prv_fill_ring(GContext *ctx, double center_x, double center_y, double inner_radius,
+                          double outer_radius, GColor color) {
+  for (int32_t y = floor(center_y - outer_radius); y <= ceil(center_y + outer_radius); y++) {
+    for (int32_t x = floor(center_x - outer_radius); x <= ceil(center_x + outer_radius); x++) {
+      double distance = hypot(x + 0.5 - center_x, y + 0.5 - center_y);
+      if (distance <= outer_radius && distance >= inner_radius) {
+        prv_plot(ctx, x, y, color);
+      }
+    }
+  }
+}
+
+// Get the radius of the circle fit into or filling a rectangle
+static double prv_oval_radius(GRect rect, GOvalScaleMode scale_mode) {
+  int16_t small_side = rect.size.w < rect.size.h ? rect.size.w : rect.size.h;
+  int16_t large_side = rect.size.w > rect.size.h ? rect.size.w : rect.size.h;
+  return (scale_mode == GOvalScaleModeFitCircle ? small_side : large_side) / 2.0;
+}
+
+// Read a little endian integer from a resource
+static int32_t prv_read_int(const uint8_t *data, uint8_t size, bool is_signed) {
+  uint32_t value = 0;
+  for (uint8_t ii = 0; ii < size; ii++) {
+    value |= (uint32_t)data[ii] << (ii * 8);
+  }
+  if (is_signed && size < 4 && (value & (1u << (size * 8 - 1)))) {
+    value |= ~0u << (size * 8);
+  }
+  return (int32_t)value;
+}
+
+// Open a resource by its ID, preferring the round variant on round displays
+static FILE *prv_open_resource(uint32_t resource_id) {
+  const char *name = NULL;
+  switch (resource_id) {
+    case RESOURCE_ID_CUP_IMAGE:
+      name = "cup";
+      break;
+    default:
+      return NULL;
+  }
+  char path[SHIM_PATH_MAX_LENGTH];
+  FILE *file = NULL;
+#ifdef PBL_ROUND
+  snprintf(path, sizeof(path), "%s/%s~round.pdc", shim_data.resource_dir, name);
+  file = fopen(path, "rb");
+#endif
+  if (!file) {
+    snprintf(path, sizeof(path), "%s/%s.pdc", shim_data.resource_dir, name);
+    file = fopen(path, "rb");
+  }
+  if (!file) {
+    fprintf(stderr, "Could not open resource %s\n", path);
+  }
+  return file;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Clock, Storage and Services
+//
+
+// Log a message on stderr
+void app_log(uint8_t level, const char *file, int line, const char *fmt, ...) {
+  fprintf(stderr, "[%s:%d] ", file, line);
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fprintf(stderr, "\n");
+}
+
+// Get the time of the fake clock
+time_t shim_time(time_t *tloc) {
+  time_t now = shim_data.now_ms / 1000;
+  if (tloc) {
+    (*tloc) = now;
+  }
+  return now;
+}
+
+// Get the calendar time of the fake clock, which is in UTC
+struct tm *shim_localtime(const time_t *timep) {
+  gmtime_r(timep, &shim_data.local_time);
+  return &shim_data.local_time;
+}
+
+// Get the time of the fake clock with milliseconds
+uint16_t time_ms(time_t *tloc, uint16_t *ms) {
+  shim_time(tloc);
+  uint16_t now_ms = shim_data.now_ms % 1000;
+  if (ms) {
+    (*ms) = now_ms;
+  }
+  return now_ms;
+}
+
+// Sleep by advancing the fake clock, so a wait for data which never arrives still ends
+void psleep(int millis) {
+  shim_data.now_ms += millis;
+}
+
+// Persistent storage, which is always empty
+bool persist_exists(uint32_t key) {
+  return false;
+}
+
+int persist_get_size(uint32_t key) {
+  return -4;
+}
+
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size) {
+  return -4;
+}
+
+int persist_delete(uint32_t key) {
+  return 0;
+}
+
+// Get the battery state
+BatteryChargeState battery_state_service_peek(void) {
+  return shim_data.battery_state;
+}
+
+// Send a message to the worker, which there is none of
+int app_worker_send_message(uint8_t type, AppWorkerMessage *data) {
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Layers, Geometry and Drawing State
+//
+
+// Create a layer
+Layer *layer_create(GRect frame) {
+  Layer *layer = malloc(sizeof(Layer));
+  layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+  return layer;
+}
+
+// Destroy a layer
+void layer_destroy(Layer *layer) {
+  free(layer);
+}
+
+// Get the bounds of a layer
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+// Inset a rectangle, giving an empty rectangle if the insets overlap
+GRect grect_inset(GRect rect, GEdgeInsets insets) {
+  GRect result = GRect(rect.origin.x + insets.left, rect.origin.y + insets.top,
+    rect.size.w - insets.left - insets.right, rect.size.h - insets.top - insets.bottom);
+  if (result.size.w < 0 || result.size.h < 0) {
+    return GRect(0, 0, 0, 0);
+  }
+  return result;
+}
+
+// Get the center of a rectangle
+GPoint grect_center_point(const GRect *rect) {
+  return GPoint(rect->origin.x + rect->size.w / 2, rect->origin.y + rect->size.h / 2);
+}
+
+// Get the point at an angle on the circle fit into or filling a rectangle
+GPoint gpoint_from_polar(GRect container, GOvalScaleMode scale_mode, int32_t angle) {
+  double radius = prv_oval_radius(container, scale_mode);
+  double radians = angle * 2 * SHIM_PI / TRIG_MAX_ANGLE;
+  return GPoint(lround(container.origin.x + container.size.w / 2.0 + radius * sin(radians)),
+    lround(container.origin.y + container.size.h / 2.0 - radius * cos(radians)));
+}
+
+// Sine of an angle, scaled by TRIG_MAX_RATIO
+int32_t sin_lookup(int32_t angle) {
+  return lround(sin(angle * 2 * SHIM_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+// Cosine of an angle, scaled by TRIG_MAX_RATIO
+int32_t cos_lookup(int32_t angle) {
+  return lround(cos(angle * 2 * SHIM_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+// Angle of a vector, from 0 to TRIG_MAX_ANGLE
+int32_t atan2_lookup(int16_t y, int16_t x) {
+  double radians = atan2(y, x);
+  if (radians < 0) {
+    radians += 2 * SHIM_PI;
+  }
+  return lround(radians * TRIG_MAX_ANGLE / (2 * SHIM_PI)) % TRIG_MAX_ANGLE;
+}
+
+// Get black or white, whichever is legible over a color
+GColor gcolor_legible_over(GColor background_color) {
+  uint32_t luminance = background_color.r * 299 + background_color.g * 587 +
+    background_color.b * 114;
+  return luminance >= 1500 ? GColorBlack : GColorWhite;
+}
+
+// Set the color of lines and outlines
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+// Set the color of filled shapes
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+// Set the color of text
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+// Set the width of lines and outlines
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width) {
+  ctx->stroke_width = stroke_width ? stroke_width : 1;
+}
+
+// Set whether anti-aliasing is on, which the framebuffer ignores
+void graphics_context_set_antialiased(GContext *ctx, bool enable) {
+  ctx->antialiased = enable;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Drawing
+//
+
+// Draw a line
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  shim_data.stats.draw_calls++;
+  prv_line(ctx, p0, p1, ctx->stroke_width, ctx->stroke_color);
+}
+
+// Draw the one pixel outline of a rectangle
+void graphics_draw_rect(GContext *ctx, GRect rect) {
+  shim_data.stats.draw_calls++;
+  if (rect.size.w <= 0 || rect.size.h <= 0) {
+    return;
+  }
+  int16_t right = rect.origin.x + rect.size.w - 1, bottom = rect.origin.y + rect.size.h - 1;
+  GPoint corners[] = { rect.origin, GPoint(right, rect.origin.y), GPoint(right, bottom),
+    GPoint(rect.origin.x, bottom) };
+  prv_outline(ctx, corners, ARRAY_LENGTH(corners), GPointZero, false, 1, ctx->stroke_color);
+}
+
+// Fill a rectangle, rounding the corners in the mask
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+                        GCornerMask corner_mask) {
+  shim_data.stats.draw_calls++;
+  int32_t left = rect.origin.x, top = rect.origin.y;
+  int32_t right = left + rect.size.w, bottom = top + rect.size.h;
+  double radius = corner_radius;
+  for (int32_t y = top; y < bottom; y++) {
+    for (int32_t x = left; x < right; x++) {
+      // find the center of the corner circle this pixel is in, if any
+      bool is_left = x < left + radius, is_top = y < top + radius;
+      bool is_right = x >= right - radius, is_bottom = y >= bottom - radius;
+      GCornerMask corner = GCornerNone;
+      if (is_top && (is_left || is_right)) {
+        corner = is_left ? GCornerTopLeft : GCornerTopRight;
+      } else if (is_bottom && (is_left || is_right)) {
+        corner = is_left ? GCornerBottomLeft : GCornerBottomRight;
+      }
+      if (corner & corner_mask) {
+        double center_x = is_left ? left + radius : right - radius;
+        double center_y = is_top ? top + radius : bottom - radius;
+        if (hypot(x + 0.5 - center_x, y + 0.5 - center_y) > radius) {
+          continue;
+        }
+      }
+      prv_plot(ctx, x, y, ctx->fill_color);
+    }
+  }
+}
+
+// Draw the outline of a circle with the stroke width
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  shim_data.stats.draw_calls++;
+  double half_width = ctx->stroke_width / 2.0;
+  prv_fill_ring(ctx, p.x + 0.5, p.y + 0.5, radius - half_width, radius + half_width,
+    ctx->stroke_color);
+}
+
+// Fill a circle
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  shim_data.stats.draw_calls++;
+  prv_fill_ring(ctx, p.x + 0.5, p.y + 0.5, 0, radius + 0.5, ctx->fill_color);
+}
+
+// Fill the part of a ring between two angles, wrapping past 12 o'clock if the end is smaller
+void graphics_fill_radial(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, uint16_t inset,
+                          int32_t angle_start, int32_t angle_end) {
+  shim_data.stats.draw_calls++;
+  if (angle_end == angle_start) {
+    return;
+  }
+  if (angle_end < angle_start) {
+    angle_end += TRIG_MAX_ANGLE;
+  }
+  double outer_radius = prv_oval_radius(rect, scale_mode);
+  double inner_radius = outer_radius - inset;
+  double center_x = rect.origin.x + rect.size.w / 2.0;
+  double center_y = rect.origin.y + rect.size.h / 2.0;
+  for (int32_t y = floor(center_y - outer_radius); y <= ceil(center_y + outer_radius); y++) {
+    for (int32_t x = floor(center_x - outer_radius); x <= ceil(center_x + outer_radius); x++) {
+      double dx = x + 0.5 - center_x, dy = y + 0.5 - center_y;
+      double distance = hypot(dx, dy);
+      if (distance > outer_radius || distance < inner_radius) {
+        continue;
+      }
+      double radians = atan2(dx, -dy);
+      if (radians < 0) {
+        radians += 2 * SHIM_PI;
+      }
+      int32_t angle = radians * TRIG_MAX_ANGLE / (2 * SHIM_PI);
+      if ((angle >= angle_start && angle < angle_end) ||
+          (angle + TRIG_MAX_ANGLE >= angle_start && angle + TRIG_MAX_ANGLE < angle_end)) {
+        prv_plot(ctx, x, y, ctx->fill_color);
+      }
+    }
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Paths
+//
+
+// Create a path, copying its points
+GPath *gpath_create(const GPathInfo *init) {
+  GPath *path = malloc(sizeof(GPath));
+  (*path) = (GPath) {
+    .num_points = init->num_points,
+    .points = malloc(sizeof(GPoint) * init->num_points)
+  };
+  memcpy(path->points, init->points, sizeof(GPoint) * init->num_points);
+  return path;
+}
+
+// Destroy a path
+void gpath_destroy(GPath *path) {
+  free(path->points);
+  free(path);
+}
+
+// Fill a path
+void gpath_draw_filled(GContext *ctx, GPath *path) {
+  shim_data.stats.draw_calls++;
+  shim_data.stats.path_points += path->num_points;
+  prv_fill_polygon(ctx, path->points, path->num_points, path->offset, ctx->fill_color);
+}
+
+// Draw the closed outline of a path
+void gpath_draw_outline(GContext *ctx, GPath *path) {
+  shim_data.stats.draw_calls++;
+  shim_data.stats.path_points += path->num_points;
+  prv_outline(ctx, path->points, path->num_points, path->offset, false, ctx->stroke_width,
+    ctx->stroke_color);
+}
+
+// Draw the open outline of a path
+void gpath_draw_outline_open(GContext *ctx, GPath *path) {
+  shim_data.stats.draw_calls++;
+  shim_data.stats.path_points += path->num_points;
+  prv_outline(ctx, path->points, path->num_points, path->offset, true, ctx->stroke_width,
+    ctx->stroke_color);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Text
+//
+
+// Get a fake font, sized by the first number in its key
+GFont fonts_get_system_font(const char *font_key) {
+  for (uint8_t ii = 0; ii < shim_data.font_count; ii++) {
+    if (strcmp(shim_data.fonts[ii].key, font_key) == 0) {
+      return &shim_data.fonts[ii];
+    }
+  }
+  if (shim_data.font_count >= SHIM_FONT_MAX_COUNT) {
+    return NULL;
+  }
+  const char *digits = strpbrk(font_key, "0123456789");
+  struct ShimFont *font = &shim_data.fonts[shim_data.font_count++];
+  font->key = font_key;
+  font->size = digits ? atoi(digits) : 14;
+  return font;
+}
+
+// Get the width a character takes up in a font
+static int16_t prv_char_advance(GFont font, char character) {
+  return character == ' ' ? font->size / 3 : font->size * 5 / 9;
+}
+
+// Get the width a line of text takes up in a font
+static int16_t prv_text_width(const char *text, GFont font) {
+  int16_t width = 0;
+  for (const char *character = text; *character; character++) {
+    width += prv_char_advance(font, *character);
+  }
+  return width;
+}
+
+// Get the size of text, on one line
+GSize graphics_text_layout_get_content_size(const char *text, const GFont font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment) {
+  shim_data.stats.text_measurements++;
+  int16_t width = prv_text_width(text, font);
+  return GSize(width < box.size.w ? width : box.size.w, *text ? font->size : 0);
+}
+
+// Draw text on one line, each character as a block
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes text_attributes) {
+  shim_data.stats.draw_calls++;
+  int16_t x = box.origin.x;
+  if (alignment == GTextAlignmentCenter) {
+    x += (box.size.w - prv_text_width(text, font)) / 2;
+  } else if (alignment == GTextAlignmentRight) {
+    x += box.size.w - prv_text_width(text, font);
+  }
+  int16_t top = box.origin.y + font->size / 4, bottom = box.origin.y + font->size * 5 / 6;
+  for (const char *character = text; *character; character++) {
+    int16_t advance = prv_char_advance(font, *character);
+    if (*character != ' ') {
+      for (int16_t yy = top; yy < bottom; yy++) {
+        for (int16_t xx = x + 1; xx < x + advance - 1; xx++) {
+          prv_plot(ctx, xx, yy, ctx->text_color);
+        }
+      }
+    }
+    x += advance;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Draw Command Images
+//
+
+// Load a draw command image from the resources directory
+GDrawCommandImage *gdraw_command_image_create_with_resource(uint32_t resource_id) {
+  FILE *file = prv_open_resource(resource_id);
+  if (!file) {
+    return NULL;
+  }
+  // check the header, then read the image
+  uint8_t header[SHIM_PDC_HEADER_SIZE + SHIM_PDC_IMAGE_HEADER_SIZE];
+  GDrawCommandImage *image = NULL;
+  if (fread(header, 1, sizeof(header), file) == sizeof(header) &&
+      memcmp(header, "PDCI", 4) == 0 && header[SHIM_PDC_HEADER_SIZE] == 1) {
+    size_t size = prv_read_int(&header[4], 4, false) - SHIM_PDC_IMAGE_HEADER_SIZE;
+    image = malloc(sizeof(GDrawCommandImage) + size);
+    image->view_box = GSize(prv_read_int(&header[10], 2, true),
+      prv_read_int(&header[12], 2, true));
+    image->size = size;
+    if (fread(image->commands, 1, size, file) != size) {
+      free(image);
+      image = NULL;
+    }
+  }
+  fclose(file);
+  return image;
+}
+
+// Get the size of a draw command image
+GSize gdraw_command_image_get_bounds_size(GDrawCommandImage *image) {
+  return image->view_box;
+}
+
+// Draw each command of a draw command image
+void gdraw_command_image_draw(GContext *ctx, GDrawCommandImage *image, GPoint offset) {
+  shim_data.stats.draw_calls++;
+  uint16_t command_count = image->size >= 2 ? prv_read_int(image->commands, 2, false) : 0;
+  size_t position = 2;
+  for (uint16_t ii = 0; ii < command_count; ii++) {
+    if (position + SHIM_PDC_COMMAND_HEADER_SIZE > image->size) {
+      return;
+    }
+    const uint8_t *command = &image->commands[position];
+    uint16_t point_count = prv_read_int(&command[7], 2, false);
+    position += SHIM_PDC_COMMAND_HEADER_SIZE + point_count * 4;
+    if (position > image->size) {
+      return;
+    }
+    // read the points, precise points are in eighths of a pixel
+    GPoint *points = malloc(sizeof(GPoint) * (point_count ? point_count : 1));
+    for (uint16_t jj = 0; jj < point_count; jj++) {
+      const uint8_t *point = &command[SHIM_PDC_COMMAND_HEADER_SIZE + jj * 4];
+      int16_t x = prv_read_int(point, 2, true), y = prv_read_int(&point[2], 2, true);
+      points[jj] = command[0] == ShimCommandPrecisePath ? GPoint(x / 8, y / 8) : GPoint(x, y);
+    }
+    shim_data.stats.path_points += point_count;
+    // draw the command unless it is hidden
+    GColor stroke_color = { .argb = command[2] }, fill_color = { .argb = command[4] };
+    uint8_t stroke_width = command[3];
+    uint16_t open_or_radius = prv_read_int(&command[5], 2, false);
+    if (!(command[1] & 1) && command[0] == ShimCommandCircle) {
+      for (uint16_t jj = 0; jj < point_count; jj++) {
+        double center_x = points[jj].x + offset.x + 0.5, center_y = points[jj].y + offset.y + 0.5;
+        prv_fill_ring(ctx, center_x, center_y, 0, open_or_radius + 0.5, fill_color);
+        if (stroke_width) {
+          prv_fill_ring(ctx, center_x, center_y, open_or_radius - stroke_width / 2.0,
+            open_or_radius + stroke_width / 2.0, stroke_color);
+        }
+      }
+    } else if (!(command[1] & 1)) {
+      if (!open_or_radius) {
+        prv_fill_polygon(ctx, points, point_count, offset, fill_color);
+      }
+      if (stroke_width) {
+        prv_outline(ctx, points, point_count, offset, open_or_radius, stroke_width,
+          stroke_color);
+      }
+    }
+    free(points);
+  }
+}
+
+// Destroy a draw command image
+void gdraw_command_image_destroy(GDrawCommandImage *image) {
+  free(image);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+// Create a graphics context drawing into a framebuffer the size of the display
+GContext *shim_context_create(void) {
+  GContext *ctx = malloc(sizeof(GContext));
+  ctx->pixels = malloc(sizeof(GColor8) * PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT);
+  shim_context_clear(ctx, GColorWhite);
+  return ctx;
+}
+
+// Destroy a graphics context and its framebuffer
+void shim_context_destroy(GContext *ctx) {
+  free(ctx->pixels);
+  free(ctx);
+}
+
+// Fill the framebuffer with a color and reset the drawing state to its defaults
+void shim_context_clear(GContext *ctx, GColor color) {
+  memset(ctx->pixels, color.argb, sizeof(GColor8) * PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT);
+  ctx->stroke_color = GColorBlack;
+  ctx->fill_color = GColorBlack;
+  ctx->text_color = GColorBlack;
+  ctx->stroke_width = 1;
+  ctx->antialiased = true;
+}
+
+// Get the framebuffer of a graphics context
+const GColor8 *shim_context_get_pixels(GContext *ctx) {
+  return ctx->pixels;
+}
+
+// Set the time of the fake clock
+void shim_set_time(time_t now) {
+  shim_data.now_ms = (int64_t)now * 1000;
+}
+
+// Set the battery state returned by the battery state service
+void shim_set_battery(BatteryChargeState battery_state) {
+  shim_data.battery_state = battery_state;
+}
+
+// Set the directory resources are loaded from
+void shim_set_resource_dir(const char *path) {
+  shim_data.resource_dir = path;
+}
+
+// Clear the counters
+void shim_reset_stats(void) {
+  memset(&shim_data.stats, 0, sizeof(ShimStats));
+}
+
+// Get the counters collected since the last reset
+const ShimStats *shim_get_stats(void) {
+  return &shim_data.stats;
+}
@@ -0,0 +1,64 @@
+//! @file render_shim.h
+//! @brief Controls the software framebuffer and fake watch behind the host app SDK
+//!
+//! A GContext draws into an 8 bit color framebuffer with the size of the display. Every
+//! drawing call is counted, along with the pixels it wrote, the points of each path and the
+//! text measured, so a change to a card shows both in its image and in its cost. The clock
+//! stands still unless the code under test sleeps, so renders are the same on every run.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include "pebble.h"
+
+//! Counters collected while rendering
+typedef struct {
+  uint32_t  draw_calls;                 //< Drawing calls, including text and images
+  uint32_t  pixels;                     //< Pixels written, counting overdraw
+  uint32_t  path_points;                //< Points of the paths drawn
+  uint32_t  text_measurements;          //< Calls measuring the size of text
+} ShimStats;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+//! Create a graphics context drawing into a framebuffer the size of the display
+//! @return A pointer to the new GContext
+GContext *shim_context_create(void);
+
+//! Destroy a graphics context and its framebuffer
+//! @param ctx The GContext to destroy
+void shim_context_destroy(GContext *ctx);
+
+//! Fill the framebuffer with a color and reset the drawing state to its defaults
+//! @param ctx The GContext to clear
+//! @param color The color to fill with
+void shim_context_clear(GContext *ctx, GColor color);
+
+//! Get the framebuffer of a graphics context, PBL_DISPLAY_WIDTH pixels per row
+//! @param ctx The GContext to read
+//! @return The pixels, row by row from the top left
+const GColor8 *shim_context_get_pixels(GContext *ctx);
+
+//! Set the time of the fake clock
+//! @param now The new time
+void shim_set_time(time_t now);
+
+//! Set the battery state returned by the battery state service
+//! @param battery_state The new state
+void shim_set_battery(BatteryChargeState battery_state);
+
+//! Set the directory resources are loaded from, the app's resources directory
+//! @param path The path of the directory
+void shim_set_resource_dir(const char *path);
+
+//! Clear the counters
+void shim_reset_stats(void);
+
+//! Get the counters collected since the last reset
+//! @return The counters
+const ShimStats *shim_get_stats(void);
@@ -0,0 +1,680 @@
+// @file compare.c
+// @brief Check the worker's data library against a frozen reference copy of it
+//
+// Usage: compare [-j threads] [--log] [--quota bytes] [-v] [--generate count] [--seed seed]
+//                [--counters <out.csv>] [<trace>... | -]
+//
+// Each trace, recorded dumps and with --generate that many random ones, is fed to both engines
+// in lockstep (see compare_engine.h), each on its own simulated watch. After every event the
+// result of every public data_get_* function and the number of alerts raised are compared. At
+// the first difference the trace is cut after that event and shrunk by removing ever smaller
+// runs of events while it still diverges, and the smallest trace found is printed as CSV on
+// stderr.
+//
+// The storage quota is unlimited unless --quota is given, as under a full quota the worker's
+// retention policy evicts history the reference keeps, by design. The engines may lay out
+// persistent storage differently, so the watch's storage, logging and messaging counters are
+// not compared. With --counters, each engine's counters at the end of
+// every trace are written side by side to a CSV file instead, to review the cost of a change
+// to the storage layer.
+//
+// The time spent in each API by each engine is summed over all traces and printed as CSV on
+// stdout with the speedup of the worker's library over the reference. Exits with 1 if any
+// trace diverged.
+//
+// Build from the repository root:
+//   cc -O2 -pthread -I tools/replay -o compare tools/replay/compare.c
+//     tools/replay/reference/reference_engine.c tools/replay/replay_engine.c
+//     tools/replay/replay_shim.c tools/dump_reader.c worker_src/data_library.c
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include <errno.h>
+#include "compare_engine.h"
+#include "replay_engine.h"
+#include "../dump_reader.h"
+#define PEBBLE_BACKGROUND_WORKER
+#include "../../src/data/data_shared.h"
+#include "../../src/utility.h"
+#undef PEBBLE_BACKGROUND_WORKER
+
+// Constants
+#define COMPARE_ENGINE_COUNT 2          //< Engines run side by side
+#define COMPARE_RUN_TIME_COUNT (CHARGE_CYCLE_MAX_COUNT + 1) //< Cycles read, including current
+#define COMPARE_VALUE_MAX_COUNT 160     //< Most values compared after one event
+#define COMPARE_GENERATE_START 1470000000 //< Earliest start of a generated trace
+#define COMPARE_GENERATE_MAX_COUNT 1024 //< Most events in a generated trace
+#define COMPARE_DEFAULT_QUOTA UINT32_MAX //< Storage quota unless --quota is given, unlimited
+
+// Public functions timed, and the results compared
+typedef enum {
+  CompareApiInitialize,
+  CompareApiProcessNewBatteryState,
+  CompareApiGetChargeByTime,
+  CompareApiGetLifeRemaining,
+  CompareApiGetRecordRunTime,
+  CompareApiGetRunTime,
+  CompareApiGetMaxLife,
+  CompareApiGetPercentPerDay,
+  CompareApiGetBatteryPercent,
+  CompareApiGetAlertCount,
+  CompareApiGetAlertThreshold,
+  CompareApiGetDataPoint,
+  CompareApiGetChargeCycleCount,
+  CompareApiGetDataPointCount,
+  CompareApiTimedCount,
+  CompareApiAlertsRaised = CompareApiTimedCount,
+  CompareApiCount
+} CompareApi;
+
+// Counters of the simulated watch, reported with --counters but not compared
+typedef enum {
+  CompareCounterPersistBytes,
+  CompareCounterPersistBytesPeak,
+  CompareCounterPersistWrites,
+  CompareCounterPersistWriteFailures,
+  CompareCounterLogRecords,
+  CompareCounterWorkerMessages,
+  CompareCounterAppLaunches,
+  CompareCounterCount
+} CompareCounter;
+
+// Names of each CompareApi
+static const char *compare_api_names[CompareApiCount] = {
+  "data_initialize",
+  "data_process_new_battery_state",
+  "data_get_charge_by_time",
+  "data_get_life_remaining",
+  "data_get_record_run_time",
+  "data_get_run_time",
+  "data_get_max_life",
+  "data_get_percent_per_day",
+  "data_get_battery_percent",
+  "data_get_alert_count",
+  "data_get_alert_threshold",
+  "data_get_data_point",
+  "data_get_charge_cycle_count_including_seconds",
+  "data_get_data_point_count_including_seconds",
+  "alerts_raised"
+};
+
+// Names of each CompareCounter
+static const char *compare_counter_names[CompareCounterCount] = {
+  "persist_bytes",
+  "persist_bytes_peak",
+  "persist_writes",
+  "persist_write_failures",
+  "log_records",
+  "worker_messages",
+  "app_launches"
+};
+
+// Seconds back passed to the *_including_seconds functions
+static const int32_t compare_seconds[] = { 0, SEC_IN_HR, SEC_IN_DAY, SEC_IN_WEEK };
+
+// One event of a trace
+typedef struct {
+  time_t              epoch;            //< Time of the event
+  BatteryChargeState  battery_state;    //< New battery state
+  bool                contiguous;       //< Whether the worker stayed running since the last
+} CompareEvent;
+
+// One compared result
+typedef struct {
+  CompareApi  api;                      //< The function or counter it came from
+  int32_t     argument;                 //< The argument it was called with
+  int64_t     value;                    //< The result
+} CompareValue;
+
+// Results of an engine after an event
+typedef struct {
+  CompareValue  values[COMPARE_VALUE_MAX_COUNT]; //< Results in a fixed order
+  uint16_t      count;                  //< Number of results
+} CompareSnapshot;
+
+// First difference between the engines
+typedef struct {
+  size_t        event_index;            //< Index of the event after which they differed
+  CompareValue  values[COMPARE_ENGINE_COUNT]; //< Each engine's result
+} CompareDivergence;
+
+// Time spent in one API by each engine
+typedef struct {
+  uint64_t  call_count;                 //< Calls made to each engine
+  uint64_t  nanoseconds[COMPARE_ENGINE_COUNT]; //< Time spent in each engine
+} CompareTiming;
+
+// One trace and its result
+typedef struct {
+  const char        *path;              //< Path of a recorded trace, NULL if generated
+  unsigned int      seed;               //< Seed of a generated trace
+  int               error;              //< errno if the trace could not be read
+  size_t            event_count;        //< Number of events
+  bool              diverged;           //< Whether the engines differed
+  CompareDivergence divergence;         //< The first difference over the whole trace
+  CompareEvent      *minimized;         //< Smallest trace found which still diverges
+  size_t            minimized_count;    //< Number of events in it
+  CompareDivergence minimized_divergence; //< The first difference over the smallest trace
+  uint32_t          counters[COMPARE_ENGINE_COUNT][CompareCounterCount]; //< Counters at the end
+} CompareTrace;
+
+// Main data struct
+static struct {
+  ReplayCommandLine command_line;       //< Options and recorded traces
+  CompareTrace      *traces;            //< Recorded then generated traces
+  size_t            trace_count;        //< Number of traces
+  CompareTiming     *timings;           //< Timings for each thread and API, API fastest
+  const char        *counters_path;     //< File to write the counters of each trace to, or NULL
+} compare_data;
+
+// Engines, indexed the same as the simulated watches they run on
+static const CompareEngine *compare_engines[COMPARE_ENGINE_COUNT] = {
+  &compare_reference_engine,
+  &compare_optimized_engine
+};
+
+// Engine currently running on this thread, so raised alerts are counted against it
+static _Thread_local uint8_t compare_engine_index;
+
+// Alerts raised by each engine on this thread
+static _Thread_local uint32_t compare_alert_counts[COMPARE_ENGINE_COUNT];
+
+// The worker's data library
+const CompareEngine compare_optimized_engine = {
+  .name = "optimized",
+  .initialize = data_initialize,
+  .terminate = data_terminate,
+  .register_alert_callback = data_register_alert_callback,
+  .process_new_battery_state = data_process_new_battery_state,
+  .get_alert_threshold = data_get_alert_threshold,
+  .get_alert_count = data_get_alert_count,
+  .get_charge_by_time = data_get_charge_by_time,
+  .get_life_remaining = data_get_life_remaining,
+  .get_record_run_time = data_get_record_run_time,
+  .get_run_time = data_get_run_time,
+  .get_max_life = data_get_max_life,
+  .get_percent_per_day = data_get_percent_per_day,
+  .get_battery_percent = data_get_battery_percent,
+  .get_data_point = data_get_data_point,
+  .get_charge_cycle_count_including_seconds = data_get_charge_cycle_count_including_seconds,
+  .get_data_point_count_including_seconds = data_get_data_point_count_including_seconds
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Traces
+//
+
+// Append an event to a growing trace
+static void prv_trace_add(CompareEvent **events, size_t *count, size_t *capacity,
+                          CompareEvent event) {
+  if (*count >= *capacity) {
+    *capacity = *capacity ? *capacity * 2 : 256;
+    *events = realloc(*events, *capacity * sizeof(CompareEvent));
+  }
+  (*events)[(*count)++] = event;
+}
+
+// Load the events of a recorded dump
+static bool prv_trace_load(const char *path, CompareEvent **events, size_t *count) {
+  Dump dump;
+  if (!dump_open(&dump, path)) {
+    return false;
+  }
+  size_t capacity = 0;
+  DumpIterator iter;
+  dump_iterator_init(&iter, &dump);
+  const SaveState *save_state;
+  while ((save_state = compare_data.command_line.options.log ?
+                       dump_iterator_next_log_state(&iter) :
+                       dump_iterator_next_block_state(&iter))) {
+    prv_trace_add(events, count, &capacity, (CompareEvent) {
+      .epoch = dump_get_epoch(save_state),
+      .battery_state = {
+        .charge_percent = dump_get_percent(save_state),
+        .is_charging = save_state->charging,
+        .is_plugged = save_state->plugged
+      },
+      .contiguous = save_state->contiguous
+    });
+  }
+  dump_close(&dump);
+  return true;
+}
+
+// Generate a random trace of discharges, charges, time plugged in full and worker restarts
+static void prv_trace_generate(unsigned int seed, CompareEvent **events, size_t *count) {
+  size_t capacity = 0;
+  size_t event_count = 2 + rand_r(&seed) % (COMPARE_GENERATE_MAX_COUNT - 1);
+  time_t epoch = COMPARE_GENERATE_START + rand_r(&seed) % SEC_IN_WEEK;
+  int32_t sec_per_percent = 60 + rand_r(&seed) % 1200;
+  int percent = 100;
+  bool charging = false, plugged = rand_r(&seed) % 2;
+  for (size_t ii = 0; ii < event_count; ii++) {
+    uint32_t roll = rand_r(&seed) % 100;
+    bool contiguous = roll >= 3;
+    if (charging) {
+      // charge in steps until full, then maybe stay plugged in
+      percent = percent + 10 > 100 ? 100 : percent + 10;
+      epoch += 60 + rand_r(&seed) % 900;
+      if (percent == 100) {
+        charging = false;
+        plugged = roll % 2;
+      }
+    } else if (plugged) {
+      plugged = false;
+      epoch += rand_r(&seed) % (SEC_IN_HR * 8);
+    } else {
+      // discharge, sometimes by more than one step or out of order, until charging again
+      int drop = roll < 5 ? 20 : (roll < 8 ? -10 : 10);
+      percent = percent - drop < 0 ? 0 : (percent - drop > 100 ? 100 : percent - drop);
+      epoch += sec_per_percent * 10 * (50 + rand_r(&seed) % 100) / 100;
+      if (percent <= (int)(rand_r(&seed) % 50)) {
+        charging = plugged = true;
+      }
+      if (roll >= 97) {
+        sec_per_percent = 60 + rand_r(&seed) % 1200;
+      }
+    }
+    if (!contiguous) {
+      epoch += rand_r(&seed) % SEC_IN_DAY;
+    }
+    prv_trace_add(events, count, &capacity, (CompareEvent) {
+      .epoch = epoch,
+      .battery_state = {
+        .charge_percent = percent,
+        .is_charging = charging,
+        .is_plugged = plugged
+      },
+      .contiguous = contiguous
+    });
+  }
+}
+
+// Print a trace as CSV in the columns of decode_dump
+static void prv_trace_print(const CompareEvent *events, size_t count) {
+  fprintf(stderr, "epoch,percent,charging,plugged,contiguous\n");
+  for (size_t ii = 0; ii < count; ii++) {
+    fprintf(stderr, "%ld,%d,%d,%d,%d\n", (long)events[ii].epoch,
+      events[ii].battery_state.charge_percent, events[ii].battery_state.is_charging,
+      events[ii].battery_state.is_plugged, events[ii].contiguous);
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Engines
+//
+
+// Battery alert raised callback
+static void prv_alert_handler(uint8_t alert_index) {
+  compare_alert_counts[compare_engine_index]++;
+}
+
+// Get a monotonic time in nanoseconds
+static uint64_t prv_get_nanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Add the time since a start time to an API's timing
+static void prv_timing_add(CompareTiming *timings, CompareApi api, uint64_t start) {
+  if (timings) {
+    timings[api].nanoseconds[compare_engine_index] += prv_get_nanoseconds() - start;
+    if (!compare_engine_index) {
+      timings[api].call_count++;
+    }
+  }
+}
+
+// Add a result to a snapshot
+static void prv_snapshot_add(CompareSnapshot *snapshot, CompareApi api, int32_t argument,
+                             int64_t value) {
+  if (snapshot->count < COMPARE_VALUE_MAX_COUNT) {
+    snapshot->values[snapshot->count++] = (CompareValue) {
+      .api = api,
+      .argument = argument,
+      .value = value
+    };
+  }
+}
+
+// Call every public data_get_* function of the current engine and count its alerts
+static void prv_snapshot_take(const CompareEngine *engine, DataLibrary *data_library,
+                              CompareSnapshot *snapshot, CompareTiming *timings) {
+  snapshot->count = 0;
+  uint64_t start;
+  // the results of simple getters
+#define COMPARE_TIME(api, argument, call) \
+  start = prv_get_nanoseconds(); \
+  prv_snapshot_add(snapshot, api, argument, call); \
+  prv_timing_add(timings, api, start)
+  COMPARE_TIME(CompareApiGetChargeByTime, 0, engine->get_charge_by_time(data_library));
+  COMPARE_TIME(CompareApiGetLifeRemaining, 0, engine->get_life_remaining(data_library));
+  COMPARE_TIME(CompareApiGetRecordRunTime, 0, engine->get_record_run_time(data_library));
+  for (uint16_t ii = 0; ii < COMPARE_RUN_TIME_COUNT; ii++) {
+    COMPARE_TIME(CompareApiGetRunTime, ii, engine->get_run_time(data_library, ii));
+    COMPARE_TIME(CompareApiGetMaxLife, ii, engine->get_max_life(data_library, ii));
+  }
+  // both of these divide by the current charge rate, which can be 0 in an unusual trace
+  if (engine->get_max_life(data_library, 0) * 100 / SEC_IN_DAY) {
+    COMPARE_TIME(CompareApiGetPercentPerDay, 0, engine->get_percent_per_day(data_library));
+    COMPARE_TIME(CompareApiGetBatteryPercent, 0, engine->get_battery_percent(data_library));
+  }
+  COMPARE_TIME(CompareApiGetAlertCount, 0, engine->get_alert_count(data_library));
+  for (uint8_t ii = 0; ii < DATA_ALERT_MAX_COUNT; ii++) {
+    COMPARE_TIME(CompareApiGetAlertThreshold, ii, engine->get_alert_threshold(data_library, ii));
+  }
+  for (uint8_t ii = 0; ii < ARRAY_LENGTH(compare_seconds); ii++) {
+    COMPARE_TIME(CompareApiGetChargeCycleCount, compare_seconds[ii],
+      engine->get_charge_cycle_count_including_seconds(data_library, compare_seconds[ii]));
+    COMPARE_TIME(CompareApiGetDataPointCount, compare_seconds[ii],
+      engine->get_data_point_count_including_seconds(data_library, compare_seconds[ii]));
+  }
+#undef COMPARE_TIME
+  // the data points, left unset past the last one
+  for (uint16_t ii = 0; ii < DATA_POINT_MAX_COUNT; ii++) {
+    int32_t epoch = -1;
+    uint8_t percent = 0;
+    start = prv_get_nanoseconds();
+    engine->get_data_point(data_library, ii, &epoch, &percent);
+    prv_timing_add(timings, CompareApiGetDataPoint, start);
+    prv_snapshot_add(snapshot, CompareApiGetDataPoint, ii, (int64_t)epoch * 256 + percent);
+  }
+  prv_snapshot_add(snapshot, CompareApiAlertsRaised, 0,
+    compare_alert_counts[compare_engine_index]);
+}
+
+// Read the counters of the current engine's simulated watch
+static void prv_counters_read(uint32_t *counters) {
+  const ShimStats *stats = shim_get_stats();
+  counters[CompareCounterPersistBytes] = stats->persist_bytes;
+  counters[CompareCounterPersistBytesPeak] = stats->persist_bytes_peak;
+  counters[CompareCounterPersistWrites] = stats->persist_writes;
+  counters[CompareCounterPersistWriteFailures] = stats->persist_write_failures;
+  counters[CompareCounterLogRecords] = stats->log_records;
+  counters[CompareCounterWorkerMessages] = stats->worker_messages;
+  counters[CompareCounterAppLaunches] = stats->app_launches;
+}
+
+// Select an engine and the simulated watch it runs on
+static void prv_engine_select(uint8_t index) {
+  compare_engine_index = index;
+  shim_select_watch(index);
+}
+
+// Feed one event to the current engine, restarting it where the worker was stopped
+static DataLibrary *prv_engine_process(DataLibrary *data_library, const CompareEvent *event,
+                                       CompareTiming *timings) {
+  const CompareEngine *engine = compare_engines[compare_engine_index];
+  shim_advance(event->epoch);
+  shim_set_battery(event->battery_state);
+  if (!data_library || !event->contiguous) {
+    if (data_library) {
+      engine->terminate(data_library);
+      shim_cancel_timers();
+    }
+    uint64_t start = prv_get_nanoseconds();
+    data_library = engine->initialize();
+    prv_timing_add(timings, CompareApiInitialize, start);
+    engine->register_alert_callback(data_library, prv_alert_handler);
+  }
+  uint64_t start = prv_get_nanoseconds();
+  engine->process_new_battery_state(data_library, event->battery_state);
+  prv_timing_add(timings, CompareApiProcessNewBatteryState, start);
+  return data_library;
+}
+
+// Run a trace through both engines in lockstep, stopping at the first difference
+// Returns true if the engines differed, filling in where, and the counters if not NULL
+static bool prv_engines_run(const CompareEvent *events, size_t count,
+                            CompareDivergence *divergence, CompareTiming *timings,
+                            uint32_t (*counters)[CompareCounterCount]) {
+  DataLibrary *data_libraries[COMPARE_ENGINE_COUNT] = { NULL };
+  CompareSnapshot snapshots[COMPARE_ENGINE_COUNT];
+  for (uint8_t ii = 0; ii < COMPARE_ENGINE_COUNT; ii++) {
+    prv_engine_select(ii);
+    shim_reset(compare_data.command_line.options.quota,
+      compare_data.command_line.options.verbose);
+    compare_alert_counts[ii] = 0;
+  }
+  bool diverged = false;
+  for (size_t ii = 0; !diverged && ii < count; ii++) {
+    for (uint8_t jj = 0; jj < COMPARE_ENGINE_COUNT; jj++) {
+      prv_engine_select(jj);
+      data_libraries[jj] = prv_engine_process(data_libraries[jj], &events[ii], timings);
+      prv_snapshot_take(compare_engines[jj], data_libraries[jj], &snapshots[jj], timings);
+    }
+    // the snapshots are taken in the same order, so differ first where a value does
+    uint16_t value_count = snapshots[0].count > snapshots[1].count ? snapshots[0].count :
+      snapshots[1].count;
+    for (uint16_t jj = 0; !diverged && jj < value_count; jj++) {
+      CompareValue *reference = &snapshots[0].values[jj];
+      CompareValue *optimized = &snapshots[1].values[jj];
+      if (jj >= snapshots[0].count || jj >= snapshots[1].count ||
+          reference->api != optimized->api || reference->argument != optimized->argument ||
+          reference->value != optimized->value) {
+        diverged = true;
+        *divergence = (CompareDivergence) {
+          .event_index = ii,
+          .values = { *reference, *optimized }
+        };
+      }
+    }
+  }
+  for (uint8_t ii = 0; ii < COMPARE_ENGINE_COUNT; ii++) {
+    prv_engine_select(ii);
+    if (counters) {
+      prv_counters_read(counters[ii]);
+    }
+    if (data_libraries[ii]) {
+      compare_engines[ii]->terminate(data_libraries[ii]);
+    }
+  }
+  return diverged;
+}
+
+// Shrink a diverging trace by removing ever smaller runs of events while it still diverges
+static void prv_trace_minimize(CompareTrace *trace, const CompareEvent *events) {
+  size_t count = trace->divergence.event_index + 1;
+  CompareEvent *minimized = malloc(count * sizeof(CompareEvent));
+  CompareEvent *candidate = malloc(count * sizeof(CompareEvent));
+  memcpy(minimized, events, count * sizeof(CompareEvent));
+  CompareDivergence divergence = trace->divergence;
+  for (size_t chunk = count / 2; chunk >= 1;) {
+    bool removed = false;
+    for (size_t start = 0; start < count;) {
+      // try the trace without this run, keeping it cut after the first difference
+      size_t end = start + chunk < count ? start + chunk : count;
+      memcpy(candidate, minimized, start * sizeof(CompareEvent));
+      memcpy(&candidate[start], &minimized[end], (count - end) * sizeof(CompareEvent));
+      CompareDivergence candidate_divergence;
+      if (count - (end - start) &&
+          prv_engines_run(candidate, count - (end - start), &candidate_divergence, NULL,
+            NULL)) {
+        count = candidate_divergence.event_index + 1;
+        memcpy(minimized, candidate, count * sizeof(CompareEvent));
+        divergence = candidate_divergence;
+        removed = true;
+      } else {
+        start += chunk;
+      }
+    }
+    if (!removed) {
+      chunk /= 2;
+    } else if (chunk > count / 2) {
+      chunk = count / 2;
+    }
+  }
+  free(candidate);
+  trace->minimized = minimized;
+  trace->minimized_count = count;
+  trace->minimized_divergence = divergence;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Command Line
+//
+
+// Compare one trace on a pool thread
+static void prv_compare_task(size_t task_index, size_t thread_index, void *context) {
+  CompareTrace *trace = &compare_data.traces[task_index];
+  CompareEvent *events = NULL;
+  if (!trace->path) {
+    prv_trace_generate(trace->seed, &events, &trace->event_count);
+  } else if (!prv_trace_load(trace->path, &events, &trace->event_count)) {
+    trace->error = errno;
+    return;
+  }
+  CompareTiming *timings = &compare_data.timings[thread_index * CompareApiTimedCount];
+  trace->diverged = prv_engines_run(events, trace->event_count, &trace->divergence, timings,
+    trace->counters);
+  if (trace->diverged) {
+    prv_trace_minimize(trace, events);
+  }
+  free(events);
+}
+
+// Print where the engines differed
+static void prv_print_divergence(const CompareDivergence *divergence) {
+  const CompareValue *reference = &divergence->values[0];
+  const CompareValue *optimized = &divergence->values[1];
+  fprintf(stderr, "after event %zu, %s(%d) reference %lld, %s(%d) optimized %lld\n",
+    divergence->event_index, compare_api_names[reference->api], reference->argument,
+    (long long)reference->value, compare_api_names[optimized->api], optimized->argument,
+    (long long)optimized->value);
+}
+
+// Get the name of a trace, its path or its seed if generated
+static const char *prv_trace_name(const CompareTrace *trace, char *buff, size_t size) {
+  snprintf(buff, size, "generated seed %u", trace->seed);
+  return trace->path ? trace->path : buff;
+}
+
+// Write each engine's watch counters at the end of every trace as CSV
+// A diverged trace was cut after the first difference, so its counters stop there
+static bool prv_write_counters(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "trace,diverged,counter,reference,optimized,difference\n");
+  for (size_t ii = 0; ii < compare_data.trace_count; ii++) {
+    CompareTrace *trace = &compare_data.traces[ii];
+    char name[32];
+    const char *trace_name = prv_trace_name(trace, name, sizeof(name));
+    for (uint8_t jj = 0; !trace->error && jj < CompareCounterCount; jj++) {
+      fprintf(file, "%s,%d,%s,%u,%u,%lld\n", trace_name, trace->diverged,
+        compare_counter_names[jj], trace->counters[0][jj], trace->counters[1][jj],
+        (long long)trace->counters[1][jj] - trace->counters[0][jj]);
+    }
+  }
+  return fclose(file) == 0;
+}
+
+// Print each divergence and the timings of each API
+static void prv_print_results(void) {
+  size_t diverged_count = 0, event_count = 0;
+  for (size_t ii = 0; ii < compare_data.trace_count; ii++) {
+    CompareTrace *trace = &compare_data.traces[ii];
+    char name[32];
+    const char *trace_name = prv_trace_name(trace, name, sizeof(name));
+    if (trace->error) {
+      fprintf(stderr, "Could not read %s: %s\n", trace_name, strerror(trace->error));
+      continue;
+    }
+    event_count += trace->event_count;
+    if (!trace->diverged) {
+      continue;
+    }
+    diverged_count++;
+    fprintf(stderr, "%s diverged ", trace_name);
+    prv_print_divergence(&trace->divergence);
+    fprintf(stderr, "Minimized to %zu events, diverging ", trace->minimized_count);
+    prv_print_divergence(&trace->minimized_divergence);
+    prv_trace_print(trace->minimized, trace->minimized_count);
+  }
+  // merge each thread's timings into the first thread's
+  CompareTiming *timings = compare_data.timings;
+  for (size_t ii = 1; ii < compare_data.command_line.thread_count; ii++) {
+    for (uint8_t jj = 0; jj < CompareApiTimedCount; jj++) {
+      CompareTiming *timing = &compare_data.timings[ii * CompareApiTimedCount + jj];
+      timings[jj].call_count += timing->call_count;
+      for (uint8_t kk = 0; kk < COMPARE_ENGINE_COUNT; kk++) {
+        timings[jj].nanoseconds[kk] += timing->nanoseconds[kk];
+      }
+    }
+  }
+  printf("api,calls,reference_ns_per_call,optimized_ns_per_call,speedup\n");
+  for (uint8_t ii = 0; ii < CompareApiTimedCount; ii++) {
+    if (!timings[ii].call_count) {
+      continue;
+    }
+    printf("%s,%llu,%.1f,%.1f,%.2f\n", compare_api_names[ii],
+      (unsigned long long)timings[ii].call_count,
+      (double)timings[ii].nanoseconds[0] / timings[ii].call_count,
+      (double)timings[ii].nanoseconds[1] / timings[ii].call_count,
+      timings[ii].nanoseconds[1] ?
+        (double)timings[ii].nanoseconds[0] / timings[ii].nanoseconds[1] : 0);
+  }
+  fprintf(stderr, "Compared %zu traces, %zu events, %zu diverged\n", compare_data.trace_count,
+    event_count, diverged_count);
+}
+
+// Entry point
+int main(int argc, char **argv) {
+  ReplayCommandLine *command_line = &compare_data.command_line;
+  replay_command_line_init(command_line);
+  command_line->options.quota = COMPARE_DEFAULT_QUOTA;
+  size_t generate_count = 0;
+  unsigned int seed = 1;
+  bool valid = true;
+  for (int ii = 1; valid && ii < argc;) {
+    if (strcmp(argv[ii], "--generate") == 0 && ii + 1 < argc) {
+      generate_count = atol(argv[ii + 1]);
+      ii += 2;
+    } else if (strcmp(argv[ii], "--seed") == 0 && ii + 1 < argc) {
+      seed = atol(argv[ii + 1]);
+      ii += 2;
+    } else if (strcmp(argv[ii], "--counters") == 0 && ii + 1 < argc) {
+      compare_data.counters_path = argv[ii + 1];
+      ii += 2;
+    } else {
+      int consumed = replay_command_line_parse(command_line, argc, argv, ii);
+      valid = consumed > 0;
+      ii += consumed;
+    }
+  }
+  compare_data.trace_count = command_line->path_count + generate_count;
+  if (!valid || !compare_data.trace_count) {
+    fprintf(stderr, "Usage: %s [-j threads] [--log] [--quota bytes] [-v] [--generate count] "
+      "[--seed seed] [--counters <out.csv>] [<trace>... | -]\n", argv[0]);
+    return 1;
+  }
+  compare_data.traces = calloc(compare_data.trace_count, sizeof(CompareTrace));
+  for (size_t ii = 0; ii < compare_data.trace_count; ii++) {
+    if (ii < command_line->path_count) {
+      compare_data.traces[ii].path = command_line->paths[ii];
+    } else {
+      compare_data.traces[ii].seed = seed + (ii - command_line->path_count);
+    }
+  }
+  compare_data.timings = calloc(command_line->thread_count * CompareApiTimedCount,
+    sizeof(CompareTiming));
+  replay_pool_run(compare_data.trace_count, command_line->thread_count, prv_compare_task, NULL);
+  prv_print_results();
+  if (compare_data.counters_path && !prv_write_counters(compare_data.counters_path)) {
+    fprintf(stderr, "Could not write %s: %s\n", compare_data.counters_path, strerror(errno));
+    return 1;
+  }
+  for (size_t ii = 0; ii < compare_data.trace_count; ii++) {
+    if (compare_data.traces[ii].diverged) {
+      return 1;
+    }
+  }
+  return 0;
+}
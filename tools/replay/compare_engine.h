@@ -0,0 +1,40 @@
+//! @file compare_engine.h
+//! @brief Entry points of the builds of the data library the compare tool runs side by side
+//!
+//! The worker's data_library.c is the optimized engine. A frozen copy of it in reference/ is
+//! built with its functions renamed, so both link into one binary. Each engine is reached
+//! through a table of its entry points, so the tool calls and times them the same way.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include "../../worker_src/data_library.h"
+
+//! Entry points of one build of the data library
+typedef struct {
+  const char  *name;                    //< Name used in reports
+  DataLibrary *(*initialize)(void);
+  void        (*terminate)(DataLibrary*);
+  void        (*register_alert_callback)(DataLibrary*, BatteryAlertCallback);
+  void        (*process_new_battery_state)(DataLibrary*, BatteryChargeState);
+  int32_t     (*get_alert_threshold)(DataLibrary*, uint8_t);
+  uint8_t     (*get_alert_count)(DataLibrary*);
+  int32_t     (*get_charge_by_time)(DataLibrary*);
+  int32_t     (*get_life_remaining)(DataLibrary*);
+  int32_t     (*get_record_run_time)(DataLibrary*);
+  int32_t     (*get_run_time)(DataLibrary*, uint16_t);
+  int32_t     (*get_max_life)(DataLibrary*, uint16_t);
+  int32_t     (*get_percent_per_day)(DataLibrary*);
+  uint8_t     (*get_battery_percent)(DataLibrary*);
+  void        (*get_data_point)(DataLibrary*, uint16_t, int32_t*, uint8_t*);
+  uint16_t    (*get_charge_cycle_count_including_seconds)(DataLibrary*, int32_t);
+  uint16_t    (*get_data_point_count_including_seconds)(DataLibrary*, int32_t);
+} CompareEngine;
+
+//! The worker's data library
+extern const CompareEngine compare_optimized_engine;
+
+//! The frozen reference copy of the data library
+extern const CompareEngine compare_reference_engine;
@@ -0,0 +1,111 @@
+//! @file pebble_worker.h
+//! @brief Host stand-in for the Pebble worker SDK header
+//!
+//! Declares the subset of the worker SDK used by data_library.c so it can be built on a host
+//! for the replay tool. Every function is backed by per-thread state in replay_shim.c, so each
+//! replay thread has its own clock, battery, timers and persistent storage.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "replay_tuning.h"
+
+// Constants
+#define PERSIST_DATA_MAX_LENGTH 256     //< Largest value stored under one key
+#define E_DOES_NOT_EXIST (-4)           //< Status when reading a key which does not exist
+#define E_OUT_OF_STORAGE (-7)           //< Status when a write would exceed the storage quota
+
+//! Number of elements in an array
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+//! Log levels
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200
+} AppLogLevel;
+
+//! Watch models
+typedef enum {
+  WATCH_INFO_MODEL_UNKNOWN,
+  WATCH_INFO_MODEL_PEBBLE_TIME_STEEL,
+  WATCH_INFO_MODEL_PEBBLE_TIME_ROUND_14,
+  WATCH_INFO_MODEL_PEBBLE_TIME_ROUND_20
+} WatchInfoModel;
+
+//! Data logging types
+typedef enum {
+  DATA_LOGGING_BYTE_ARRAY,
+  DATA_LOGGING_UINT,
+  DATA_LOGGING_INT
+} DataLoggingItemType;
+
+//! Data logging results
+typedef enum {
+  DATA_LOGGING_SUCCESS,
+  DATA_LOGGING_BUSY,
+  DATA_LOGGING_FULL
+} DataLoggingResult;
+
+//! Battery state
+typedef struct {
+  uint8_t charge_percent;               //< Battery charge percent
+  bool    is_charging;                  //< Whether the battery is charging
+  bool    is_plugged;                   //< Whether the watch is plugged in
+} BatteryChargeState;
+
+//! Message between the app and worker
+typedef struct {
+  uint16_t data0;                       //< First value
+  uint16_t data1;                       //< Second value
+  uint16_t data2;                       //< Third value
+} AppWorkerMessage;
+
+//! Opaque handles
+typedef struct AppTimer AppTimer;
+typedef void *DataLoggingSessionRef;
+typedef void (*AppTimerCallback)(void *data);
+
+//! Logging, silent unless the replay is verbose
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+void app_log(uint8_t level, const char *file, int line, const char *fmt, ...);
+
+//! The simulated clock replaces the system clock for the library
+#define time(tloc) replay_time(tloc)
+time_t replay_time(time_t *tloc);
+uint16_t time_ms(time_t *tloc, uint16_t *ms);
+void psleep(int millis);
+
+//! Persistent storage
+bool persist_exists(uint32_t key);
+int persist_get_size(uint32_t key);
+int32_t persist_read_int(uint32_t key);
+bool persist_read_bool(uint32_t key);
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size);
+int persist_write_int(uint32_t key, int32_t value);
+int persist_write_bool(uint32_t key, bool value);
+int persist_write_data(uint32_t key, const void *data, size_t size);
+int persist_delete(uint32_t key);
+
+//! Services
+BatteryChargeState battery_state_service_peek(void);
+WatchInfoModel watch_info_get_model(void);
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *data);
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer);
+DataLoggingSessionRef data_logging_create(uint32_t tag, DataLoggingItemType item_type,
+                                          uint16_t item_length, bool resume);
+DataLoggingResult data_logging_log(DataLoggingSessionRef session, const void *data,
+                                   uint32_t num_items);
+int app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+int worker_launch_app(void);
@@ -0,0 +1,69 @@
+// @file reference_engine.c
+// @brief Builds the frozen copy of the data library as the compare tool's reference engine
+//
+// data_library.c and data_library.h in this directory are the worker's library as it was when
+// the compare tool was added, with only the include paths changed and the marked REFERENCE
+// PATCH blocks added. Do not edit them otherwise; any change to the worker's algorithms or
+// storage layer is checked against them. The public functions are renamed here so they link
+// beside the worker's own.
+//
+// Known differences, which are intended:
+// - Retention (user-073): under a small storage quota the worker evicts old history ahead of
+//   time and retries a failed write once, where the reference loses the write. The compare
+//   tool's quota is unlimited unless --quota is given, and traces only diverge for it under one.
+// - Circular block keys (user-074): only the storage layout changes, so there is no
+//   difference in any data_get_* result. The cost shows in the --counters report.
+// - Block recovery (user-075): the newest data point is read correctly right after a block
+//   fills, where the original returned no point. The fix is carried as a REFERENCE PATCH, so
+//   traces do not diverge for it.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#define data_get_alert_threshold reference_data_get_alert_threshold
+#define data_get_alert_count reference_data_get_alert_count
+#define data_refresh_all_alerts reference_data_refresh_all_alerts
+#define data_schedule_alert reference_data_schedule_alert
+#define data_unschedule_alert reference_data_unschedule_alert
+#define data_register_alert_callback reference_data_register_alert_callback
+#define data_get_charge_by_time reference_data_get_charge_by_time
+#define data_get_life_remaining reference_data_get_life_remaining
+#define data_get_record_run_time reference_data_get_record_run_time
+#define data_get_run_time reference_data_get_run_time
+#define data_get_max_life reference_data_get_max_life
+#define data_get_percent_per_day reference_data_get_percent_per_day
+#define data_get_battery_percent reference_data_get_battery_percent
+#define data_get_data_point reference_data_get_data_point
+#define data_get_charge_cycle_count_including_seconds \
+  reference_data_get_charge_cycle_count_including_seconds
+#define data_get_data_point_count_including_seconds \
+  reference_data_get_data_point_count_including_seconds
+#define data_process_new_battery_state reference_data_process_new_battery_state
+#define data_write_to_foreground reference_data_write_to_foreground
+#define data_initialize reference_data_initialize
+#define data_terminate reference_data_terminate
+
+#include "data_library.c"
+#include "../compare_engine.h"
+
+// The frozen reference copy of the data library
+const CompareEngine compare_reference_engine = {
+  .name = "reference",
+  .initialize = data_initialize,
+  .terminate = data_terminate,
+  .register_alert_callback = data_register_alert_callback,
+  .process_new_battery_state = data_process_new_battery_state,
+  .get_alert_threshold = data_get_alert_threshold,
+  .get_alert_count = data_get_alert_count,
+  .get_charge_by_time = data_get_charge_by_time,
+  .get_life_remaining = data_get_life_remaining,
+  .get_record_run_time = data_get_record_run_time,
+  .get_run_time = data_get_run_time,
+  .get_max_life = data_get_max_life,
+  .get_percent_per_day = data_get_percent_per_day,
+  .get_battery_percent = data_get_battery_percent,
+  .get_data_point = data_get_data_point,
+  .get_charge_cycle_count_including_seconds = data_get_charge_cycle_count_including_seconds,
+  .get_data_point_count_including_seconds = data_get_data_point_count_including_seconds
+};
@@ -0,0 +1,102 @@
+// @file replay.c
+// @brief Replay battery histories of many devices through the worker's data library
+//
+// Usage: replay [-j threads] [--log] [--quota bytes] [-v] <trace>... (or - to read paths)
+//
+// Each device is replayed and scored as described in replay_engine.h. Devices are spread over
+// a work stealing pool, each thread with its own simulated watch, and one CSV row per device
+// is printed in input order. A trace which cannot be read is reported on stderr and left out
+// of the CSV and the summary. Exits with 1 if any trace could not be read.
+//
+// Build from the repository root:
+//   cc -O2 -pthread -I tools/replay -o replay tools/replay/replay.c
+//     tools/replay/replay_engine.c tools/replay/replay_shim.c tools/dump_reader.c
+//     worker_src/data_library.c
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "replay_engine.h"
+#define PEBBLE_BACKGROUND_WORKER
+#include "../../src/utility.h"
+#undef PEBBLE_BACKGROUND_WORKER
+
+// Main data struct
+static struct {
+  ReplayCommandLine command_line;       //< Options and traces
+  ReplayDevice      *devices;           //< Results for each trace
+} replay_data;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Replay one device on a pool thread
+static void prv_replay_task(size_t task_index, size_t thread_index, void *context) {
+  replay_device(&replay_data.devices[task_index], &replay_data.command_line.options);
+}
+
+// Print the results for each device and a summary, returning the number of devices which
+// could not be replayed
+static size_t prv_print_results(void) {
+  printf("trace,points,skipped,restarts,predictions,mean_abs_error_hr,cycles,cycles_matched,"
+    "persist_bytes_peak,persist_writes,persist_write_failures,alerts,log_records,app_launches,"
+    "worker_messages\n");
+  uint64_t point_count = 0, prediction_count = 0, cycle_count = 0, cycle_match_count = 0;
+  size_t device_count = 0, failed_count = 0;
+  double error_sum = 0;
+  for (size_t ii = 0; ii < replay_data.command_line.path_count; ii++) {
+    ReplayDevice *device = &replay_data.devices[ii];
+    if (device->error) {
+      fprintf(stderr, "Could not read %s: %s\n", device->path, strerror(device->error));
+      failed_count++;
+      continue;
+    }
+    double error = device->prediction_count ?
+      device->error_sum / device->prediction_count / SEC_IN_HR : 0;
+    printf("%s,%u,%u,%u,%u,%.2f,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", device->path,
+      device->point_count, device->skipped_count, device->restart_count,
+      device->prediction_count, error, device->cycle_count, device->cycle_match_count,
+      device->stats.persist_bytes_peak, device->stats.persist_writes,
+      device->stats.persist_write_failures, device->alert_count, device->stats.log_records,
+      device->stats.app_launches, device->stats.worker_messages);
+    device_count++;
+    point_count += device->point_count;
+    prediction_count += device->prediction_count;
+    error_sum += device->error_sum;
+    cycle_count += device->cycle_count;
+    cycle_match_count += device->cycle_match_count;
+  }
+  fprintf(stderr, "Replayed %zu devices, %llu points, mean absolute error %.2f hr, "
+    "%llu of %llu cycles matched, %zu failed\n", device_count, (unsigned long long)point_count,
+    prediction_count ? error_sum / prediction_count / SEC_IN_HR : 0,
+    (unsigned long long)cycle_match_count, (unsigned long long)cycle_count, failed_count);
+  return failed_count;
+}
+
+// Entry point
+int main(int argc, char **argv) {
+  ReplayCommandLine *command_line = &replay_data.command_line;
+  replay_command_line_init(command_line);
+  for (int ii = 1; ii < argc;) {
+    int consumed = replay_command_line_parse(command_line, argc, argv, ii);
+    if (!consumed) {
+      command_line->path_count = 0;
+      break;
+    }
+    ii += consumed;
+  }
+  if (!command_line->path_count) {
+    fprintf(stderr, "Usage: %s [-j threads] [--log] [--quota bytes] [-v] <trace>... | -\n",
+      argv[0]);
+    return 1;
+  }
+  replay_data.devices = calloc(command_line->path_count, sizeof(ReplayDevice));
+  for (size_t ii = 0; ii < command_line->path_count; ii++) {
+    replay_data.devices[ii].path = command_line->paths[ii];
+  }
+  replay_pool_run(command_line->path_count, command_line->thread_count, prv_replay_task, NULL);
+  return prv_print_results() ? 1 : 0;
+}
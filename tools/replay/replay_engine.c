@@ -0,0 +1,319 @@
+// @file replay_engine.c
+// @brief Replays device traces through the worker's data library
+//
+// The work stealing pool deals tasks round robin into one queue per thread. A thread pops
+// from the back of its own queue and, once empty, steals from the front of the others. No
+// tasks are added once the pool starts, so a thread finding every queue empty is done.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "replay_engine.h"
+#include "../dump_reader.h"
+#include "../../worker_src/data_library.h"
+#define PEBBLE_BACKGROUND_WORKER
+#include "../../src/data/data_shared.h"
+#undef PEBBLE_BACKGROUND_WORKER
+
+// Constants
+#define REPLAY_RUN_MAX_COUNT 256        //< Most predictions kept for one discharge
+
+// Prediction made at a discharging data point
+typedef struct {
+  time_t      epoch;                    //< Time of the data point
+  int         percent;                  //< Battery percent of the data point
+  int32_t     charge_by;                //< Predicted charge by time
+} ReplayPrediction;
+
+// Work queue owned by one thread
+typedef struct {
+  pthread_mutex_t lock;                 //< Guards head and tail
+  size_t          *items;               //< Task indices
+  size_t          head;                 //< Next index to steal
+  size_t          tail;                 //< One past the next index to pop
+} ReplayQueue;
+
+// Work stealing pool
+typedef struct {
+  ReplayQueue       *queues;            //< One work queue per thread
+  size_t            thread_count;       //< Number of threads
+  ReplayTaskHandler handler;            //< Called for each task
+  void              *context;           //< Passed to the handler
+} ReplayPool;
+
+// Thread start context
+typedef struct {
+  ReplayPool  *pool;                    //< The pool the thread belongs to
+  size_t      thread_index;             //< Index of the thread's own queue
+} ReplayThread;
+
+// Alerts raised on this thread's simulated watch
+static _Thread_local uint32_t replay_alert_count;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Replay
+//
+
+// Battery alert raised callback
+static void prv_alert_handler(uint8_t alert_index) {
+  replay_alert_count++;
+}
+
+// Score the predictions of a discharge against when it reached its last level
+static void prv_score_run(ReplayDevice *device, ReplayPrediction *run, uint16_t run_count) {
+  if (run_count < 2) {
+    return;
+  }
+  ReplayPrediction *end = &run[run_count - 1];
+  for (uint16_t ii = 0; ii < run_count - 1; ii++) {
+    if (run[ii].percent <= end->percent) {
+      continue;
+    }
+    double predicted = run[ii].epoch + (double)(run[ii].charge_by - run[ii].epoch) *
+      (run[ii].percent - end->percent) / (run[ii].percent + BATTERY_PERCENTAGE_OFFSET);
+    double error = predicted - end->epoch;
+    device->error_sum += error < 0 ? -error : error;
+    device->prediction_count++;
+  }
+}
+
+// Score the run time the library reports for the discharge which just ended in a charge
+static void prv_score_cycle(ReplayDevice *device, DataLibrary *data_library, time_t run_time) {
+  int32_t detected = data_get_run_time(data_library, 1);
+  int32_t error = detected > run_time ? detected - run_time : run_time - detected;
+  device->cycle_count++;
+  if (detected > 0 && error * 100 <= run_time * REPLAY_CYCLE_TOLERANCE) {
+    device->cycle_match_count++;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Command Line
+//
+
+// Add a trace to the command line
+static void prv_add_path(ReplayCommandLine *command_line, const char *path) {
+  if (command_line->path_count >= command_line->path_capacity) {
+    command_line->path_capacity = command_line->path_capacity ? command_line->path_capacity * 2 :
+      64;
+    command_line->paths = realloc(command_line->paths,
+      command_line->path_capacity * sizeof(const char*));
+  }
+  command_line->paths[command_line->path_count++] = path;
+}
+
+// Add the traces listed one per line on standard input
+static void prv_add_paths_from_stdin(ReplayCommandLine *command_line) {
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t length;
+  while ((length = getline(&line, &size, stdin)) > 0) {
+    if (line[length - 1] == '\n') {
+      line[--length] = '\0';
+    }
+    if (length) {
+      prv_add_path(command_line, strdup(line));
+    }
+  }
+  free(line);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Work Stealing Pool
+//
+
+// Pop a task from the end of a thread's own queue
+static bool prv_queue_pop(ReplayQueue *queue, size_t *index) {
+  pthread_mutex_lock(&queue->lock);
+  bool found = queue->head < queue->tail;
+  if (found) {
+    *index = queue->items[--queue->tail];
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return found;
+}
+
+// Steal a task from the front of another thread's queue
+static bool prv_queue_steal(ReplayQueue *queue, size_t *index) {
+  pthread_mutex_lock(&queue->lock);
+  bool found = queue->head < queue->tail;
+  if (found) {
+    *index = queue->items[queue->head++];
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return found;
+}
+
+// Pool thread, runs until every queue is empty
+static void *prv_thread_main(void *context) {
+  ReplayThread *thread = context;
+  ReplayPool *pool = thread->pool;
+  size_t index;
+  while (true) {
+    bool found = prv_queue_pop(&pool->queues[thread->thread_index], &index);
+    for (size_t ii = 1; !found && ii < pool->thread_count; ii++) {
+      size_t victim = (thread->thread_index + ii) % pool->thread_count;
+      found = prv_queue_steal(&pool->queues[victim], &index);
+    }
+    if (!found) {
+      return NULL;
+    }
+    pool->handler(index, thread->thread_index, pool->context);
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Implementation
+//
+
+// Set the command line defaults
+void replay_command_line_init(ReplayCommandLine *command_line) {
+  long core_count = sysconf(_SC_NPROCESSORS_ONLN);
+  *command_line = (ReplayCommandLine) {
+    .options.quota = SHIM_PERSIST_QUOTA,
+    .thread_count = core_count > 0 ? core_count : 1
+  };
+}
+
+// Parse one of the shared arguments
+int replay_command_line_parse(ReplayCommandLine *command_line, int argc, char **argv, int index) {
+  const char *arg = argv[index];
+  bool has_value = index + 1 < argc;
+  if (strcmp(arg, "-j") == 0 && has_value) {
+    long thread_count = atol(argv[index + 1]);
+    command_line->thread_count = thread_count > 0 ? thread_count : 1;
+    return 2;
+  } else if (strcmp(arg, "--quota") == 0 && has_value) {
+    command_line->options.quota = atol(argv[index + 1]);
+    return 2;
+  } else if (strcmp(arg, "--log") == 0) {
+    command_line->options.log = true;
+  } else if (strcmp(arg, "-v") == 0) {
+    command_line->options.verbose = true;
+  } else if (strcmp(arg, "-") == 0) {
+    prv_add_paths_from_stdin(command_line);
+  } else if (arg[0] != '-') {
+    prv_add_path(command_line, arg);
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+// Replay one device's trace on this thread's simulated watch with this thread's tuning
+void replay_device(ReplayDevice *device, const ReplayOptions *options) {
+  Dump dump;
+  if (!dump_open(&dump, device->path)) {
+    device->error = errno;
+    return;
+  }
+  shim_reset(options->quota, options->verbose);
+  replay_alert_count = 0;
+  DataLibrary *data_library = NULL;
+  ReplayPrediction run[REPLAY_RUN_MAX_COUNT];
+  uint16_t run_count = 0;
+  time_t discharge_epoch = 0;
+  // feed each point to the library at its own time
+  DumpIterator iter;
+  dump_iterator_init(&iter, &dump);
+  const SaveState *save_state;
+  while ((save_state = options->log ? dump_iterator_next_log_state(&iter) :
+                                      dump_iterator_next_block_state(&iter))) {
+    time_t epoch = dump_get_epoch(save_state);
+    BatteryChargeState battery_state = {
+      .charge_percent = dump_get_percent(save_state),
+      .is_charging = save_state->charging,
+      .is_plugged = save_state->plugged
+    };
+    shim_advance(epoch);
+    shim_set_battery(battery_state);
+    // the worker was stopped before this point, so start it again like worker.c does
+    if (!data_library || !save_state->contiguous) {
+      if (data_library) {
+        data_terminate(data_library);
+        shim_cancel_timers();
+        device->restart_count++;
+      }
+      data_library = data_initialize();
+      data_register_alert_callback(data_library, prv_alert_handler);
+    }
+    data_process_new_battery_state(data_library, battery_state);
+    device->point_count++;
+    // keep the prediction while discharging, scoring the discharge when it ends
+    bool discharging = !battery_state.is_charging && !battery_state.is_plugged;
+    if (!discharging || !save_state->contiguous || run_count >= REPLAY_RUN_MAX_COUNT) {
+      prv_score_run(device, run, run_count);
+      run_count = 0;
+    }
+    if (discharging) {
+      run[run_count++] = (ReplayPrediction) {
+        .epoch = epoch,
+        .percent = battery_state.charge_percent,
+        .charge_by = data_get_charge_by_time(data_library)
+      };
+    }
+    // track whole discharges, from the end of a charge to the next charge without a gap
+    if (!save_state->contiguous) {
+      discharge_epoch = 0;
+    }
+    if (battery_state.is_charging && discharge_epoch) {
+      prv_score_cycle(device, data_library, epoch - discharge_epoch);
+      discharge_epoch = 0;
+    } else if (!battery_state.is_charging && !discharge_epoch && save_state->contiguous) {
+      discharge_epoch = epoch;
+    }
+  }
+  prv_score_run(device, run, run_count);
+  if (data_library) {
+    data_terminate(data_library);
+  }
+  device->skipped_count = iter.skipped_count;
+  device->alert_count = replay_alert_count;
+  device->stats = *shim_get_stats();
+  dump_close(&dump);
+}
+
+// Run tasks over a work stealing pool, returning once all are done
+void replay_pool_run(size_t task_count, size_t thread_count, ReplayTaskHandler handler,
+                     void *context) {
+  ReplayPool pool = {
+    .queues = calloc(thread_count, sizeof(ReplayQueue)),
+    .thread_count = thread_count,
+    .handler = handler,
+    .context = context
+  };
+  ReplayThread *threads = calloc(thread_count, sizeof(ReplayThread));
+  pthread_t *thread_ids = calloc(thread_count, sizeof(pthread_t));
+  // deal the tasks out round robin
+  for (size_t ii = 0; ii < thread_count; ii++) {
+    pthread_mutex_init(&pool.queues[ii].lock, NULL);
+    pool.queues[ii].items = calloc(task_count / thread_count + 1, sizeof(size_t));
+  }
+  for (size_t ii = 0; ii < task_count; ii++) {
+    ReplayQueue *queue = &pool.queues[ii % thread_count];
+    queue->items[queue->tail++] = ii;
+  }
+  for (size_t ii = 0; ii < thread_count; ii++) {
+    threads[ii] = (ReplayThread) { .pool = &pool, .thread_index = ii };
+    pthread_create(&thread_ids[ii], NULL, prv_thread_main, &threads[ii]);
+  }
+  for (size_t ii = 0; ii < thread_count; ii++) {
+    pthread_join(thread_ids[ii], NULL);
+  }
+  // other threads may steal from a queue until they all finish
+  for (size_t ii = 0; ii < thread_count; ii++) {
+    pthread_mutex_destroy(&pool.queues[ii].lock);
+    free(pool.queues[ii].items);
+  }
+  free(thread_ids);
+  free(threads);
+  free(pool.queues);
+}
@@ -0,0 +1,91 @@
+//! @file replay_engine.h
+//! @brief Replays device traces through the worker's data library
+//!
+//! Each trace is one device's history, a persistent storage dump or a data logging dump (see
+//! dump_reader.h). Every data point is fed to data_library.c at its own time on this thread's
+//! simulated watch, restarting the library where the worker was stopped.
+//!
+//! Two things are scored against the trace itself:
+//! - Prediction error over each uninterrupted discharge: the charge by time predicted at each
+//!   point is used to predict when the battery reaches the last level seen before charging,
+//!   and compared to when it actually did.
+//! - Cycle detection: each discharge the trace shows ending in a charge is matched if the run
+//!   time the library reports for its last cycle is within REPLAY_CYCLE_TOLERANCE of it.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include "replay_shim.h"
+
+// Constants
+#define REPLAY_CYCLE_TOLERANCE 10       //< Run time error in percent for a cycle to match
+
+//! Options for replaying a device
+typedef struct {
+  bool      log;                        //< Whether traces are data logging dumps
+  bool      verbose;                    //< Whether to print the library's log messages
+  uint32_t  quota;                      //< Persistent storage quota in bytes
+} ReplayOptions;
+
+//! Results for one device
+typedef struct {
+  const char  *path;                    //< Path of the trace
+  int         error;                    //< errno if the trace could not be read
+  uint32_t    point_count;              //< Data points replayed
+  uint32_t    skipped_count;            //< Invalid blocks or records skipped
+  uint32_t    restart_count;            //< Times the worker was restarted
+  uint32_t    alert_count;              //< Battery alerts raised
+  uint32_t    prediction_count;         //< Predictions scored
+  double      error_sum;                //< Sum of absolute prediction errors in seconds
+  uint32_t    cycle_count;              //< Discharges in the trace which ended in a charge
+  uint32_t    cycle_match_count;        //< Of those, the ones the library reported correctly
+  ShimStats   stats;                    //< Simulated watch counters
+} ReplayDevice;
+
+//! Options and traces from the command line, shared by the replay tools
+typedef struct {
+  ReplayOptions options;                //< Replay options
+  size_t        thread_count;           //< Number of threads, defaults to the core count
+  const char    **paths;                //< Paths of the traces
+  size_t        path_count;             //< Number of traces
+  size_t        path_capacity;          //< Allocated length of paths
+} ReplayCommandLine;
+
+//! Handler for one task of a replay pool
+//! @param task_index Index of the task to run
+//! @param thread_index Index of the thread running it, below the thread count
+//! @param context The context passed to replay_pool_run
+typedef void (*ReplayTaskHandler)(size_t task_index, size_t thread_index, void *context);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+//! Set the command line defaults
+//! @param command_line The command line to initialize
+void replay_command_line_init(ReplayCommandLine *command_line);
+
+//! Parse one of the shared arguments: -j threads, --quota bytes, --log, -v, a trace path, or -
+//! to read trace paths one per line from standard input
+//! @param command_line The command line to which to add the argument
+//! @param argc The argument count
+//! @param argv The arguments
+//! @param index The index of the argument to parse
+//! @return The number of arguments consumed, 0 if the argument is not a shared one
+int replay_command_line_parse(ReplayCommandLine *command_line, int argc, char **argv, int index);
+
+//! Replay one device's trace on this thread's simulated watch with this thread's tuning
+//! @param device The device, with its path set, to which to write the results
+//! @param options The replay options
+void replay_device(ReplayDevice *device, const ReplayOptions *options);
+
+//! Run tasks over a work stealing pool, returning once all are done
+//! @param task_count Number of tasks
+//! @param thread_count Number of threads
+//! @param handler Called once for each task on one of the threads
+//! @param context Passed to the handler
+void replay_pool_run(size_t task_count, size_t thread_count, ReplayTaskHandler handler,
+                     void *context);
@@ -0,0 +1,322 @@
+// @file replay_shim.c
+// @brief Host stand-in for the Pebble worker SDK
+//
+// Backs the worker SDK functions with a simulated watch held in thread local storage. Timers
+// are identified by a counter rather than a pointer so a stale handle, such as one the library
+// cancelled without clearing, is safely ignored instead of touching a reused slot.
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include <stdarg.h>
+#include "replay_shim.h"
+#define PEBBLE_BACKGROUND_WORKER
+#include "../../src/utility.c"
+#undef PEBBLE_BACKGROUND_WORKER
+
+// Constants
+#define SHIM_PERSIST_MAX_COUNT 64       //< Most keys stored at once
+#define SHIM_TIMER_MAX_COUNT 16         //< Most timers scheduled at once
+
+// Persistent storage entry
+typedef struct {
+  uint32_t  key;                        //< Key of the value
+  uint16_t  size;                       //< Size of the value in bytes
+  uint8_t   data[PERSIST_DATA_MAX_LENGTH]; //< The value
+} ShimPersistEntry;
+
+// Scheduled timer
+typedef struct {
+  uintptr_t         id;                 //< Handle of the timer, 0 if the slot is free
+  int64_t           due_ms;             //< Time the timer fires in milliseconds
+  AppTimerCallback  callback;           //< Function to call when it fires
+  void              *data;              //< Data passed to the callback
+} ShimTimer;
+
+// Simulated watch
+typedef struct {
+  int64_t             now_ms;           //< Current time in milliseconds
+  BatteryChargeState  battery_state;    //< Current battery state
+  ShimPersistEntry    persist[SHIM_PERSIST_MAX_COUNT]; //< Persistent storage
+  uint8_t             persist_count;    //< Number of keys stored
+  uint32_t            persist_quota;    //< Storage quota in bytes
+  ShimTimer           timers[SHIM_TIMER_MAX_COUNT]; //< Scheduled timers
+  uintptr_t           next_timer_id;    //< Handle of the next timer
+  bool                verbose;          //< Whether to print log messages
+  ShimStats           stats;            //< Counters since the last reset
+} ShimWatch;
+
+// Simulated watches of each replay thread, one for each library being compared
+static _Thread_local ShimWatch shim_watches[SHIM_WATCH_COUNT];
+
+// The watch the SDK functions act on, the first until another is selected
+static _Thread_local ShimWatch *shim_watch;
+
+// Estimator constants used by the data library on this thread
+_Thread_local ReplayTuning replay_tuning = REPLAY_TUNING_DEFAULT;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Find a persistent storage entry
+static ShimPersistEntry *prv_persist_find(uint32_t key) {
+  for (uint8_t ii = 0; ii < shim_watch->persist_count; ii++) {
+    if (shim_watch->persist[ii].key == key) {
+      return &shim_watch->persist[ii];
+    }
+  }
+  return NULL;
+}
+
+// Find a scheduled timer by its handle
+static ShimTimer *prv_timer_find(AppTimer *timer) {
+  uintptr_t id = (uintptr_t)timer;
+  for (uint8_t ii = 0; id && ii < SHIM_TIMER_MAX_COUNT; ii++) {
+    if (shim_watch->timers[ii].id == id) {
+      return &shim_watch->timers[ii];
+    }
+  }
+  return NULL;
+}
+
+// Find the timer which is due next
+static ShimTimer *prv_timer_next(void) {
+  ShimTimer *next = NULL;
+  for (uint8_t ii = 0; ii < SHIM_TIMER_MAX_COUNT; ii++) {
+    ShimTimer *timer = &shim_watch->timers[ii];
+    if (timer->id && (!next || timer->due_ms < next->due_ms)) {
+      next = timer;
+    }
+  }
+  return next;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+// Clear persistent storage, timers and counters for a new device
+void shim_reset(uint32_t persist_quota, bool verbose) {
+  if (!shim_watch) {
+    shim_watch = &shim_watches[0];
+  }
+  memset(shim_watch, 0, sizeof(ShimWatch));
+  shim_watch->persist_quota = persist_quota;
+  shim_watch->next_timer_id = 1;
+  shim_watch->verbose = verbose;
+}
+
+// Set the battery state returned by the battery state service
+void shim_set_battery(BatteryChargeState battery_state) {
+  shim_watch->battery_state = battery_state;
+}
+
+// Advance the clock, firing each timer that comes due on the way in order
+void shim_advance(time_t now) {
+  int64_t now_ms = (int64_t)now * 1000;
+  ShimTimer *timer;
+  while ((timer = prv_timer_next()) && timer->due_ms <= now_ms) {
+    ShimTimer fired = *timer;
+    timer->id = 0;
+    if (fired.due_ms > shim_watch->now_ms) {
+      shim_watch->now_ms = fired.due_ms;
+    }
+    shim_watch->stats.timers_fired++;
+    fired.callback(fired.data);
+  }
+  if (now_ms > shim_watch->now_ms) {
+    shim_watch->now_ms = now_ms;
+  }
+}
+
+// Cancel all timers, as happens when the worker is stopped
+void shim_cancel_timers(void) {
+  memset(shim_watch->timers, 0, sizeof(shim_watch->timers));
+}
+
+// Select the watch the SDK functions act on
+void shim_select_watch(uint8_t index) {
+  shim_watch = &shim_watches[index < SHIM_WATCH_COUNT ? index : 0];
+}
+
+// Get the counters collected since the last reset
+const ShimStats *shim_get_stats(void) {
+  return &shim_watch->stats;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Worker SDK
+//
+
+void app_log(uint8_t level, const char *file, int line, const char *fmt, ...) {
+  if (!shim_watch->verbose) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "%s:%d ", file, line);
+  vfprintf(stderr, fmt, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+}
+
+time_t replay_time(time_t *tloc) {
+  time_t now = shim_watch->now_ms / 1000;
+  if (tloc) {
+    *tloc = now;
+  }
+  return now;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *ms) {
+  uint16_t now_ms = shim_watch->now_ms % 1000;
+  replay_time(tloc);
+  if (ms) {
+    *ms = now_ms;
+  }
+  return now_ms;
+}
+
+void psleep(int millis) {
+  shim_advance((shim_watch->now_ms + millis) / 1000);
+}
+
+bool persist_exists(uint32_t key) {
+  return prv_persist_find(key) != NULL;
+}
+
+int persist_get_size(uint32_t key) {
+  ShimPersistEntry *entry = prv_persist_find(key);
+  return entry ? entry->size : E_DOES_NOT_EXIST;
+}
+
+int32_t persist_read_int(uint32_t key) {
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+bool persist_read_bool(uint32_t key) {
+  bool value = false;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size) {
+  ShimPersistEntry *entry = prv_persist_find(key);
+  if (!entry) {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = entry->size < buffer_size ? entry->size : buffer_size;
+  memcpy(buffer, entry->data, size);
+  return size;
+}
+
+int persist_write_int(uint32_t key, int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_bool(uint32_t key, bool value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_data(uint32_t key, const void *data, size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) {
+    size = PERSIST_DATA_MAX_LENGTH;
+  }
+  ShimPersistEntry *entry = prv_persist_find(key);
+  uint32_t bytes = shim_watch->stats.persist_bytes - (entry ? entry->size : 0) + size;
+  if (bytes > shim_watch->persist_quota ||
+      (!entry && shim_watch->persist_count >= SHIM_PERSIST_MAX_COUNT)) {
+    shim_watch->stats.persist_write_failures++;
+    return E_OUT_OF_STORAGE;
+  }
+  if (!entry) {
+    entry = &shim_watch->persist[shim_watch->persist_count++];
+    entry->key = key;
+  }
+  memcpy(entry->data, data, size);
+  entry->size = size;
+  shim_watch->stats.persist_bytes = bytes;
+  if (bytes > shim_watch->stats.persist_bytes_peak) {
+    shim_watch->stats.persist_bytes_peak = bytes;
+  }
+  shim_watch->stats.persist_writes++;
+  return size;
+}
+
+int persist_delete(uint32_t key) {
+  ShimPersistEntry *entry = prv_persist_find(key);
+  if (!entry) {
+    return E_DOES_NOT_EXIST;
+  }
+  shim_watch->stats.persist_bytes -= entry->size;
+  *entry = shim_watch->persist[--shim_watch->persist_count];
+  return 0;
+}
+
+BatteryChargeState battery_state_service_peek(void) {
+  return shim_watch->battery_state;
+}
+
+WatchInfoModel watch_info_get_model(void) {
+  return WATCH_INFO_MODEL_UNKNOWN;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *data) {
+  for (uint8_t ii = 0; ii < SHIM_TIMER_MAX_COUNT; ii++) {
+    ShimTimer *timer = &shim_watch->timers[ii];
+    if (!timer->id) {
+      *timer = (ShimTimer) {
+        .id = shim_watch->next_timer_id++,
+        .due_ms = shim_watch->now_ms + timeout_ms,
+        .callback = callback,
+        .data = data
+      };
+      return (AppTimer*)timer->id;
+    }
+  }
+  return NULL;
+}
+
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms) {
+  ShimTimer *shim_timer = prv_timer_find(timer);
+  if (!shim_timer) {
+    return false;
+  }
+  shim_timer->due_ms = shim_watch->now_ms + new_timeout_ms;
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer) {
+  ShimTimer *shim_timer = prv_timer_find(timer);
+  if (shim_timer) {
+    shim_timer->id = 0;
+  }
+}
+
+DataLoggingSessionRef data_logging_create(uint32_t tag, DataLoggingItemType item_type,
+                                          uint16_t item_length, bool resume) {
+  return &shim_watch;
+}
+
+DataLoggingResult data_logging_log(DataLoggingSessionRef session, const void *data,
+                                   uint32_t num_items) {
+  shim_watch->stats.log_records += num_items;
+  return DATA_LOGGING_SUCCESS;
+}
+
+int app_worker_send_message(uint8_t type, AppWorkerMessage *data) {
+  shim_watch->stats.worker_messages++;
+  return 0;
+}
+
+int worker_launch_app(void) {
+  shim_watch->stats.app_launches++;
+  return 0;
+}
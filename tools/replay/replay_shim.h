@@ -0,0 +1,58 @@
+//! @file replay_shim.h
+//! @brief Controls the simulated watch behind the host worker SDK
+//!
+//! All state is thread local, so each replay thread drives its own simulated watches. A thread
+//! has SHIM_WATCH_COUNT watches so libraries being compared never share storage or timers;
+//! the SDK functions act on the selected one. Call shim_reset before replaying a device.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include "pebble_worker.h"
+
+// Constants
+#define SHIM_PERSIST_QUOTA 4096         //< Default persistent storage quota of an app in bytes
+#define SHIM_WATCH_COUNT 2              //< Simulated watches on each thread
+
+//! Counters collected while replaying a device
+typedef struct {
+  uint32_t  persist_bytes;              //< Bytes currently stored
+  uint32_t  persist_bytes_peak;         //< Most bytes stored at once
+  uint32_t  persist_writes;             //< Successful persistent storage writes
+  uint32_t  persist_write_failures;     //< Writes rejected by the storage quota
+  uint32_t  log_records;                //< Records sent with data logging
+  uint32_t  worker_messages;            //< Messages sent to the foreground app
+  uint32_t  app_launches;               //< Times the worker launched the foreground app
+  uint32_t  timers_fired;               //< AppTimers which fired
+} ShimStats;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API Interface
+//
+
+//! Clear persistent storage, timers and counters of the selected watch for a new device
+//! @param persist_quota The persistent storage quota in bytes
+//! @param verbose Whether to print the library's log messages
+void shim_reset(uint32_t persist_quota, bool verbose);
+
+//! Set the battery state returned by the battery state service
+//! @param battery_state The new state
+void shim_set_battery(BatteryChargeState battery_state);
+
+//! Advance the clock, firing each timer that comes due on the way in order
+//! @param now The new time, ignored if earlier than the current time
+void shim_advance(time_t now);
+
+//! Cancel all timers, as happens when the worker is stopped
+void shim_cancel_timers(void);
+
+//! Select the watch the SDK functions act on, until another is selected
+//! @param index The index of the watch, below SHIM_WATCH_COUNT
+void shim_select_watch(uint8_t index);
+
+//! Get the counters collected since the last reset
+//! @return The counters of the selected watch
+const ShimStats *shim_get_stats(void);
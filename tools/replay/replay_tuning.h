@@ -0,0 +1,36 @@
+//! @file replay_tuning.h
+//! @brief Runtime values for the data library's estimator constants in host builds
+//!
+//! Included by the host pebble_worker.h, so data_library.c picks up these definitions in place
+//! of its defaults. The values are thread local, so each replay thread can run the library
+//! with different constants. The defaults give the same results as the watch.
+//!
+//! @author Eric D. Phillips
+//! @date October 17, 2016
+//! @bugs No known bugs
+
+#pragma once
+#include <stdint.h>
+
+//! Estimator and cycle detection constants
+typedef struct {
+  int32_t filter_weight;                //< Weight of the previous charge rate, out of 100
+  int32_t discharging_min_permille;     //< Minimum run time to register, per mille of max life
+  int32_t contiguous_percent_drop;      //< Percent drop used to predict the next point
+} ReplayTuning;
+
+//! The constants used on the watch
+#define REPLAY_TUNING_DEFAULT ((ReplayTuning) { \
+  .filter_weight = 80, \
+  .discharging_min_permille = 100, \
+  .contiguous_percent_drop = 10 \
+})
+
+//! Constants used by the data library on this thread
+extern _Thread_local ReplayTuning replay_tuning;
+
+// Overrides of the constants in data_library.c
+#define CHARGE_RATE_FILTER_WEIGHT (replay_tuning.filter_weight)
+#define CHARGE_RATE_FILTER_SCALE 100
+#define DISCHARGING_MIN_FRACTION replay_tuning.discharging_min_permille / 1000
+#define CONTIGUOUS_PERCENT_DROP (replay_tuning.contiguous_percent_drop)
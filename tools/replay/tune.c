@@ -0,0 +1,216 @@
+// @file tune.c
+// @brief Sweep the data library's estimator constants over a fleet of device traces
+//
+// Usage: tune [-j threads] [--log] [--quota bytes] [-v] [--random count] [--seed seed] [--all]
+//             <trace>... (or - to read paths)
+//
+// Every parameter set is replayed against every device as described in replay_engine.h, one
+// task per set and device on a work stealing pool. The constants are set on the thread before
+// each task (see replay_tuning.h), so sets run side by side without rebuilding the library.
+// Scores are summed per thread and merged at the end, so threads never share a counter.
+//
+// By default a grid around the watch's constants is swept, or with --random that many sets
+// are drawn at random. The sets no other set beats on both mean absolute error and cycle
+// accuracy are printed as CSV, or every set with --all. The watch's own set is always
+// included and marked.
+//
+// Build from the repository root:
+//   cc -O2 -pthread -I tools/replay -o tune tools/replay/tune.c tools/replay/replay_engine.c
+//     tools/replay/replay_shim.c tools/dump_reader.c worker_src/data_library.c
+//
+// @author Eric D. Phillips
+// @date October 17, 2016
+// @bugs No known bugs
+
+#include "replay_engine.h"
+#define PEBBLE_BACKGROUND_WORKER
+#include "../../src/utility.h"
+#undef PEBBLE_BACKGROUND_WORKER
+
+// Grid of each constant swept by default
+static const int32_t tune_filter_weights[] = { 50, 60, 70, 80, 90 };
+static const int32_t tune_discharging_min_permilles[] = { 0, 50, 100, 200 };
+static const int32_t tune_contiguous_percent_drops[] = { 5, 10, 15, 20 };
+
+// Ranges of each constant drawn from with --random
+#define TUNE_FILTER_WEIGHT_MAX 95       //< Largest filter weight drawn, out of 100
+#define TUNE_DISCHARGING_MIN_PERMILLE_MAX 300 //< Largest minimum run time drawn, per mille
+#define TUNE_CONTIGUOUS_PERCENT_DROP_MAX 30 //< Largest percent drop drawn
+
+// Scores of one parameter set
+typedef struct {
+  double    error_sum;                  //< Sum of absolute prediction errors in seconds
+  uint64_t  prediction_count;           //< Predictions scored
+  uint64_t  cycle_count;                //< Discharges which ended in a charge
+  uint64_t  cycle_match_count;          //< Of those, the ones the library reported correctly
+} TuneScore;
+
+// Main data struct
+static struct {
+  ReplayCommandLine command_line;       //< Options and traces
+  ReplayTuning      *sets;              //< Parameter sets to replay
+  size_t            set_count;          //< Number of parameter sets
+  TuneScore         *scores;            //< Scores for each thread and set, set index fastest
+  bool              print_all;          //< Whether to print every set rather than the best
+} tune_data;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//
+
+// Whether two parameter sets are the same
+static bool prv_tuning_equal(ReplayTuning a, ReplayTuning b) {
+  return a.filter_weight == b.filter_weight &&
+    a.discharging_min_permille == b.discharging_min_permille &&
+    a.contiguous_percent_drop == b.contiguous_percent_drop;
+}
+
+// Fill the sets with the default grid
+static void prv_create_grid(void) {
+  size_t weight_count = ARRAY_LENGTH(tune_filter_weights);
+  size_t permille_count = ARRAY_LENGTH(tune_discharging_min_permilles);
+  size_t drop_count = ARRAY_LENGTH(tune_contiguous_percent_drops);
+  tune_data.set_count = weight_count * permille_count * drop_count;
+  tune_data.sets = calloc(tune_data.set_count, sizeof(ReplayTuning));
+  size_t index = 0;
+  for (size_t ii = 0; ii < weight_count; ii++) {
+    for (size_t jj = 0; jj < permille_count; jj++) {
+      for (size_t kk = 0; kk < drop_count; kk++) {
+        tune_data.sets[index++] = (ReplayTuning) {
+          .filter_weight = tune_filter_weights[ii],
+          .discharging_min_permille = tune_discharging_min_permilles[jj],
+          .contiguous_percent_drop = tune_contiguous_percent_drops[kk]
+        };
+      }
+    }
+  }
+}
+
+// Fill the sets with random draws, the first being the watch's own set
+static void prv_create_random(size_t count, unsigned int seed) {
+  tune_data.set_count = count + 1;
+  tune_data.sets = calloc(tune_data.set_count, sizeof(ReplayTuning));
+  tune_data.sets[0] = REPLAY_TUNING_DEFAULT;
+  for (size_t ii = 1; ii < tune_data.set_count; ii++) {
+    tune_data.sets[ii] = (ReplayTuning) {
+      .filter_weight = rand_r(&seed) % (TUNE_FILTER_WEIGHT_MAX + 1),
+      .discharging_min_permille = rand_r(&seed) % (TUNE_DISCHARGING_MIN_PERMILLE_MAX + 1),
+      .contiguous_percent_drop = 1 + rand_r(&seed) % TUNE_CONTIGUOUS_PERCENT_DROP_MAX
+    };
+  }
+}
+
+// Replay one device with one parameter set on a pool thread
+static void prv_tune_task(size_t task_index, size_t thread_index, void *context) {
+  size_t device_count = tune_data.command_line.path_count;
+  size_t set_index = task_index / device_count;
+  ReplayDevice device = { .path = tune_data.command_line.paths[task_index % device_count] };
+  replay_tuning = tune_data.sets[set_index];
+  replay_device(&device, &tune_data.command_line.options);
+  if (device.error) {
+    fprintf(stderr, "Could not read %s: %s\n", device.path, strerror(device.error));
+    return;
+  }
+  TuneScore *score = &tune_data.scores[thread_index * tune_data.set_count + set_index];
+  score->error_sum += device.error_sum;
+  score->prediction_count += device.prediction_count;
+  score->cycle_count += device.cycle_count;
+  score->cycle_match_count += device.cycle_match_count;
+}
+
+// Mean absolute prediction error of a score in hours
+static double prv_score_get_error(TuneScore *score) {
+  return score->prediction_count ? score->error_sum / score->prediction_count / SEC_IN_HR : 0;
+}
+
+// Fraction of discharges whose cycle the library reported correctly
+static double prv_score_get_accuracy(TuneScore *score) {
+  return score->cycle_count ? (double)score->cycle_match_count / score->cycle_count : 0;
+}
+
+// Whether one score is at least as good as another on both measures and better on one
+static bool prv_score_dominates(TuneScore *a, TuneScore *b) {
+  double a_error = prv_score_get_error(a), b_error = prv_score_get_error(b);
+  double a_accuracy = prv_score_get_accuracy(a), b_accuracy = prv_score_get_accuracy(b);
+  return a_error <= b_error && a_accuracy >= b_accuracy &&
+    (a_error < b_error || a_accuracy > b_accuracy);
+}
+
+// Merge each thread's scores into the first thread's
+static void prv_merge_scores(void) {
+  for (size_t ii = 1; ii < tune_data.command_line.thread_count; ii++) {
+    for (size_t jj = 0; jj < tune_data.set_count; jj++) {
+      TuneScore *score = &tune_data.scores[ii * tune_data.set_count + jj];
+      tune_data.scores[jj].error_sum += score->error_sum;
+      tune_data.scores[jj].prediction_count += score->prediction_count;
+      tune_data.scores[jj].cycle_count += score->cycle_count;
+      tune_data.scores[jj].cycle_match_count += score->cycle_match_count;
+    }
+  }
+}
+
+// Print the sets no other set beats, or every set
+static void prv_print_results(void) {
+  printf("filter_weight,discharging_min_permille,contiguous_percent_drop,mean_abs_error_hr,"
+    "cycle_accuracy,default\n");
+  size_t print_count = 0;
+  for (size_t ii = 0; ii < tune_data.set_count; ii++) {
+    bool is_default = prv_tuning_equal(tune_data.sets[ii], REPLAY_TUNING_DEFAULT);
+    bool dominated = false;
+    for (size_t jj = 0; !dominated && jj < tune_data.set_count; jj++) {
+      dominated = prv_score_dominates(&tune_data.scores[jj], &tune_data.scores[ii]);
+    }
+    if (dominated && !is_default && !tune_data.print_all) {
+      continue;
+    }
+    ReplayTuning *set = &tune_data.sets[ii];
+    printf("%d,%d,%d,%.3f,%.3f,%d\n", set->filter_weight, set->discharging_min_permille,
+      set->contiguous_percent_drop, prv_score_get_error(&tune_data.scores[ii]),
+      prv_score_get_accuracy(&tune_data.scores[ii]), is_default);
+    print_count++;
+  }
+  fprintf(stderr, "Swept %zu parameter sets over %zu devices, printed %zu\n",
+    tune_data.set_count, tune_data.command_line.path_count, print_count);
+}
+
+// Entry point
+int main(int argc, char **argv) {
+  ReplayCommandLine *command_line = &tune_data.command_line;
+  replay_command_line_init(command_line);
+  size_t random_count = 0;
+  unsigned int seed = 1;
+  bool valid = true;
+  for (int ii = 1; valid && ii < argc;) {
+    if (strcmp(argv[ii], "--random") == 0 && ii + 1 < argc) {
+      random_count = atol(argv[ii + 1]);
+      ii += 2;
+    } else if (strcmp(argv[ii], "--seed") == 0 && ii + 1 < argc) {
+      seed = atol(argv[ii + 1]);
+      ii += 2;
+    } else if (strcmp(argv[ii], "--all") == 0) {
+      tune_data.print_all = true;
+      ii++;
+    } else {
+      int consumed = replay_command_line_parse(command_line, argc, argv, ii);
+      valid = consumed > 0;
+      ii += consumed;
+    }
+  }
+  if (!valid || !command_line->path_count) {
+    fprintf(stderr, "Usage: %s [-j threads] [--log] [--quota bytes] [-v] [--random count] "
+      "[--seed seed] [--all] <trace>... | -\n", argv[0]);
+    return 1;
+  }
+  if (random_count) {
+    prv_create_random(random_count, seed);
+  } else {
+    prv_create_grid();
+  }
+  tune_data.scores = calloc(command_line->thread_count * tune_data.set_count, sizeof(TuneScore));
+  replay_pool_run(tune_data.set_count * command_line->path_count, command_line->thread_count,
+    prv_tune_task, NULL);
+  prv_merge_scores();
+  prv_print_results();
+  return 0;
+}
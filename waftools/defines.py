@@ -1,7 +1,15 @@
 def options(ctx):
     ctx.add_option('--build-debug', action='store_true', default=False,
                    help="Mark a build to include debug code")
+    ctx.add_option('--build-perf-hud', action='store_true', default=False,
+                   help="Draw the performance overlay on top of the cards")
+    ctx.add_option('--build-sync-popup', action='store_true', default=False,
+                   help="Show a popup while pushing timeline pins instead of a blank window")
 
 def configure(ctx):
     if ctx.options.build_debug:
         ctx.env.append_value('DEFINES', 'BUILD_DEBUG')
+    if ctx.options.build_perf_hud:
+        ctx.env.append_value('DEFINES', 'BUILD_PERF_HUD')
+    if ctx.options.build_sync_popup:
+        ctx.env.append_value('DEFINES', 'BUILD_SYNC_POPUP')
@@ -16,18 +16,73 @@
 #undef PEBBLE_BACKGROUND_WORKER
 
 // Constants
-#define DATA_VERSION 0                  //< The current persistent storage format version
 #define LOW_THRESH_DEFAULT 4 * SEC_IN_HR  //< Default threshold for low level
 #define MED_THRESH_DEFAULT SEC_IN_DAY   //< Default threshold for medium level
-#define DATA_BLOCK_SAVE_STATE_COUNT 50  //< Number of SaveStates that fit in one persistent write
-#define DATA_EPOCH_OFFSET 1420070400    //< Jan 1, 2015 at 0:00:00, reduces size when saving data
 #define LINKED_LIST_MAX_SIZE DATA_BLOCK_SAVE_STATE_COUNT * 2 //< Max size of linked list
 #define CYCLE_LINKED_LIST_MIN_SIZE 9    //< The minimum number of nodes in the charge cycle list
-// Thresholds
+// Thresholds, host builds of the replay tools override these to tune them
 #define CHARGING_MIN_LENGTH 60          //< Minimum duration while charging to register (sec)
+#ifndef DISCHARGING_MIN_FRACTION
 #define DISCHARGING_MIN_FRACTION 1 / 10 //< Minimum fraction of default run time to register
+#endif
+#ifndef CHARGE_RATE_FILTER_WEIGHT
+#define CHARGE_RATE_FILTER_WEIGHT 4     //< Weight of the previous charge rate in the filter
+#endif
+#ifndef CHARGE_RATE_FILTER_SCALE
+#define CHARGE_RATE_FILTER_SCALE 5      //< Total weight of the charge rate filter
+#endif
+#ifndef CONTIGUOUS_PERCENT_DROP
+#define CONTIGUOUS_PERCENT_DROP 10      //< Percent drop used to predict when the next point is due
+#endif
+#define DATA_LOG_BATCH_COUNT 10         //< Number of records buffered before logging them
+#define DATA_LOG_FLUSH_DELAY (SEC_IN_HR * 1000) //< Longest time a record stays buffered (ms)
+// Retention policy, old blocks are evicted in the background to keep the history within it
+#define PERSIST_QUOTA 4096              //< Persistent storage quota of the app in bytes
+#define RETENTION_RESERVE 1024          //< Quota left for the other keys and foreground messages
+#ifndef RETENTION_MAX_BYTES
+#define RETENTION_MAX_BYTES (PERSIST_QUOTA - RETENTION_RESERVE) //< Most bytes of history blocks
+#endif
+#ifndef RETENTION_MAX_DAYS
+#define RETENTION_MAX_DAYS 90           //< Age after which a block is evicted, 0 to keep it
+#endif
+#ifndef RETENTION_KEEP_ROLLUPS
+#define RETENTION_KEEP_ROLLUPS true     //< Whether to summarize evicted blocks before deleting them
+#endif
+#define RETENTION_MIN_BLOCK_COUNT 3     //< Full blocks before the newest which are never evicted
+#define RETENTION_DELAY 5000            //< Delay before evicting once the history grows (ms)
+#define BLOCK_CHECK_MASK 0x3FF          //< Bits of the block check value
+#define BLOCK_CHECK_BYTE_SHIFT 2        //< Shift of the top byte of the block check value
+// Newest blocks verified at launch, those the estimates are read from
+#define RECOVERY_BLOCK_COUNT (LINKED_LIST_MAX_SIZE / DATA_BLOCK_SAVE_STATE_COUNT + 1)
 
 
+// CRC-10 of each byte with the polynomial 0x233, so the block check value takes one step per
+// byte instead of eight
+static const uint16_t prv_block_check_table[256] = {
+  0x000, 0x233, 0x255, 0x066, 0x299, 0x0AA, 0x0CC, 0x2FF, 0x301, 0x132, 0x154, 0x367,
+  0x198, 0x3AB, 0x3CD, 0x1FE, 0x031, 0x202, 0x264, 0x057, 0x2A8, 0x09B, 0x0FD, 0x2CE,
+  0x330, 0x103, 0x165, 0x356, 0x1A9, 0x39A, 0x3FC, 0x1CF, 0x062, 0x251, 0x237, 0x004,
+  0x2FB, 0x0C8, 0x0AE, 0x29D, 0x363, 0x150, 0x136, 0x305, 0x1FA, 0x3C9, 0x3AF, 0x19C,
+  0x053, 0x260, 0x206, 0x035, 0x2CA, 0x0F9, 0x09F, 0x2AC, 0x352, 0x161, 0x107, 0x334,
+  0x1CB, 0x3F8, 0x39E, 0x1AD, 0x0C4, 0x2F7, 0x291, 0x0A2, 0x25D, 0x06E, 0x008, 0x23B,
+  0x3C5, 0x1F6, 0x190, 0x3A3, 0x15C, 0x36F, 0x309, 0x13A, 0x0F5, 0x2C6, 0x2A0, 0x093,
+  0x26C, 0x05F, 0x039, 0x20A, 0x3F4, 0x1C7, 0x1A1, 0x392, 0x16D, 0x35E, 0x338, 0x10B,
+  0x0A6, 0x295, 0x2F3, 0x0C0, 0x23F, 0x00C, 0x06A, 0x259, 0x3A7, 0x194, 0x1F2, 0x3C1,
+  0x13E, 0x30D, 0x36B, 0x158, 0x097, 0x2A4, 0x2C2, 0x0F1, 0x20E, 0x03D, 0x05B, 0x268,
+  0x396, 0x1A5, 0x1C3, 0x3F0, 0x10F, 0x33C, 0x35A, 0x169, 0x188, 0x3BB, 0x3DD, 0x1EE,
+  0x311, 0x122, 0x144, 0x377, 0x289, 0x0BA, 0x0DC, 0x2EF, 0x010, 0x223, 0x245, 0x076,
+  0x1B9, 0x38A, 0x3EC, 0x1DF, 0x320, 0x113, 0x175, 0x346, 0x2B8, 0x08B, 0x0ED, 0x2DE,
+  0x021, 0x212, 0x274, 0x047, 0x1EA, 0x3D9, 0x3BF, 0x18C, 0x373, 0x140, 0x126, 0x315,
+  0x2EB, 0x0D8, 0x0BE, 0x28D, 0x072, 0x241, 0x227, 0x014, 0x1DB, 0x3E8, 0x38E, 0x1BD,
+  0x342, 0x171, 0x117, 0x324, 0x2DA, 0x0E9, 0x08F, 0x2BC, 0x043, 0x270, 0x216, 0x025,
+  0x14C, 0x37F, 0x319, 0x12A, 0x3D5, 0x1E6, 0x180, 0x3B3, 0x24D, 0x07E, 0x018, 0x22B,
+  0x0D4, 0x2E7, 0x281, 0x0B2, 0x17D, 0x34E, 0x328, 0x11B, 0x3E4, 0x1D7, 0x1B1, 0x382,
+  0x27C, 0x04F, 0x029, 0x21A, 0x0E5, 0x2D6, 0x2B0, 0x083, 0x12E, 0x31D, 0x37B, 0x148,
+  0x3B7, 0x184, 0x1E2, 0x3D1, 0x22F, 0x01C, 0x07A, 0x249, 0x0B6, 0x285, 0x2E3, 0x0D0,
+  0x11F, 0x32C, 0x34A, 0x179, 0x386, 0x1B5, 0x1D3, 0x3E0, 0x21E, 0x02D, 0x04B, 0x278,
+  0x087, 0x2B4, 0x2D2, 0x0E1
+};
+
 // AppTimer custom data struct
 typedef struct {
   AppTimer      *app_timer;       //< The AppTimer which will own this struct as data
@@ -41,25 +96,6 @@ typedef struct {
   uint8_t   scheduled_count;                    //< The total number of currently scheduled alerts
 } AlertData;
 
-// Structure containing compressed data in the form it will be saved in
-typedef struct {
-  unsigned  epoch       : 30;   //< The epoch timestamp for when the percentage changed in seconds
-  unsigned  percent     : 7;    //< The battery charge percent
-  bool      charging    : 1;    //< The charging state of the battery
-  bool      plugged     : 1;    //< The plugged in state of the watch
-  bool      contiguous  : 1;    //< Whether the worker stayed active since the last data point
-} __attribute__((__packed__)) SaveState;
-
-// Data structure used when saving to and reading from persistent storage
-// Includes a header with extra stats
-typedef struct {
-  unsigned    data_version          : 8;            //< The data version format for this block
-  signed      initial_charge_rate   : 24;           //< The charge rate after first point in block
-  unsigned    padding               : 10;           //< Padding space so structure is 256 bytes
-  unsigned    save_state_count      : 6;            //< The number of data points written
-  SaveState save_states[DATA_BLOCK_SAVE_STATE_COUNT];  //< The actual data state points being stored
-} __attribute__((__packed__)) SaveStateBlock;
-
 // Linked list basic node type structure followed by all linked lists
 typedef struct Node {
   struct Node     *next;            //< A pointer to the next node in the linked list
@@ -96,7 +132,16 @@ typedef struct DataLibrary {
   AlertData               alert_data;               //< Data for battery low alerts
   AppTimerData            app_timers[DATA_ALERT_MAX_COUNT];  //< AppTimer data for alerts
   BatteryAlertCallback    alert_callback;           //< The function to call when an alert goes off
+  TimelineUpdateCallback  timeline_callback;        //< The function to call before pushing pins
   DataLoggingSessionRef   data_logging_session;     //< Data logging session to send data to phone
+  DataLogRecord           data_log_buffer[DATA_LOG_BATCH_COUNT]; //< Records waiting to be logged
+  uint8_t                 data_log_count;           //< Number of records in the buffer
+  AppTimer                *data_log_timer;          //< Timer to flush the buffer if it fills slowly
+  DataBlockRing           block_ring;               //< Indices of the blocks of history
+  AppTimer                *retention_timer;         //< Timer to evict old blocks in the background
+  SaveStateBlock          newest_block;             //< Copy of the newest block once intact
+  bool                    newest_block_cached;      //< Whether newest_block is the newest block
+  uint32_t                verified_index;           //< Blocks from here to the newest are verified
 } DataLibrary;
 
 // Function declarations
@@ -121,6 +166,44 @@ static void prv_app_timer_alert_callback(void *data) {
   data_library->app_timers[index].app_timer = NULL;
 }
 
+// Send all buffered records to the phone with data logging
+static void prv_data_log_flush(DataLibrary *data_library) {
+  if (data_library->data_log_timer) {
+    app_timer_cancel(data_library->data_log_timer);
+    data_library->data_log_timer = NULL;
+  }
+  if (!data_library->data_log_count) {
+    return;
+  }
+  DataLoggingResult result = data_logging_log(data_library->data_logging_session,
+    data_library->data_log_buffer, data_library->data_log_count);
+  if (result != DATA_LOGGING_SUCCESS) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Data logging failed: %d", (int)result);
+  }
+  data_library->data_log_count = 0;
+}
+
+// AppTimer callback to flush the data logging buffer
+static void prv_data_log_timer_callback(void *data) {
+  DataLibrary *data_library = data;
+  data_library->data_log_timer = NULL;
+  prv_data_log_flush(data_library);
+}
+
+// Buffer a SaveState to be sent to the phone, flushing when full or on a charge transition
+static void prv_data_log_add(DataLibrary *data_library, SaveState save_state, bool transition) {
+  data_library->data_log_buffer[data_library->data_log_count++] = (DataLogRecord) {
+    .version = DATA_LOG_VERSION,
+    .save_state = save_state
+  };
+  if (transition || data_library->data_log_count >= DATA_LOG_BATCH_COUNT) {
+    prv_data_log_flush(data_library);
+  } else if (!data_library->data_log_timer) {
+    data_library->data_log_timer = app_timer_register(DATA_LOG_FLUSH_DELAY,
+      prv_data_log_timer_callback, data_library);
+  }
+}
+
 // Set DataNode properties from SaveState
 static void prv_set_data_node_from_save_state(DataNode *data_node, SaveState *save_state) {
   data_node->epoch = save_state->epoch + DATA_EPOCH_OFFSET;
@@ -279,7 +362,7 @@ static bool prv_are_save_states_contiguous(SaveState old_state, SaveState new_st
   if (!old_state.contiguous || new_state.percent > old_state.percent) {return false; }
   // otherwise predict when the new state should occur and compare to the actual time
   // Note: the epoch offset does not matter in this case
-  int32_t predicted_epoch = old_state.epoch + (-10) * charge_rate;
+  int32_t predicted_epoch = old_state.epoch + (-CONTIGUOUS_PERCENT_DROP) * charge_rate;
   // value must be less than 1 / 2 the difference of the old and new states
   if (new_state.epoch < predicted_epoch ||
     new_state.epoch - predicted_epoch < (new_state.epoch - old_state.epoch) / 2) {
@@ -298,8 +381,9 @@ static int32_t prv_calculate_charge_rate(SaveState old_state, SaveState new_stat
     !prv_are_save_states_contiguous(old_state, new_state, charge_rate)) {
     return charge_rate;
   } else {
-    return charge_rate * 4 / 5 +
-      ((new_state.epoch - old_state.epoch) / (new_state.percent - old_state.percent)) / 5;
+    return charge_rate * CHARGE_RATE_FILTER_WEIGHT / CHARGE_RATE_FILTER_SCALE +
+      ((new_state.epoch - old_state.epoch) / (new_state.percent - old_state.percent)) *
+      (CHARGE_RATE_FILTER_SCALE - CHARGE_RATE_FILTER_WEIGHT) / CHARGE_RATE_FILTER_SCALE;
   }
 }
 
@@ -393,7 +477,9 @@ static void prv_calculate_charge_cycles(DataLibrary *data_library, uint16_t min_
           charge_node = prv_create_charge_cycle_node(data_library, cur_node->charge_rate);
         }
         charge_node->discharge_epoch = lst_state.epoch + DATA_EPOCH_OFFSET;
-        charge_node->avg_charge_rate = charge_rate_avg / charge_rate_count;
+        // Cortex-M integer division by zero returns 0, so a cycle with no discharging points
+        // has a rate of 0 on the watch, and the guard keeps that result on hosts which trap
+        charge_node->avg_charge_rate = charge_rate_count ? charge_rate_avg / charge_rate_count : 0;
         charge_rate_avg = charge_rate_count = 0;
       }
       // log change
@@ -410,32 +496,91 @@ static void prv_calculate_charge_cycles(DataLibrary *data_library, uint16_t min_
   prv_filter_charge_cycles(data_library, true);
 }
 
+// Get the check value of a block at an index
+static uint16_t prv_block_get_check(uint32_t block_index, SaveStateBlock *save_state_block) {
+  uint16_t check = save_state_block->check;
+  save_state_block->check = 0;
+  uint16_t crc = 0;
+  for (uint16_t ii = 0; ii < sizeof(block_index) + sizeof(SaveStateBlock); ii++) {
+    uint8_t byte = ii < sizeof(block_index) ? block_index >> (ii * 8) :
+      ((uint8_t*)save_state_block)[ii - sizeof(block_index)];
+    crc = (crc << 8) ^ prv_block_check_table[((crc >> BLOCK_CHECK_BYTE_SHIFT) ^ byte) & 0xFF];
+    crc &= BLOCK_CHECK_MASK;
+  }
+  save_state_block->check = check;
+  return crc;
+}
+
+// Read a block from persistent storage, returning whether it exists, is intact and belongs to
+// the index, blocks written without a check value or already verified are only checked for a
+// sane header
+static bool prv_persist_read_block(uint32_t block_index, SaveStateBlock *save_state_block,
+                                   bool verified) {
+  if (persist_read_data(DATA_BLOCK_KEY(block_index), save_state_block, sizeof(SaveStateBlock)) !=
+      sizeof(SaveStateBlock) || save_state_block->save_state_count > DATA_BLOCK_SAVE_STATE_COUNT) {
+    return false;
+  }
+  if (save_state_block->data_version == DATA_VERSION_UNCHECKED) {
+    return save_state_block->check == 0;
+  }
+  return save_state_block->data_version == DATA_VERSION && (verified ||
+    save_state_block->check == prv_block_get_check(block_index, save_state_block));
+}
+
+// Read a block, the newest from memory once it is intact and each older one verified only the
+// first time it is read, as only the newest block is ever written again
+static bool prv_block_read(DataLibrary *data_library, uint32_t block_index,
+                           SaveStateBlock *save_state_block) {
+  DataBlockRing *block_ring = &data_library->block_ring;
+  if (block_index == block_ring->newest_index && data_library->newest_block_cached) {
+    *save_state_block = data_library->newest_block;
+    return true;
+  }
+  bool verified = block_index >= data_library->verified_index &&
+    block_index < block_ring->newest_index;
+  if (!prv_persist_read_block(block_index, save_state_block, verified)) {
+    return false;
+  }
+  if (block_index == block_ring->newest_index) {
+    data_library->newest_block = *save_state_block;
+    data_library->newest_block_cached = true;
+  } else if (block_index + 1 == data_library->verified_index) {
+    data_library->verified_index--;
+  }
+  return true;
+}
+
 // Read data from persistent storage into a linked list
 static void prv_persist_read_data_block(DataLibrary *data_library, uint16_t index) {
   // prep linked list
   prv_linked_list_destroy((Node**)&data_library->head_node, &data_library->node_count);
   data_library->head_node = NULL;
   data_library->head_node_index = 0;
-  // get persistent storage key
-  uint32_t persist_key = persist_read_int(PERSIST_DATA_KEY);
-  if (!persist_exists(persist_key)) { persist_key--; }
-  if (persist_key <= PERSIST_DATA_KEY || !persist_exists(persist_key)) { return; }
-  // offset the persistent key to where the data is stored
+  // get the newest block, the newest index has no block until its first data point
+  DataBlockRing *block_ring = &data_library->block_ring;
+  uint32_t block_index = block_ring->newest_index;
   SaveStateBlock save_state_block;
-  persist_read_data(persist_key, &save_state_block, sizeof(SaveStateBlock));
-  if (index >= save_state_block.save_state_count) {
-    persist_key--;
-    data_library->head_node_index += save_state_block.save_state_count;
-  }
-  persist_key -= ((int32_t)index - save_state_block.save_state_count) / DATA_BLOCK_SAVE_STATE_COUNT;
-  data_library->head_node_index += ((int32_t)index - save_state_block.save_state_count) /
-    DATA_BLOCK_SAVE_STATE_COUNT * DATA_BLOCK_SAVE_STATE_COUNT;
-  // read in several blocks of data
-  for (uint32_t key = persist_key;
-       key > persist_key - (LINKED_LIST_MAX_SIZE / DATA_BLOCK_SAVE_STATE_COUNT) &&
-         key > PERSIST_DATA_KEY && persist_exists(key); key--) {
-    // read the data from persistent storage
-    persist_read_data(key, &save_state_block, sizeof(SaveStateBlock));
+  if (!prv_block_read(data_library, block_index, &save_state_block)) {
+    if (block_index == block_ring->oldest_index) { return; }
+    block_index--;
+    if (!prv_block_read(data_library, block_index, &save_state_block)) { return; }
+  }
+  uint32_t read_index = block_index;
+  // offset the block index to where the data is stored, every older block is full
+  uint8_t count = save_state_block.save_state_count;
+  if (index >= count) {
+    uint32_t back_count = 1 + (index - count) / DATA_BLOCK_SAVE_STATE_COUNT;
+    data_library->head_node_index = count + (index - count) / DATA_BLOCK_SAVE_STATE_COUNT *
+      DATA_BLOCK_SAVE_STATE_COUNT;
+    if (back_count > block_index - block_ring->oldest_index) { return; }
+    block_index -= back_count;
+  }
+  // read in several blocks of data, stopping at a block which is missing or not intact, the
+  // newest block read above is not read again
+  uint32_t block_count = block_index - block_ring->oldest_index + 1;
+  for (uint32_t jj = 0; jj < LINKED_LIST_MAX_SIZE / DATA_BLOCK_SAVE_STATE_COUNT &&
+       jj < block_count && (block_index - jj == read_index ||
+       prv_block_read(data_library, block_index - jj, &save_state_block)); jj++) {
     // loop over data
     int32_t tmp_charge_rate = 0;
     DataNode *tmp_node, *insert_after_node = prv_linked_list_get_last_node(data_library);
@@ -456,37 +601,251 @@ static void prv_persist_read_data_block(DataLibrary *data_library, uint16_t inde
   }
 }
 
+// Write the indices of the blocks to persistent storage
+static void prv_block_ring_write(DataLibrary *data_library) {
+  persist_write_data(PERSIST_DATA_KEY, &data_library->block_ring, sizeof(DataBlockRing));
+}
+
+// Move the blocks left at the keys of the old layout into the circular range of keys, a
+// block's index is its old key's offset from the first block key. As fewer blocks are kept than
+// the range holds, the key each moves to is either its own or empty. A block is moved at most
+// once, so this picks up where an interrupted migration stopped.
+static void prv_block_ring_move_blocks(DataLibrary *data_library) {
+  DataBlockRing *block_ring = &data_library->block_ring;
+  SaveStateBlock save_state_block;
+  uint32_t moved_count = 0;
+  for (uint32_t jj = 0; jj <= block_ring->newest_index - block_ring->oldest_index; jj++) {
+    uint32_t index = block_ring->newest_index - jj;
+    uint32_t key = PERSIST_DATA_KEY + 1 + index;
+    uint32_t block_key = DATA_BLOCK_KEY(index);
+    if (block_key == key || persist_read_data(key, &save_state_block,
+        sizeof(SaveStateBlock)) != sizeof(SaveStateBlock)) {
+      continue;
+    }
+    // storage may be full after the old layout, so make room by deleting the old key when the
+    // write fails, the block is safe in memory
+    int result = persist_write_data(block_key, &save_state_block, sizeof(SaveStateBlock));
+    persist_delete(key);
+    if (result < (int)sizeof(SaveStateBlock)) {
+      result = persist_write_data(block_key, &save_state_block, sizeof(SaveStateBlock));
+    }
+    if (result < (int)sizeof(SaveStateBlock)) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Data block %d move failed: %d", (int)index, result);
+    } else {
+      moved_count++;
+    }
+  }
+  // clear any block left outside the range by a gap in the old keys
+  for (uint32_t index = block_ring->newest_index + 1;
+       index < block_ring->oldest_index + DATA_BLOCK_KEY_COUNT; index++) {
+    persist_delete(DATA_BLOCK_KEY(index));
+  }
+  persist_delete(PERSIST_MIGRATION_KEY);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Moved %d data blocks into the key range", (int)moved_count);
+}
+
+// Find the blocks of the old layout, where keys counted up from PERSIST_DATA_KEY without bound
+// and PERSIST_DATA_KEY held the key of the newest block, which may not have been started. The
+// indices are written before any block moves, with PERSIST_MIGRATION_KEY marking them as
+// unfinished.
+static void prv_block_ring_migrate(DataLibrary *data_library) {
+  int32_t stored_key = persist_read_int(PERSIST_DATA_KEY);
+  if (stored_key < PERSIST_DATA_KEY + 1) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Invalid newest data key: %d", (int)stored_key);
+    stored_key = PERSIST_DATA_KEY + 1;
+  }
+  // probe down from the newest block which exists
+  uint32_t newest_key = stored_key, oldest_key = newest_key;
+  if (!persist_exists(oldest_key) && oldest_key > PERSIST_DATA_KEY + 1 &&
+      persist_exists(oldest_key - 1)) {
+    oldest_key--;
+  }
+  while (oldest_key > PERSIST_DATA_KEY + 1 && persist_exists(oldest_key - 1)) {
+    oldest_key--;
+  }
+  // keep only the newest blocks which fit in the range
+  while (newest_key - oldest_key >= DATA_BLOCK_KEY_COUNT) {
+    persist_delete(oldest_key++);
+  }
+  data_library->block_ring = (DataBlockRing) {
+    .oldest_index = oldest_key - (PERSIST_DATA_KEY + 1),
+    .newest_index = newest_key - (PERSIST_DATA_KEY + 1)
+  };
+  // record the indices, evicting the oldest blocks if storage is too full to hold them
+  while ((persist_write_bool(PERSIST_MIGRATION_KEY, true) < (int)sizeof(bool) ||
+          persist_write_data(PERSIST_DATA_KEY, &data_library->block_ring,
+          sizeof(DataBlockRing)) < (int)sizeof(DataBlockRing)) && oldest_key < newest_key) {
+    persist_delete(oldest_key++);
+    data_library->block_ring.oldest_index++;
+  }
+  prv_block_ring_move_blocks(data_library);
+}
+
+// Read the indices of the blocks, moving the blocks of the old layout into the range first
+static void prv_block_ring_read(DataLibrary *data_library) {
+  if (persist_get_size(PERSIST_DATA_KEY) == sizeof(DataBlockRing)) {
+    persist_read_data(PERSIST_DATA_KEY, &data_library->block_ring, sizeof(DataBlockRing));
+    if (persist_exists(PERSIST_MIGRATION_KEY)) {
+      prv_block_ring_move_blocks(data_library);
+    }
+  } else {
+    prv_block_ring_migrate(data_library);
+  }
+}
+
+// Add a block which is about to be evicted to the summary of the evicted history
+static void prv_retention_add_rollup(SaveStateBlock *save_state_block) {
+  RetentionRollup rollup = { 0 };
+  persist_read_data(PERSIST_ROLLUP_KEY, &rollup, sizeof(RetentionRollup));
+  SaveState *lst_state = NULL;
+  for (uint8_t ii = 0; ii < save_state_block->save_state_count; ii++) {
+    SaveState *save_state = &save_state_block->save_states[ii];
+    if (!rollup.point_count++) {
+      rollup.first_epoch = save_state->epoch;
+    }
+    rollup.last_epoch = save_state->epoch;
+    if (save_state->charging && (!lst_state || !lst_state->charging)) {
+      rollup.charge_count++;
+    } else if (lst_state && save_state->contiguous && !lst_state->charging &&
+               !save_state->charging && save_state->percent < lst_state->percent) {
+      rollup.discharge_seconds += save_state->epoch - lst_state->epoch;
+      rollup.discharge_percent += lst_state->percent - save_state->percent;
+    }
+    lst_state = save_state;
+  }
+  persist_write_data(PERSIST_ROLLUP_KEY, &rollup, sizeof(RetentionRollup));
+}
+
+// Evict the oldest blocks which fall outside of the retention policy, evicting at least one
+// block when forced, but never one of the newest blocks
+static void prv_retention_evict(DataLibrary *data_library, bool force) {
+  DataBlockRing *block_ring = &data_library->block_ring;
+  int32_t expire_epoch = time(NULL) - DATA_EPOCH_OFFSET - RETENTION_MAX_DAYS * SEC_IN_DAY;
+  SaveStateBlock save_state_block;
+  uint32_t oldest_index = block_ring->oldest_index;
+  while (block_ring->oldest_index + RETENTION_MIN_BLOCK_COUNT < block_ring->newest_index) {
+    uint32_t key = DATA_BLOCK_KEY(block_ring->oldest_index);
+    // count the newest block as full, so there is room for it before it is started
+    bool over_bytes = (block_ring->newest_index - block_ring->oldest_index + 1) *
+      sizeof(SaveStateBlock) > RETENTION_MAX_BYTES;
+    bool intact = prv_block_read(data_library, block_ring->oldest_index, &save_state_block);
+    uint8_t count = intact ? save_state_block.save_state_count : 0;
+    bool expired = RETENTION_MAX_DAYS && count &&
+      (int32_t)save_state_block.save_states[count - 1].epoch < expire_epoch;
+    if (!force && !over_bytes && !expired) {
+      break;
+    }
+    // delete the block first so the summary has room when storage is full
+    persist_delete(key);
+    block_ring->oldest_index++;
+    if (RETENTION_KEEP_ROLLUPS && intact) {
+      prv_retention_add_rollup(&save_state_block);
+    }
+    force = false;
+  }
+  if (block_ring->oldest_index != oldest_index) {
+    prv_block_ring_write(data_library);
+  }
+}
+
+// AppTimer callback to evict old blocks
+static void prv_retention_timer_callback(void *data) {
+  DataLibrary *data_library = data;
+  data_library->retention_timer = NULL;
+  prv_retention_evict(data_library, false);
+}
+
+// Schedule old blocks to be evicted in the background
+static void prv_retention_schedule(DataLibrary *data_library) {
+  if (!data_library->retention_timer) {
+    data_library->retention_timer = app_timer_register(RETENTION_DELAY,
+      prv_retention_timer_callback, data_library);
+  }
+}
+
+// Move on to the next block, which takes the oldest block's key once the range is full
+static void prv_block_ring_advance(DataLibrary *data_library) {
+  DataBlockRing *block_ring = &data_library->block_ring;
+  block_ring->newest_index++;
+  data_library->newest_block_cached = false;
+  if (block_ring->newest_index - block_ring->oldest_index >= DATA_BLOCK_KEY_COUNT) {
+    prv_retention_evict(data_library, true);
+  }
+  prv_block_ring_write(data_library);
+  prv_retention_schedule(data_library);
+}
+
+// Verify the newest blocks, which a reset while writing can leave half written or full
+// without the indices moved on, and roll back to the last intact state
+static void prv_block_ring_recover(DataLibrary *data_library) {
+  DataBlockRing *block_ring = &data_library->block_ring;
+  SaveStateBlock save_state_block;
+  if (prv_block_read(data_library, block_ring->newest_index, &save_state_block) &&
+      save_state_block.save_state_count >= DATA_BLOCK_SAVE_STATE_COUNT) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Recovered full data block %d",
+      (int)block_ring->newest_index);
+    prv_block_ring_advance(data_library);
+  }
+  // a corrupt newest block is dropped, an older one also drops the blocks before it since the
+  // history is no longer contiguous past it
+  for (uint32_t jj = 0; jj < RECOVERY_BLOCK_COUNT &&
+       jj <= block_ring->newest_index - block_ring->oldest_index; jj++) {
+    uint32_t block_index = block_ring->newest_index - jj;
+    if (!persist_exists(DATA_BLOCK_KEY(block_index)) ||
+        prv_block_read(data_library, block_index, &save_state_block)) {
+      continue;
+    }
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Dropped corrupt data block %d", (int)block_index);
+    if (jj == 0) {
+      persist_delete(DATA_BLOCK_KEY(block_index));
+      continue;
+    }
+    while (block_ring->oldest_index <= block_index) {
+      persist_delete(DATA_BLOCK_KEY(block_ring->oldest_index++));
+    }
+    prv_block_ring_write(data_library);
+    break;
+  }
+}
+
 // Write newest DataNode into persistent storage
 static void prv_persist_write_data_node(DataLibrary *data_library, DataNode *data_node) {
-  // get the location and size of the data
-  uint32_t persist_key = persist_read_int(PERSIST_DATA_KEY);
-  // build a SaveStateBlock to write into memory
-  SaveStateBlock save_state_block = (SaveStateBlock) {
-    .data_version = DATA_VERSION,
-    .initial_charge_rate = data_node->charge_rate,
-    .save_state_count = 0
-  };
-  if (persist_exists(persist_key)) {
-    persist_read_data(persist_key, &save_state_block, sizeof(SaveStateBlock));
+  // get the newest block, starting a new one if it is missing, corrupt or already full
+  DataBlockRing *block_ring = &data_library->block_ring;
+  SaveStateBlock save_state_block;
+  bool intact = prv_block_read(data_library, block_ring->newest_index, &save_state_block);
+  if (intact && save_state_block.save_state_count >= DATA_BLOCK_SAVE_STATE_COUNT) {
+    prv_block_ring_advance(data_library);
+    intact = false;
+  }
+  uint32_t persist_key = DATA_BLOCK_KEY(block_ring->newest_index);
+  if (!intact) {
+    save_state_block = (SaveStateBlock) {
+      .initial_charge_rate = data_node->charge_rate,
+      .save_state_count = 0
+    };
   }
   prv_set_save_state_from_data_node(&save_state_block.save_states[save_state_block
     .save_state_count++], data_node);
-  // get the oldest existing key
-  uint32_t old_persist_key = persist_key;
-  while (old_persist_key > PERSIST_DATA_KEY && persist_exists(old_persist_key - 1)) {
-    old_persist_key--;
-  }
-  // attempt to write the data and delete old data if the write fails,
-  // but do not delete any closer than the last three data blocks
-  uint16_t bytes_written = persist_write_data(persist_key, &save_state_block,
-    sizeof(SaveStateBlock));
-  while (bytes_written < sizeof(SaveStateBlock) && old_persist_key + 3 < persist_key) {
-    persist_delete(old_persist_key++);
-    bytes_written = persist_write_data(persist_key, &save_state_block, sizeof(SaveStateBlock));
-  }
-  // check if SaveStateBlock is full and index to next key
+  save_state_block.data_version = DATA_VERSION;
+  save_state_block.check = prv_block_get_check(block_ring->newest_index, &save_state_block);
+  // write the data, the retention policy normally leaves room for it so if the write fails
+  // evict one block straight away and retry once
+  int result = persist_write_data(persist_key, &save_state_block, sizeof(SaveStateBlock));
+  if (result < (int)sizeof(SaveStateBlock)) {
+    prv_retention_evict(data_library, true);
+    result = persist_write_data(persist_key, &save_state_block, sizeof(SaveStateBlock));
+  }
+  if (result < (int)sizeof(SaveStateBlock)) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Data point write failed: %d", result);
+    data_library->newest_block_cached = false;
+    return;
+  }
+  data_library->newest_block = save_state_block;
+  data_library->newest_block_cached = true;
+  // check if SaveStateBlock is full and index to next block
   if (save_state_block.save_state_count >= DATA_BLOCK_SAVE_STATE_COUNT) {
-    persist_write_int(PERSIST_DATA_KEY, ++persist_key);
+    prv_block_ring_advance(data_library);
   }
 }
 
@@ -522,6 +881,9 @@ static void prv_process_save_state(DataLibrary *data_library, SaveState save_sta
       data_library->node_count--;
     }
   }
+  // check for a charge state change before the nodes can be freed by reloading the cache
+  bool transition = !lst_node || lst_node->charging != new_node->charging ||
+    lst_node->plugged != new_node->plugged;
   // persist the data point
   prv_persist_write_data_node(data_library, new_node);
   // recalculate charge cycles
@@ -533,10 +895,13 @@ static void prv_process_save_state(DataLibrary *data_library, SaveState save_sta
   }
   // schedule wake-up low battery alert
   data_refresh_all_alerts(data_library);
-  // send the data to the phone with data logging
-  data_logging_log(data_library->data_logging_session, new_node, 1);
+  // send the data to the phone with data logging, immediately if the charge state changed
+  prv_data_log_add(data_library, save_state, transition);
   // update timeline pins
   if (!persist_exists(PERSIST_TIMELINE_KEY) || persist_read_bool(PERSIST_TIMELINE_KEY)) {
+    if (data_library->timeline_callback) {
+      data_library->timeline_callback(data_library);
+    }
     // launching the app without any arguments will trigger this
     worker_launch_app();
   }
@@ -602,7 +967,7 @@ static void prv_first_launch_prep(DataLibrary *data_library) {
   data_schedule_alert(data_library, LOW_THRESH_DEFAULT);
   data_schedule_alert(data_library, MED_THRESH_DEFAULT);
   // write out starting persistent storage location
-  persist_write_int(PERSIST_DATA_KEY, PERSIST_DATA_KEY + 1);
+  prv_block_ring_write(data_library);
   // port any legacy data
   if (persist_exists(LEGACY_PERSIST_DATA)) {
     prv_persist_convert_legacy_data(data_library);
@@ -726,6 +1091,11 @@ void data_register_alert_callback(DataLibrary *data_library, BatteryAlertCallbac
   data_library->alert_callback = callback;
 }
 
+// Register callback for when the timeline pins are about to be updated
+void data_register_timeline_callback(DataLibrary *data_library, TimelineUpdateCallback callback) {
+  data_library->timeline_callback = callback;
+}
+
 // Get the time the watch needs to be charged by
 int32_t data_get_charge_by_time(DataLibrary *data_library) {
   DataNode cur_node = prv_get_current_data_node(data_library);
@@ -857,71 +1227,6 @@ uint16_t data_get_data_point_count_including_seconds(DataLibrary *data_library,
   return index;
 }
 
-// Print the data to the console in CSV format
-void data_print_csv(DataLibrary *data_library) {
-  DataNode cur_data_node = prv_get_current_data_node(data_library);
-  // print header
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "=====================================================");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Battery+ by Ycleptic Studios");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "-----------------------------------------------------");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "All timestamps are in UTC epoch format.");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "'Charge Rate' represents the inverse of the rate of");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "change of the battery percentage with respect to");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "time. It is in seconds per percent.");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Any value of -1 represents an invalid statistic.");
-  // print stats
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "--------------------- Statistics --------------------");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Pebble Model:\t%d", watch_info_get_model());
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Current Time:\t%d", (int)time(NULL));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Last Charged:\t%d",
-    (int)(time(NULL) - data_get_run_time(data_library, 0)));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Time Remaining:\t%d",
-    (int)data_get_life_remaining(data_library));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Maximum Life:\t%d",
-    (int)data_get_max_life(data_library, 0));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Run Time:\t%d",
-    (int)data_get_run_time(data_library, 0));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Record Life:\t%d",
-    (int)data_get_record_run_time(data_library));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Battery Percent:\t%d", (int)data_get_battery_percent
-    (data_library));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Percent per Day:\t%d",
-    (int)data_get_percent_per_day(data_library));
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Charge Rate:\t%d", (int)cur_data_node.charge_rate);
-  // print interpreted charge cycles
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "------------------- Charge Cycles -------------------");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Charge Start,\tRun Start,\tRun Stop,\tAvg Charge "
-    "Rate,");
-  uint16_t cycle_count = 0;
-  ChargeCycleNode *cur_cycle_node = (ChargeCycleNode*)prv_linked_list_get_node_by_index
-    ((Node*)data_library->cycle_head_node, cycle_count);
-  while (cur_cycle_node) {
-    cycle_count++;
-    app_log(APP_LOG_LEVEL_INFO, "", 0, "%d,\t%d,\t%d,\t%d,",
-      (int)cur_cycle_node->charge_epoch, (int)cur_cycle_node->discharge_epoch,
-      (int)cur_cycle_node->end_epoch, (int)cur_cycle_node->avg_charge_rate);
-    cur_cycle_node = (ChargeCycleNode*)prv_linked_list_get_node_by_index
-      ((Node*)data_library->cycle_head_node, cycle_count);
-  }
-
-  // print raw data points
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "---------------------- Raw Data ---------------------");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Epoch,\t\tPerc,\tChar,\tPlug,\tContig,\tCharge Rate,");
-  uint16_t data_count = 0;
-  DataNode *cur_node = prv_list_get_data_node(data_library, data_count);
-  while (cur_node) {
-    data_count++;
-    app_log(APP_LOG_LEVEL_INFO, "", 0, "%d,\t%d,\t%d,\t%d,\t%d,\t%d,",
-      (int)cur_node->epoch, (int)cur_node->percent, (int)cur_node->charging, (int)cur_node->plugged,
-      (int)cur_node->contiguous, (int)cur_node->charge_rate);
-    cur_node = prv_list_get_data_node(data_library, data_count);
-  }
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "-----------------------------------------------------");
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Charge Cycle Count: %d", cycle_count);
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "Data Point Count: %d", data_count);
-  app_log(APP_LOG_LEVEL_INFO, "", 0, "=====================================================");
-}
-
 // Process a BatteryChargeState structure and add it to the data
 void data_process_new_battery_state(DataLibrary *data_library,
                                     BatteryChargeState battery_state) {
@@ -1017,15 +1322,20 @@ DataLibrary *data_initialize(void) {
   DataLibrary *data_library = MALLOC(sizeof(DataLibrary));
   memset(data_library, 0, sizeof(DataLibrary));
   data_library->data_logging_session = data_logging_create(DATA_LOGGING_TAG,
-    DATA_LOGGING_BYTE_ARRAY, sizeof(DataNode), true);
+    DATA_LOGGING_BYTE_ARRAY, sizeof(DataLogRecord), true);
   // read data from persistent storage
   if (!persist_exists(PERSIST_DATA_KEY)) {
     prv_first_launch_prep(data_library);
   } else {
+    prv_block_ring_read(data_library);
+    data_library->verified_index = data_library->block_ring.newest_index;
+    prv_block_ring_recover(data_library);
     prv_persist_read_data_block(data_library, 0);
     prv_calculate_charge_cycles(data_library, CYCLE_LINKED_LIST_MIN_SIZE);
     data_refresh_all_alerts(data_library);
   }
+  // bring history written under an older policy, or restored from the phone, within this one
+  prv_retention_schedule(data_library);
   // send message to the foreground telling it to refresh
   AppWorkerMessage msg_data = { .data0 = 0 };
   app_worker_send_message(WorkerMessageReloadData, &msg_data);
@@ -1034,6 +1344,11 @@ DataLibrary *data_initialize(void) {
 
 // Terminate the data
 void data_terminate(DataLibrary *data_library) {
+  // send any buffered records
+  prv_data_log_flush(data_library);
+  if (data_library->retention_timer) {
+    app_timer_cancel(data_library->retention_timer);
+  }
   // free other data
   prv_linked_list_destroy((Node**)&data_library->cycle_head_node, &data_library->cycle_node_count);
   prv_linked_list_destroy((Node**)&data_library->head_node, &data_library->node_count);
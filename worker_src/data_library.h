@@ -17,6 +17,9 @@ typedef struct DataLibrary DataLibrary;
 //! Alert triggered callback type
 typedef void(*BatteryAlertCallback)(uint8_t);
 
+//! Timeline update callback type, called before the app is launched to push the pins
+typedef void(*TimelineUpdateCallback)(DataLibrary*);
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // API Interface
@@ -53,6 +56,11 @@ void data_unschedule_alert(DataLibrary *data_library, uint8_t index);
 //! @param callback The callback to register
 void data_register_alert_callback(DataLibrary *data_library, BatteryAlertCallback callback);
 
+//! Register callback for when the timeline pins are about to be updated
+//! @param data_library A pointer to an existing DataLibrary
+//! @param callback The callback to register
+void data_register_timeline_callback(DataLibrary *data_library, TimelineUpdateCallback callback);
+
 //! Get the time the watch needs to be charged by
 //! @param data_library A pointer to an existing DataLibrary
 //! @return The time the watch needs to be charged as a UTC epoch
@@ -110,10 +118,6 @@ uint16_t data_get_charge_cycle_count_including_seconds(DataLibrary *data_library
 //! @return The minimum number of data points to encompass that time span
 uint16_t data_get_data_point_count_including_seconds(DataLibrary *data_library, int32_t seconds);
 
-//! Print the data to the console in CSV format
-//! @param data_library A pointer to an existing DataLibrary
-void data_print_csv(DataLibrary *data_library);
-
 //! Process a BatteryChargeState structure and add it to the data
 //! @param data_library A pointer to an existing DataLibrary
 //! @param battery_state A BatteryChargeState containing the state of the battery
@@ -23,8 +23,14 @@ static DataLibrary *data_library;
 
 // Battery alert raised callback
 static void prv_battery_alert_handler(uint8_t alert_index) {
-  // write out the index of the alert
-  persist_write_int(WAKE_UP_ALERT_INDEX_KEY, alert_index);
+  // write out everything the popup shows, so it does not need to load the data
+  AlertFireRecord record = {
+    .threshold = data_get_alert_threshold(data_library, alert_index),
+    .charge_by_time = data_get_charge_by_time(data_library),
+    .alert_index = alert_index,
+    .alert_count = data_get_alert_count(data_library)
+  };
+  persist_write_data(ALERT_FIRE_KEY, &record, sizeof(record));
   // send message in case app is already open
   AppWorkerMessage message = {.data0 = alert_index};
   app_worker_send_message(WorkerMessageAlertEvent, &message);
@@ -32,6 +38,27 @@ static void prv_battery_alert_handler(uint8_t alert_index) {
   worker_launch_app();
 }
 
+// Timeline update callback, publishes the pin times so the app can send them without the data
+static void prv_timeline_update_handler(DataLibrary *data_library) {
+  int32_t pin_times[DATA_PIN_MAX_COUNT];
+  uint8_t alert_count = data_get_alert_count(data_library);
+  pin_times[0] = data_get_charge_by_time(data_library);
+  for (uint8_t ii = 0; ii < alert_count; ii++) {
+    pin_times[ii + 1] = pin_times[0] - data_get_alert_threshold(data_library, ii);
+  }
+  persist_write_data(PIN_TIMES_KEY, pin_times, (alert_count + 1) * sizeof(int32_t));
+}
+
+// Publish the pin times again after the alerts change, or delete them if the pins are disabled
+// so a sync falls back to loading the data instead of pushing stale times
+static void prv_republish_pin_times(void) {
+  if (!persist_exists(PERSIST_TIMELINE_KEY) || persist_read_bool(PERSIST_TIMELINE_KEY)) {
+    prv_timeline_update_handler(data_library);
+  } else {
+    persist_delete(PIN_TIMES_KEY);
+  }
+}
+
 // Worker message callback
 static void prv_worker_message_handler(uint16_t type, AppWorkerMessage *data) {
   // check what was sent
@@ -42,12 +69,11 @@ static void prv_worker_message_handler(uint16_t type, AppWorkerMessage *data) {
     case WorkerMessageScheduleAlert:;
       int32_t seconds = (data->data0 << 16) | (data->data1 & 0x0000FFFF);
       data_schedule_alert(data_library, seconds);
+      prv_republish_pin_times();
       break;
     case WorkerMessageUnscheduleAlert:
       data_unschedule_alert(data_library, data->data0);
-      break;
-    case WorkerMessageExportData:
-      data_print_csv(data_library);
+      prv_republish_pin_times();
       break;
     default:
       return;
@@ -68,6 +94,7 @@ static void prv_battery_state_change_handler(BatteryChargeState battery_state) {
 static void prv_initialize(void) {
   data_library = data_initialize();
   data_register_alert_callback(data_library, prv_battery_alert_handler);
+  data_register_timeline_callback(data_library, prv_timeline_update_handler);
   app_worker_message_subscribe(prv_worker_message_handler);
   battery_state_service_subscribe(prv_battery_state_change_handler);
   // run initial point through